@@ -50,7 +50,6 @@ public:
 protected:
     typedef std::vector<std::vector<double>> Data;
     std::vector<genfile::bgen::Context> m_context_map;
-    std::vector<genfile::byte_t> m_buffer1, m_buffer2;
     bool m_target_plink = false;
     bool m_ref_plink = false;
     bool m_has_external_sample = false;
@@ -90,30 +89,41 @@ protected:
         std::unordered_set<std::string>& processed_snps,
         std::vector<bool>& retain_snp, bool& chr_error, bool& sex_error,
         Genotype* genotype);
-    inline void read_genotype(const SNP& snp, const uintptr_t /*selected_size*/,
-                              FileRead& genotype_file,
-                              uintptr_t* __restrict /*tmp_genotype*/,
+    inline void read_genotype(const SNP& snp, const uintptr_t selected_size,
+                              GenotypeCursor& cursor,
                               uintptr_t* __restrict genotype,
                               uintptr_t* __restrict subset_mask,
                               bool is_ref = false) override
     {
         auto [file_idx, byte_pos] = snp.get_file_info(is_ref);
+        uintptr_t* __restrict tmp_genotype = cursor.tmp_genotype.data();
         const uintptr_t unfiltered_sample_ct4 =
             (m_unfiltered_sample_ct + 3) / 4;
         if ((m_ref_plink && is_ref) || (!is_ref && m_target_plink))
         {
-            genotype_file.read(m_genotype_file_names[file_idx], byte_pos,
-                               unfiltered_sample_ct4,
-                               reinterpret_cast<char*>(genotype));
+            // genotype only has room for the selected samples
+            auto&& load_target = (m_unfiltered_sample_ct == selected_size)
+                                     ? genotype
+                                     : tmp_genotype;
+            cursor.genotype_file.read(m_genotype_file_names[file_idx],
+                                      byte_pos, unfiltered_sample_ct4,
+                                      reinterpret_cast<char*>(load_target));
+            if (m_unfiltered_sample_ct != selected_size)
+            {
+                copy_quaterarr_nonempty_subset(
+                    tmp_genotype, subset_mask,
+                    static_cast<uint32_t>(m_unfiltered_sample_ct),
+                    static_cast<uint32_t>(selected_size), genotype);
+            }
         }
-        else if (!load_and_collapse_incl(byte_pos, file_idx, genotype_file,
-                                         genotype, subset_mask))
+        else if (!load_and_collapse_incl(byte_pos, file_idx, cursor, genotype,
+                                         subset_mask))
         {
             throw std::runtime_error("Error: Cannot read the bgen file!");
         }
     }
     bool load_and_collapse_incl(const std::streampos byte_pos,
-                                const size_t& file_idx, FileRead& genotype_file,
+                                const size_t& file_idx, GenotypeCursor& cursor,
                                 uintptr_t* __restrict mainbuf,
                                 uintptr_t* __restrict subset_mask)
     {
@@ -123,9 +133,10 @@ protected:
             PLINK_generator setter(subset_mask, mainbuf, m_hard_threshold,
                                    m_dose_threshold);
             genfile::bgen::read_and_parse_genotype_data_block<PLINK_generator>(
-                genotype_file, m_genotype_file_names[file_idx] + ".bgen",
-                m_context_map[file_idx], setter, &m_buffer1, &m_buffer2,
-                byte_pos);
+                cursor.genotype_file,
+                m_genotype_file_names[file_idx] + ".bgen",
+                m_context_map[file_idx], setter, &cursor.buffer1,
+                &cursor.buffer2, byte_pos);
         }
         catch (...)
         {
@@ -134,19 +145,41 @@ protected:
         return true;
     }
 
-    void count_and_read_genotype(SNP&) override;
-    void read_score(std::vector<PRS>& prs_list,
+    /*!
+     * \brief Read a block of variants, as dosages if the genotypes aren't
+     *        hard coded
+     */
+    void read_block(GenotypeBlock& block, GenotypeCursor& cursor) override;
+    /*!
+     * \brief Hard code a block of variants, with the same counts as those
+     *        used by hard_code_score
+     */
+    void read_hard_coded_block(GenotypeBlock& block, GenotypeCursor& cursor);
+    void read_score(PRSList& prs_list,
                     const std::vector<size_t>::const_iterator& start_idx,
                     const std::vector<size_t>::const_iterator& end_idx,
-                    bool reset_zero) override;
-    void hard_code_score(std::vector<PRS>& prs_list,
+                    bool reset_zero, GenotypeCursor& cursor) override;
+    void score(PRSList& prs_list,
+               const std::vector<size_t>::const_iterator& start_idx,
+               const std::vector<size_t>::const_iterator& end_idx,
+               bool reset_zero, FileRead& genotype_file,
+               std::vector<uintptr_t>& tmp_genotype,
+               std::vector<genfile::byte_t>& buffer1,
+               std::vector<genfile::byte_t>& buffer2);
+    template <MISSING_SCORE missing>
+    void hard_code_score(PRSList& prs_list,
                          const std::vector<size_t>::const_iterator& start_idx,
                          const std::vector<size_t>::const_iterator& end_idx,
-                         bool reset_zero);
-    void dosage_score(std::vector<PRS>& prs_list,
+                         bool reset_zero, FileRead& genotype_file,
+                         std::vector<uintptr_t>& tmp_genotype,
+                         std::vector<genfile::byte_t>& buffer1,
+                         std::vector<genfile::byte_t>& buffer2);
+    void dosage_score(PRSList& prs_list,
                       const std::vector<size_t>::const_iterator& start_idx,
                       const std::vector<size_t>::const_iterator& end_idx,
-                      bool reset_zero);
+                      bool reset_zero, FileRead& genotype_file,
+                      std::vector<genfile::byte_t>& buffer1,
+                      std::vector<genfile::byte_t>& buffer2);
 
     /*
      * Different structures use for reading in the bgen info
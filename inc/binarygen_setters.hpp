@@ -5,6 +5,7 @@
 #include "misc.hpp"
 #include "plink_common.hpp"
 #include "storage.hpp"
+#include <limits>
 #include <stdexcept>
 #include <zlib.h>
 
@@ -13,7 +14,7 @@ class PRS_Interpreter
 {
 public:
     virtual ~PRS_Interpreter() {}
-    PRS_Interpreter(std::vector<PRS>* sample_prs,
+    PRS_Interpreter(PRSList* sample_prs,
                     std::vector<uintptr_t>* sample_inclusion,
                     MISSING_SCORE missing)
         : m_sample_prs(sample_prs), m_sample_inclusion(sample_inclusion)
@@ -121,7 +122,7 @@ public:
     virtual void process_centre_missing() {}
 
 protected:
-    std::vector<PRS>* m_sample_prs;
+    PRSList* m_sample_prs;
     std::vector<uintptr_t>* m_sample_inclusion;
     std::vector<size_t> m_missing;
     std::vector<double> m_probs;
@@ -144,7 +145,7 @@ protected:
 class First_PRS : public PRS_Interpreter
 {
 public:
-    First_PRS(std::vector<PRS>* sample_prs,
+    First_PRS(PRSList* sample_prs,
               std::vector<uintptr_t>* sample_inclusion, MISSING_SCORE missing)
         : PRS_Interpreter(sample_prs, sample_inclusion, missing)
     {
@@ -158,20 +159,22 @@ public:
         else
         {
 
-            (*m_sample_prs)[idx].num_snp = m_ploidy;
-            (*m_sample_prs)[idx].prs = m_sum * m_stat;
+            m_sample_prs->prs[idx] = m_sum * m_stat;
             dose_statistic.push(m_sum);
         }
     }
     void process_centre_missing()
     {
         size_t cur_idx = 0;
+        m_sample_prs->num_snp = m_ploidy;
+        m_sample_prs->base = 0.0;
+        m_sample_prs->num_miss.clear();
         for (size_t i = 0; i < m_sample_prs->size(); ++i)
         {
             if (cur_idx < m_missing.size() && i == m_missing[cur_idx])
             {
-                (*m_sample_prs)[i].prs = m_miss_score;
-                (*m_sample_prs)[i].num_snp = m_miss_count;
+                m_sample_prs->prs[i] = m_miss_score;
+                m_sample_prs->add_missing(i, m_ploidy - m_miss_count);
                 ++cur_idx;
             }
             else if (m_centre)
@@ -179,7 +182,7 @@ public:
                 // if it is not missing and we want the centre the
                 // score we will need to minus the adjusted score
                 // which was 0 before this run
-                (*m_sample_prs)[i].prs -= m_adj_score;
+                m_sample_prs->prs[i] -= m_adj_score;
             }
         }
     }
@@ -187,17 +190,20 @@ public:
     {
         // only need to do this if we don't have the expected
         // information
+        m_sample_prs->num_snp = m_ploidy;
+        m_sample_prs->base = 0.0;
+        m_sample_prs->num_miss.clear();
         for (auto&& idx : m_missing)
         {
-            (*m_sample_prs)[idx].prs = m_miss_score;
-            (*m_sample_prs)[idx].num_snp = m_miss_count;
+            m_sample_prs->prs[idx] = m_miss_score;
+            m_sample_prs->add_missing(idx, m_ploidy - m_miss_count);
         }
     }
 };
 class Add_PRS : public PRS_Interpreter
 {
 public:
-    Add_PRS(std::vector<PRS>* sample_prs,
+    Add_PRS(PRSList* sample_prs,
             std::vector<uintptr_t>* sample_inclusion, MISSING_SCORE missing)
         : PRS_Interpreter(sample_prs, sample_inclusion, missing)
     {
@@ -211,20 +217,20 @@ public:
         else
         {
 
-            (*m_sample_prs)[idx].num_snp += m_ploidy;
-            (*m_sample_prs)[idx].prs += m_sum * m_stat;
+            m_sample_prs->prs[idx] += m_sum * m_stat;
             dose_statistic.push(m_sum);
         }
     }
     void process_centre_missing()
     {
         size_t cur_idx = 0;
+        m_sample_prs->num_snp += m_ploidy;
         for (size_t i = 0; i < m_sample_prs->size(); ++i)
         {
             if (cur_idx < m_missing.size() && i == m_missing[cur_idx])
             {
-                (*m_sample_prs)[i].prs += m_miss_score;
-                (*m_sample_prs)[i].num_snp += m_miss_count;
+                m_sample_prs->prs[i] += m_miss_score;
+                m_sample_prs->add_missing(i, m_ploidy - m_miss_count);
                 ++cur_idx;
             }
             else if (m_centre)
@@ -232,7 +238,7 @@ public:
                 // if it is not missing and we want the centre the
                 // score we will need to minus the adjusted score
                 // which was 0 before this run
-                (*m_sample_prs)[i].prs -= m_adj_score;
+                m_sample_prs->prs[i] -= m_adj_score;
             }
         }
     }
@@ -240,10 +246,11 @@ public:
     {
         // only need to do this if we don't have the expected
         // information
+        m_sample_prs->num_snp += m_ploidy;
         for (auto&& idx : m_missing)
         {
-            (*m_sample_prs)[idx].prs += m_miss_score;
-            (*m_sample_prs)[idx].num_snp += m_miss_count;
+            m_sample_prs->prs[idx] += m_miss_score;
+            m_sample_prs->add_missing(idx, m_ploidy - m_miss_count);
         }
     }
 };
@@ -457,4 +464,65 @@ private:
     bool m_phased = false;
     bool m_missing = false;
 };
+/*!
+ * \brief Store the probabilities of the three genotypes of each included
+ *        sample, or NaN if the genotype of the sample is missing. Missing
+ *        samples and phased probabilities are handled as in PRS_Interpreter
+ */
+struct Dosage_generator
+{
+    Dosage_generator(uintptr_t* sample, double* dosage)
+        : m_sample(sample), m_dosage(dosage)
+    {
+        m_prob.resize(3);
+    }
+    void initialise(std::size_t, std::size_t) { m_index = 0; }
+    void set_min_max_ploidy(uint32_t, uint32_t, uint32_t, uint32_t) {}
+    bool set_sample(std::size_t i)
+    {
+        m_missing = false;
+        return IS_SET(m_sample, i);
+    }
+    void set_number_of_entries(std::size_t, std::size_t,
+                               genfile::OrderType phased, genfile::ValueType)
+    {
+        m_phased = (phased == genfile::OrderType::ePerPhasedHaplotypePerAllele);
+        m_prob.resize(3 + m_phased, 0.0);
+    }
+    void set_value(uint32_t idx, double value) { m_prob[idx] = value; }
+    void set_value(uint32_t, genfile::MissingValue) { m_missing = true; }
+    void finalise() {}
+    void sample_completed()
+    {
+        if (!m_missing)
+        {
+            double total = 0.0;
+            for (auto&& p : m_prob) { total += p; }
+            m_missing = misc::logically_equal(total, 0.0);
+        }
+        double* geno = m_dosage + 3 * m_index++;
+        if (m_missing)
+        {
+            std::fill_n(geno, 3, std::numeric_limits<double>::quiet_NaN());
+        }
+        else if (m_phased)
+        {
+            geno[0] = m_prob[0] * m_prob[2];
+            geno[1] = m_prob[0] * m_prob[3] + m_prob[1] * m_prob[2];
+            geno[2] = m_prob[1] * m_prob[3];
+        }
+        else
+        {
+            std::copy_n(m_prob.begin(), 3, geno);
+        }
+    }
+
+private:
+    std::vector<double> m_prob;
+    uintptr_t* m_sample;
+    double* m_dosage;
+    uint32_t m_index = 0;
+    bool m_phased = false;
+    bool m_missing = false;
+};
 #endif // BINARYGEN_SETTERS_HPP
@@ -68,63 +68,44 @@ protected:
         Genotype* genotype);
     std::unordered_set<std::string>
     get_founder_info(std::unique_ptr<std::istream>& famfile);
-    inline void count_and_read_genotype(SNP& snp) override
+    /*!
+     * \brief Get the genotype counts of a variant, counting the founders of
+     *        its raw genotype if the counts are not yet known
+     * \param snp is the variant
+     * \param genotype is the genotype of all samples, as read from the bed
+     *        file
+     */
+    void get_or_count(SNP& snp, uintptr_t* genotype, uint32_t& homcom_ct,
+                      uint32_t& het_ct, uint32_t& homrar_ct,
+                      uint32_t& missing_ct)
     {
-        // false because we only use this for target
-        auto [file_idx, byte_pos] = snp.get_file_info(false);
-        const uintptr_t unfiltered_sample_ct4 =
-            (m_unfiltered_sample_ct + 3) / 4;
-        auto&& snp_genotype = snp.current_genotype();
-        auto&& load_target = (m_unfiltered_sample_ct == m_sample_ct)
-                                 ? snp_genotype
-                                 : m_tmp_genotype.data();
-        m_genotype_file.read(m_genotype_file_names[file_idx] + ".bed", byte_pos,
-                             unfiltered_sample_ct4,
-                             reinterpret_cast<char*>(load_target));
-        uint32_t homrar_ct = 0;
-        uint32_t missing_ct = 0;
-        uint32_t het_ct = 0;
-        uint32_t homcom_ct = 0;
-        if (!snp.get_counts(homcom_ct, het_ct, homrar_ct, missing_ct,
-                            m_prs_calculation.use_ref_maf))
-        {
-            const uintptr_t unfiltered_sample_ctl =
-                BITCT_TO_WORDCT(m_unfiltered_sample_ct);
-            const uintptr_t unfiltered_sample_ctv2 = 2 * unfiltered_sample_ctl;
-            uint32_t tmp_total = 0;
-            uint32_t ll_ct, lh_ct, hh_ct;
-            single_marker_freqs_and_hwe(
-                unfiltered_sample_ctv2, load_target, m_sample_include2.data(),
-                m_founder_include2.data(), m_sample_ct, &ll_ct, &lh_ct, &hh_ct,
-                m_founder_ct, &homcom_ct, &het_ct, &homrar_ct);
-            tmp_total = (homcom_ct + het_ct + homrar_ct);
-            assert(m_founder_ct >= tmp_total);
-            missing_ct = m_founder_ct - tmp_total;
-            snp.set_counts(homcom_ct, het_ct, homrar_ct, missing_ct, false);
-        }
-        if (m_unfiltered_sample_ct != m_sample_ct)
-        {
-            copy_quaterarr_nonempty_subset(
-                m_tmp_genotype.data(), m_calculate_prs.data(),
-                static_cast<uint32_t>(m_unfiltered_sample_ct),
-                static_cast<uint32_t>(m_sample_ct), snp_genotype);
-        }
-        else
-        {
-            const uintptr_t final_mask =
-                get_final_mask(static_cast<uint32_t>(m_sample_ct));
-            snp_genotype[(m_unfiltered_sample_ct - 1) / BITCT2] &= final_mask;
-        }
+        if (snp.get_counts(homcom_ct, het_ct, homrar_ct, missing_ct,
+                           m_prs_calculation.use_ref_maf))
+        { return; }
+        // we need to calculate the MA
+        // if we want to use reference, we will always have calculated
+        // the MAF
+        const uintptr_t unfiltered_sample_ctv2 =
+            2 * BITCT_TO_WORDCT(m_unfiltered_sample_ct);
+        uint32_t ll_ct, lh_ct, hh_ct;
+        single_marker_freqs_and_hwe(
+            unfiltered_sample_ctv2, genotype, m_sample_include2.data(),
+            m_founder_include2.data(), m_sample_ct, &ll_ct, &lh_ct, &hh_ct,
+            m_founder_ct, &homcom_ct, &het_ct, &homrar_ct);
+        const uint32_t tmp_total = (homcom_ct + het_ct + homrar_ct);
+        assert(m_founder_ct >= tmp_total);
+        missing_ct = m_founder_ct - tmp_total;
+        snp.set_counts(homcom_ct, het_ct, homrar_ct, missing_ct, false);
     }
 
     inline void read_genotype(const SNP& snp, const uintptr_t selected_size,
-                              FileRead& genotype_file,
-                              uintptr_t* __restrict tmp_genotype,
+                              GenotypeCursor& cursor,
                               uintptr_t* __restrict genotype,
                               uintptr_t* __restrict subset_mask,
                               bool is_ref = false) override
     {
         auto [file_idx, byte_pos] = snp.get_file_info(is_ref);
+        uintptr_t* __restrict tmp_genotype = cursor.tmp_genotype.data();
         // first, generate the mask to mask out the last few byte that we don't
         // want (if our sample number isn't a multiple of 16, it is possible
         // that there'll be trailling bytes that we don't want
@@ -136,9 +117,9 @@ protected:
             (m_unfiltered_sample_ct == selected_size) ? genotype : tmp_genotype;
         // now we start reading / parsing the binary from the file
         assert(unfiltered_sample_ct);
-        genotype_file.read(m_genotype_file_names[file_idx] + ".bed", byte_pos,
-                           unfiltered_sample_ct4,
-                           reinterpret_cast<char*>(load_target));
+        cursor.genotype_file.read(m_genotype_file_names[file_idx] + ".bed",
+                                  byte_pos, unfiltered_sample_ct4,
+                                  reinterpret_cast<char*>(load_target));
         if (m_unfiltered_sample_ct != selected_size)
         {
             copy_quaterarr_nonempty_subset(
@@ -151,11 +132,27 @@ protected:
             genotype[(m_unfiltered_sample_ct - 1) / BITCT2] &= final_mask;
         }
     }
+    /*!
+     * \brief Read a block of variants. Variants stored next to each other in
+     *        the same bed file are read with a single read. The counts of
+     *        each variant are those of the founders, as used for scoring
+     */
+    void read_block(GenotypeBlock& block, GenotypeCursor& cursor) override;
     virtual void
-    read_score(std::vector<PRS>& prs_list,
+    read_score(PRSList& prs_list,
                const std::vector<size_t>::const_iterator& start_idx,
                const std::vector<size_t>::const_iterator& end_idx,
-               bool reset_zero) override;
+               bool reset_zero, GenotypeCursor& cursor) override;
+    /*!
+     * \brief Score the variants with the missing score handling fixed at
+     *        compile time. See read_score
+     * \param cursor holds the file handle and the genotype buffers
+     */
+    template <MISSING_SCORE missing>
+    void hard_code_score(PRSList& prs_list,
+                         const std::vector<size_t>::const_iterator& start_idx,
+                         const std::vector<size_t>::const_iterator& end_idx,
+                         bool reset_zero, GenotypeCursor& cursor);
 
     // modified version of the
     // single_marker_freqs_and_hwe function from PLINK (plink_filter.c)
@@ -74,7 +74,8 @@ public:
     }
     bool need_ref() const
     {
-        return !m_clump_info.no_clump || m_prs_info.use_ref_maf;
+        return !m_clump_info.no_clump || m_prs_info.use_ref_maf
+               || !m_prepare_ref.empty();
     }
     bool use_inter() const { return m_allow_inter; }
     std::string delim() const { return m_id_delim; }
@@ -90,10 +91,13 @@ public:
     unsigned long long memory() const { return m_memory; }
     std::string exclude_file() const { return m_exclude_file; }
     std::string extract_file() const { return m_extract_file; }
+    std::string prepare_ref() const { return m_prepare_ref; }
     std::string chr_id_formula() const { return m_chr_id_formula; }
     bool keep_ambig() const { return m_keep_ambig; }
     bool nonfounders() const { return m_include_nonfounders; }
     bool ultra_aggressive() const { return m_ultra_aggressive; }
+    bool score_once() const { return m_score_once; }
+    bool chr_stream() const { return m_chr_stream; }
 
 protected:
     const std::vector<std::string> supported_types = {"bed", "ped", "bgen"};
@@ -102,6 +106,7 @@ protected:
     std::string m_exclusion_range = "";
     std::string m_exclude_file = "";
     std::string m_extract_file = "";
+    std::string m_prepare_ref = "";
     std::string m_help_message;
     std::string m_chr_id_formula;
     size_t m_memory = 1e10;
@@ -111,6 +116,8 @@ protected:
     int m_print_all_scores = false;
     int m_print_snp = false;
     int m_ultra_aggressive = false;
+    int m_score_once = false;
+    int m_chr_stream = false;
     int m_user_no_default = false;
     bool m_provided_memory = false;
     bool m_set_delim = false;
@@ -473,6 +480,28 @@ protected:
         return true;
     }
 
+    inline bool parse_unit_vector(const std::string& input,
+                                  const std::string& c,
+                                  const size_t default_power,
+                                  std::vector<size_t>& target)
+    {
+        check_duplicate(c);
+        bool valid = true;
+        size_t value;
+        for (auto&& token : misc::split(input, ","))
+        {
+            // each value is logged by parse_unit_value, remove it to avoid
+            // the duplicated argument warning
+            m_parameter_log.erase(c);
+            valid &= parse_unit_value(token, c, default_power, value);
+            target.push_back(value);
+        }
+        std::string in = input;
+        misc::to_lower(in);
+        m_parameter_log[c] = in;
+        return valid;
+    }
+
 
     void check_duplicate(const std::string& c)
     {
@@ -538,7 +567,9 @@ protected:
 
     inline bool set_memory(const std::string& input)
     {
-        return parse_unit_value(input, "memory", 2, m_memory, true);
+        m_provided_memory =
+            parse_unit_value(input, "memory", 2, m_memory, true);
+        return m_provided_memory;
     }
     inline bool set_info(const std::string& in)
     {
@@ -600,29 +631,54 @@ protected:
         std::string input = in;
         misc::to_lower(input);
         check_duplicate("model");
-        switch (input.at(0))
+        // all models are scored together, the first being the main model
+        if (input == "all") { input = "add,dom,rec,het"; }
+        std::vector<MODEL> models;
+        std::string names;
+        for (auto&& token : misc::split(input, ","))
+        {
+            MODEL model;
+            std::string name;
+            switch (token.at(0))
+            {
+            case 'a':
+                name = "add";
+                model = MODEL::ADDITIVE;
+                break;
+            case 'd':
+                name = "dom";
+                model = MODEL::DOMINANT;
+                break;
+            case 'r':
+                name = "rec";
+                model = MODEL::RECESSIVE;
+                break;
+            case 'h':
+                name = "het";
+                model = MODEL::HETEROZYGOUS;
+                break;
+            default:
+                m_error_message.append("Error: Unrecognized model: " + in
+                                       + "!\n");
+                return false;
+            }
+            if (std::find(models.begin(), models.end(), model) != models.end())
+            {
+                m_error_message.append("Error: Duplicated model: " + name
+                                       + "!\n");
+                return false;
+            }
+            models.push_back(model);
+            names.append(names.empty() ? name : "," + name);
+        }
+        if (models.empty())
         {
-        case 'a':
-            input = "add";
-            m_prs_info.genetic_model = MODEL::ADDITIVE;
-            break;
-        case 'd':
-            input = "dom";
-            m_prs_info.genetic_model = MODEL::DOMINANT;
-            break;
-        case 'r':
-            input = "rec";
-            m_prs_info.genetic_model = MODEL::RECESSIVE;
-            break;
-        case 'h':
-            input = "het";
-            m_prs_info.genetic_model = MODEL::HETEROZYGOUS;
-            break;
-        default:
             m_error_message.append("Error: Unrecognized model: " + in + "!\n");
             return false;
         }
-        m_parameter_log["model"] = input;
+        m_prs_info.genetic_model = models.front();
+        m_prs_info.other_models.assign(models.begin() + 1, models.end());
+        m_parameter_log["model"] = names;
         return true;
     }
     inline bool set_score(const std::string& in)
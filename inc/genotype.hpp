@@ -21,6 +21,8 @@
 #include "IITree.h"
 #include "commander.hpp"
 #include "genotype_pool.hpp"
+#include "ld_cache.hpp"
+#include "partial_scores.hpp"
 #include "misc.hpp"
 #include "plink_common.hpp"
 #include "reporter.hpp"
@@ -29,20 +31,27 @@
 #include "thread_queue.hpp"
 #include <Eigen/Dense>
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cctype>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
 #include <deque>
 #include <fstream>
 #include <functional>
+#include <limits>
+#include <map>
 #include <memory>
 #include <memoryread.hpp>
 #include <mutex>
+#include <numeric>
 #include <random>
 #include <set>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -53,6 +62,57 @@
 
 #define MULTIPLEX_LD 1920
 #define MULTIPLEX_2LD (MULTIPLEX_LD * 2)
+/*!
+ * \brief Read state used when reading genotypes from file. Each thread
+ *        holding its own cursor can read from the same Genotype object
+ *        concurrently
+ */
+struct GenotypeCursor
+{
+    FileRead genotype_file;
+    std::vector<uintptr_t> tmp_genotype;
+    // genotype of the samples used for scoring, when not all samples are used
+    std::vector<uintptr_t> subset_genotype;
+    // decompression buffers for bgen, also used for the raw bytes of
+    // consecutive variants read together from a bed file
+    std::vector<uint8_t> buffer1, buffer2;
+};
+/*!
+ * \brief Decoded genotypes of up to K variants. Hard coded genotypes are
+ *        stored as one packed 2-bit row of the samples used for scoring per
+ *        variant, in the same layout as the genotypes loaded into memory.
+ *        Dosages are stored as one row per variant with the probabilities of
+ *        the three genotypes of each sample, so that any genetic model can be
+ *        applied. The probabilities of missing samples are NaN
+ */
+struct GenotypeBlock
+{
+    // variant index of each row
+    std::vector<size_t> index;
+    std::vector<uintptr_t> packed;
+    std::vector<double> dosage;
+    // genotype counts of each row. Counts of dosage rows are those recorded
+    // during QC, if any
+    std::vector<AlleleCounts> counts;
+    // quatervec mask of the samples, used for counting the genotypes
+    std::vector<uintptr_t> sample_mask;
+    uintptr_t row_words = 0;
+    size_t num_sample = 0;
+    bool is_dosage = false;
+    size_t size() const { return index.size(); }
+    uintptr_t* packed_row(const size_t i)
+    {
+        return packed.data() + i * row_words;
+    }
+    const uintptr_t* packed_row(const size_t i) const
+    {
+        return packed.data() + i * row_words;
+    }
+    const double* dosage_row(const size_t i) const
+    {
+        return dosage.data() + i * 3 * num_sample;
+    }
+};
 class Genotype
 {
 public:
@@ -279,6 +339,7 @@ public:
         m_num_non_founder = 0;
         m_sample_ct = 0;
         m_founder_ct = 0;
+        m_founder_id_hash = 0;
         m_vector_initialized = true;
     }
     void post_sample_read_init()
@@ -290,8 +351,8 @@ public:
         const uintptr_t unfiltered_sample_ctl =
             BITCT_TO_WORDCT(m_unfiltered_sample_ct);
         const uintptr_t unfiltered_sample_ctv2 = 2 * unfiltered_sample_ctl;
-        m_tmp_genotype.resize(unfiltered_sample_ctv2, 0);
-        m_prs_info.resize(m_sample_ct, PRS());
+        m_cursor.tmp_genotype.resize(unfiltered_sample_ctv2, 0);
+        m_prs_info.resize(m_sample_ct, m_model_weights.size());
         m_sample_include2.resize(unfiltered_sample_ctv2, 0);
         m_founder_include2.resize(unfiltered_sample_ctv2, 0);
         // fill it with the required mask (copy from PLINK2)
@@ -303,15 +364,177 @@ public:
                                    m_founder_include2.data());
         m_exclude_from_std.resize(unfiltered_sample_ctl, 0);
     }
+    /*!
+     * \brief Perform clumping on the variants
+     * \param clump_info contains the clumping parameters
+     * \param reference is the genotype used for LD calculation
+     * \param threads is the number of thread allowed
+     * \param max_memory is the maximum memory (in bytes) PRSice can use. The
+     *        genotype rows held by clumping are limited to the memory left. 0
+     *        for no limit
+     * \param shared_ld_cache contains the R2 calculated by build_ld_cache,
+     *        shared between the base files. nullptr if not available
+     */
     void clumping(const Clumping& clump_info, Genotype& reference,
-                  size_t threads);
+                  size_t threads, const unsigned long long max_memory = 0,
+                  LDCache* shared_ld_cache = nullptr);
+    /*!
+     * \brief Calculate the R2 of all pairs of variants within the clumping
+     *        window in a single pass of the LD reference, so that it can be
+     *        shared by the clumping of each base file
+     * \param clump_info contains the clumping parameters
+     * \param reference is the genotype used for LD calculation
+     * \param threads is the number of thread allowed
+     * \param ld_cache is the return storage of the R2
+     * \param max_memory is the maximum memory (in bytes) PRSice can use. 0
+     *        for no limit
+     */
+    void build_ld_cache(const Clumping& clump_info, Genotype& reference,
+                        size_t threads, LDCache& ld_cache,
+                        const unsigned long long max_memory = 0);
+    /*!
+     * \brief Add variants of another base file that are not yet included,
+     *        such that the reference and QC only need to be processed once
+     *        for all base files
+     * \param other is the genotype loaded with another base file
+     */
+    void merge_snps(const Genotype& other);
+    /*!
+     * \brief Only keep variants that remained in the merged genotype, and
+     *        take their reference information and genotype counts from it
+     * \param merged is the genotype containing variants of all base files
+     */
+    void sync_snps(const Genotype& merged);
+    /*!
+     * \brief Perform clumping for each combination of the clumping parameters
+     *        in clump_info. R2 of all pairs within the largest window are only
+     *        calculated once. The clumped variants of each combination are
+     *        stored as a run and can be selected with select_run
+     * \param clump_info contains the clumping parameters
+     * \param reference is the genotype used for LD calculation
+     * \param threads is the number of thread allowed
+     * \param max_memory is the maximum memory (in bytes) PRSice can use
+     */
+    void clump_sweep(const Clumping& clump_info, Genotype& reference,
+                     size_t threads, const unsigned long long max_memory = 0);
+    /*!
+     * \brief Store the variants of a genotype loaded with another base file
+     *        as a run
+     * \param label is the label of the run
+     * \param other is the genotype loaded with another base file. Its
+     *        variants are moved into the run, or copied if it is this
+     *        genotype
+     */
+    void add_run(const std::string& label, Genotype& other);
+    /*!
+     * \brief Exchange the variants of a run with those of another genotype,
+     *        such that they can be processed (e.g. clumped) without keeping
+     *        a genotype per run
+     * \param idx is the index of the run
+     * \param other is the genotype used for processing the run
+     */
+    void swap_run(const size_t idx, Genotype& other);
+    size_t num_runs() const { return m_runs.size(); }
+    /*!
+     * \brief Use the variants of a run, i.e. a clumping parameter combination
+     *        or a base file. Each run can only be selected once
+     * \param idx is the index of the run
+     * \return the label of the run
+     */
+    std::string select_run(const size_t idx);
+    /*!
+     * \brief Randomly select a subset of founders for LD calculation. The
+     *        founders used for QC and PRS calculation are unchanged once
+     *        restore_ld_samples is called
+     * \param sample_size is the number of founders to select
+     * \param seed is the seed for the random selection
+     */
+    void subset_ld_samples(const size_t sample_size,
+                           const std::random_device::result_type seed);
+    /*!
+     * \brief Restore the founders before subset_ld_samples was called
+     */
+    void restore_ld_samples();
     std::vector<std::pair<size_t, size_t>> get_chrom_boundary();
+    void perform_clumping(const Clumping& clump_info, Genotype& reference,
+                          size_t threads, const unsigned long long max_memory);
     template <typename T>
     void
     threaded_clumping(const std::vector<std::pair<size_t, size_t>> snp_range,
                       const Clumping& clump_info, T& progress_observer,
                       std::vector<std::atomic<bool>>& remained_snps,
-                      std::atomic<size_t>& num_core, Genotype& reference);
+                      std::atomic<size_t>& num_core, Genotype& reference,
+                      MemoryBudget& budget, const size_t threads);
+    /*!
+     * \brief Load the LD cache if it matches the current reference, otherwise
+     *        calculate the R2 of all pairs within the clumping window and
+     *        store them in the cache file. Without a cache file (e.g. with
+     *        --clump-stream), the pairs are only kept in memory. If the pairs
+     *        do not fit into max_memory, the cache is left empty and clumping
+     *        reads the genotypes on demand
+     * \param clump_info contains the cache file name and the R2 floor
+     * \param reference is the genotype used for LD calculation
+     * \param threads is the number of thread allowed
+     * \param max_memory is the maximum memory (in bytes) PRSice can use
+     */
+    void prepare_ld_cache(const Clumping& clump_info, Genotype& reference,
+                          size_t threads, const unsigned long long max_memory);
+    /*!
+     * \brief Calculate the R2 of pairs within the clumping window of each
+     *        range. Both the genotype rows and the stored R2 are charged to
+     *        the budget
+     * \param exceeded is set when the budget is reached, in which case all
+     *        threads stop and the cache is incomplete
+     */
+    void
+    threaded_ld_cache(const std::vector<std::pair<size_t, size_t>> snp_range,
+                      Genotype& reference, MemoryBudget& budget,
+                      const size_t threads, std::atomic<bool>& exceeded);
+    /*!
+     * \brief Return the memory (in bytes) left for the genotype rows used
+     *        for LD calculation, i.e. max_memory not already used by PRSice
+     * \param max_memory is the maximum memory PRSice can use, 0 for no limit
+     */
+    static size_t ld_memory_limit(const unsigned long long max_memory);
+    /*!
+     * \brief Generate the identity key of the clumping result. Depends on the
+     *        variants (and their p-value and set membership) before clumping,
+     *        the LD reference and the clumping parameters. Must be called
+     *        before clumping
+     * \param clump_info contains the clumping parameters
+     * \param reference is the genotype used for LD calculation
+     * \return the key
+     */
+    uint64_t clump_cache_key(const Clumping& clump_info,
+                             const Genotype& reference) const;
+    /*!
+     * \brief Replace clumping by the result stored in the clump cache
+     * \param file_name is the name of the cache file
+     * \param key is the expected key of the clumping result
+     * \return true if the cache is valid and the clumped result is loaded.
+     *         The variants are unchanged if false is returned
+     */
+    bool load_clump_cache(const std::string& file_name, const uint64_t key);
+    /*!
+     * \brief Store the index SNPs and their set membership after clumping
+     * \param file_name is the name of the cache file
+     * \param key is the key of the clumping result
+     */
+    void save_clump_cache(const std::string& file_name,
+                          const uint64_t key) const;
+    /*!
+     * \brief Write the LD founders and the retained variants of the LD
+     *        reference as a packed PLINK binary file set (prefix.bed, .bim
+     *        and .fam) in coordinate order, together with the founder
+     *        genotype counts of each variant (prefix.prsref). When the
+     *        package is later used as the reference, the counts are used for
+     *        the reference QC instead of reading the genotypes again. The
+     *        counts file records a hash of the founder IDs and the coordinate
+     *        of each variant so that a modified package is not used
+     * \param prefix is the output prefix of the package
+     * \param reference is the genotype used for LD calculation
+     */
+    void prepare_reference(const std::string& prefix, Genotype& reference);
 
     /*!
      * \brief Before each run of PRSice, we need to reset the in regression
@@ -419,13 +642,13 @@ public:
      * \param i is the sample index
      * \return the PRS
      */
-    inline double calculate_score(const std::vector<PRS>& prs_list,
+    inline double calculate_score(const PRSList& prs_list,
                                   size_t i) const
     {
         if (i >= prs_list.size())
             throw std::out_of_range("Sample name vector out of range");
-        const size_t num_snp = prs_list[i].num_snp;
-        double prs = prs_list[i].prs;
+        const size_t num_snp = prs_list.snp_count(i);
+        const double prs = prs_list.score(i, m_active_model);
         double avg = prs;
         if (num_snp == 0) { avg = 0.0; }
         else
@@ -434,7 +657,7 @@ public:
         }
         switch (m_prs_calculation.scoring_method)
         {
-        case SCORING::SUM: return prs_list[i].prs;
+        case SCORING::SUM: return prs;
         case SCORING::STANDARDIZE:
         case SCORING::CONTROL_STD: return (avg - m_mean_score) / m_score_sd;
         default:
@@ -444,7 +667,7 @@ public:
     }
     inline double calculate_score(size_t i) const
     {
-        return calculate_score(m_prs_info, i);
+        return calculate_score(active_scores(), i);
     }
     /*!
      * \brief Function for calculating the PRS from the null set
@@ -457,22 +680,34 @@ public:
      * \param require_standardize is a boolean representing if we need to
      * calculate the mean and SD
      */
-    void get_null_score(std::vector<PRS>& prs_list, const size_t& set_size,
-                        const size_t& prev_size,
-                        std::vector<size_t>& background_list,
-                        const bool first_run);
     void get_null_score(const size_t& set_size, const size_t& prev_size,
                         std::vector<size_t>& background_list,
                         const bool first_run)
     {
-        get_null_score(m_prs_info, set_size, prev_size, background_list,
-                       first_run);
+        get_null_score(m_prs_info, m_cursor, set_size, prev_size,
+                       background_list, first_run);
+        if (m_prs_calculation.scoring_method == SCORING::STANDARDIZE
+            || m_prs_calculation.scoring_method == SCORING::CONTROL_STD)
+        { standardize_prs(); }
     }
+    /*!
+     * \brief Thread safe version of get_null_score. The score is accumulated
+     *        into prs_list and read with the cursor owned by the calling
+     *        thread. The mean and SD used for standardization are not updated
+     *        as they are shared. This is fine for permutation as the
+     *        regression statistic isn't affected by shifting and scaling the
+     *        score
+     */
+    void get_null_score(PRSList& prs_list, GenotypeCursor& cursor,
+                        const size_t& set_size, const size_t& prev_size,
+                        std::vector<size_t>& background_list,
+                        const bool first_run);
     /*!
      * \brief return the largest chromosome allowed
      * \return  the largest chromosome
      */
     uint32_t max_chr() const { return m_max_code; }
+    uint32_t num_autosome() const { return m_autosome_ct; }
     /*!
      * \brief Indicate we will be using a reference file. Use for bgen
      * intermediate output generation
@@ -506,10 +741,83 @@ public:
     {
         return m_set_thresholds;
     }
+    /*!
+     * \brief Use the thresholds of the partial scores as the thresholds of
+     *        the base set. Used with --chr-stream, where the variants are
+     *        released after their chromosome is scored
+     */
+    void set_stream_thresholds(const PartialScores& partial)
+    {
+        m_set_thresholds.assign(2, std::set<double>());
+        for (auto&& score : partial.thresholds())
+        { m_set_thresholds[0].insert(score.first); }
+    }
+    /*!
+     * \brief Score each threshold of the set separately and add the score to
+     *        the partial score of the threshold, so that the partial scores
+     *        of different chromosomes can be summed before the regression
+     * \param set_snp_idx is the index of the variants in the set
+     * \param partial is the partial score of each threshold
+     */
+    void add_partial_scores(const std::vector<size_t>& set_snp_idx,
+                            PartialScores& partial);
+    /*!
+     * \brief Add the variants of the next threshold to the score
+     * \param standardize indicate if the mean and SD of the score should be
+     *        updated. Should be false when the score is standardized through
+     *        set_score_view by the thread consuming it
+     * \return false if there are no more thresholds
+     */
     bool get_score(std::vector<size_t>::const_iterator& start_index,
                    const std::vector<size_t>::const_iterator& end_index,
                    double& cur_threshold, uint32_t& num_snp_included,
-                   const bool first_run);
+                   const bool first_run, const bool standardize = true);
+    /*!
+     * \brief Return a copy of the current score, which can be used through
+     *        set_score_view while the next threshold is being scored
+     */
+    PRSList score_snapshot() const { return m_prs_info; }
+    /*!
+     * \brief Set the number of threads used by get_score. The scores do not
+     *        depend on the number of threads
+     */
+    void set_score_thread(const int thread)
+    {
+        m_prs_calculation.thread = std::max(thread, 1);
+    }
+    /*!
+     * \brief Use another score list for calculate_score, and standardize it
+     *        when required. The list must outlive its use
+     * \param scores is the score list to use, or nullptr to use the score
+     *        generated by get_score
+     */
+    void set_score_view(const PRSList* scores)
+    {
+        m_score_view = scores;
+        if (m_prs_calculation.scoring_method == SCORING::STANDARDIZE
+            || m_prs_calculation.scoring_method == SCORING::CONTROL_STD)
+        { standardize_prs(); }
+    }
+    /*!
+     * \brief Select the set to be scored by the following get_score calls.
+     *        If the scores of the set weren't generated, the set and the
+     *        sets after it are scored together in a single pass through
+     *        their variants, so that variants shared by different sets are
+     *        only read and decoded once. The scores of each threshold are
+     *        stored until get_score consumes them. Not used when multiple
+     *        genetic models are scored
+     * \param region_membership is the index of variants in each set
+     * \param set_idx is the index of the set
+     * \param max_memory is the memory available for storing the scores
+     */
+    void prepare_set_scores(
+        const std::vector<std::vector<size_t>>& region_membership,
+        const size_t set_idx, const unsigned long long max_memory);
+    void clear_set_scores()
+    {
+        m_set_scores.clear();
+        m_active_set_scores = nullptr;
+    }
     static bool within_region(const std::vector<IITree<size_t, size_t>>& cr,
                               const size_t chr, const size_t loc)
     {
@@ -522,6 +830,17 @@ public:
 
     bool perform_freqs_and_inter(const QCFiltering& filter_info,
                                  const std::string& prefix, Genotype* target);
+    /*!
+     * \brief Perform the reference QC using the genotype counts stored in
+     *        the reference package generated by prepare_reference
+     * \param filter_info contains the QC thresholds
+     * \param target is the genotype containing the variants
+     * \return true if a valid package is found and QC is performed. False if
+     *         the package is missing or doesn't match the current samples
+     *         or variants
+     */
+    bool load_reference_package(const QCFiltering& filter_info,
+                                Genotype* target);
     static void
     construct_flag(const std::vector<IITree<size_t, size_t>>& gene_sets,
                    const size_t required_size,
@@ -543,6 +862,16 @@ public:
                    const size_t num_sets, const bool genome_wide_background);
 
     // Refactoring
+    /*!
+     * \brief Only read the base variants on chromosome chr, used to process
+     *        one chromosome at a time
+     */
+    Genotype& stream_chr(size_t chr)
+    {
+        m_stream_chr = chr;
+        return *this;
+    }
+    bool streaming() const { return m_stream_chr != ~size_t(0); }
     Genotype& keep_nonfounder(bool keep)
     {
         m_keep_nonfounder = keep;
@@ -558,6 +887,11 @@ public:
         m_is_ref = true;
         return *this;
     }
+    Genotype& keep_sample_id(bool keep)
+    {
+        m_keep_sample_id = keep;
+        return *this;
+    }
     Genotype& intermediate(bool use)
     {
         m_intermediate = use;
@@ -567,6 +901,11 @@ public:
     {
         m_has_prs_instruction = true;
         m_prs_calculation = prs;
+        m_model_weights.clear();
+        for (auto&& model : prs.other_models)
+        { m_model_weights.push_back(model_weight(model)); }
+        m_active_model = 0;
+        m_prs_info.resize(m_prs_info.size(), m_model_weights.size());
         return *this;
     }
     void snp_extraction(const std::string& extract_snps,
@@ -601,33 +940,63 @@ public:
         }
         void completed() { m_completed = true; }
     };
-    Genotype& set_weight(const MODEL& genetic_model)
+    /*!
+     * \brief Return the weight of the homozygous common, heterozygous and
+     *        homozygous rare genotype under the genetic model
+     */
+    static std::array<double, 3> model_weight(const MODEL& genetic_model)
     {
         switch (genetic_model)
         {
-        case MODEL::HETEROZYGOUS:
-            m_homcom_weight = 0;
-            m_het_weight = 1;
-            m_homrar_weight = 0;
-            break;
-        case MODEL::DOMINANT:
-            m_homcom_weight = 0;
-            m_het_weight = 1;
-            m_homrar_weight = 1;
-            break;
-        case MODEL::RECESSIVE:
-            m_homcom_weight = 0;
-            m_het_weight = 0;
-            m_homrar_weight = 1;
-            break;
-        default:
-            m_homcom_weight = 0;
-            m_het_weight = 1;
-            m_homrar_weight = 2;
-            break;
+        case MODEL::HETEROZYGOUS: return {0, 1, 0};
+        case MODEL::DOMINANT: return {0, 1, 1};
+        case MODEL::RECESSIVE: return {0, 0, 1};
+        default: return {0, 1, 2};
         }
+    }
+    Genotype& set_weight(const MODEL& genetic_model)
+    {
+        const auto weight = model_weight(genetic_model);
+        m_homcom_weight = weight[0];
+        m_het_weight = weight[1];
+        m_homrar_weight = weight[2];
         return *this;
     }
+    /*!
+     * \brief Return the number of genetic models scored, including the main
+     *        model set by set_weight
+     */
+    size_t num_models() const { return m_model_weights.size() + 1; }
+    /*!
+     * \brief Select the genetic model used by calculate_score. Scores of all
+     *        models are calculated together, so this only re-standardize
+     *        the score when required
+     * \param model is the index of the model, where 0 is the main model
+     */
+    void select_model(const size_t model)
+    {
+        if (model == m_active_model) return;
+        m_active_model = model;
+        if (m_prs_calculation.scoring_method == SCORING::STANDARDIZE
+            || m_prs_calculation.scoring_method == SCORING::CONTROL_STD)
+        { standardize_prs(); }
+    }
+    /*!
+     * \brief Return an empty score list with room for all genetic models
+     */
+    PRSList new_prs_list() const
+    {
+        return PRSList(m_sample_ct, m_model_weights.size());
+    }
+    /*!
+     * \brief Return a new read state for a thread reading from this object
+     */
+    GenotypeCursor new_cursor() const
+    {
+        GenotypeCursor cursor;
+        cursor.tmp_genotype.resize(m_cursor.tmp_genotype.size(), 0);
+        return cursor;
+    }
 
     void set_thresholds(const QCFiltering& qc)
     {
@@ -635,6 +1004,21 @@ public:
         m_dose_threshold = qc.dose_threshold;
     }
     void load_genotype_to_memory();
+    /*!
+     * \brief Decode the next block of variants from a variant index list.
+     *        Variants are taken in the order of the list, and each backend
+     *        reads the block with its best batching
+     * \param cur is the next variant to read, advanced past the block
+     * \param end is the end of the variant index list
+     * \param block_size is the maximum number of variants in the block
+     * \param block is the block to fill
+     * \param cursor is the read state owned by the calling thread
+     * \return false if there are no more variants to read
+     */
+    bool next_block(std::vector<size_t>::const_iterator& cur,
+                    const std::vector<size_t>::const_iterator& end,
+                    const size_t block_size, GenotypeBlock& block,
+                    GenotypeCursor& cursor);
     bool genotyped_stored() const { return m_genotype_stored; }
     const std::unordered_map<std::string, size_t>& included_snps_idx() const
     {
@@ -651,20 +1035,40 @@ protected:
     friend class BinaryGen;
     // vector storing all the genotype files
     // std::vector<Sample> m_sample_names;
-    FileRead m_genotype_file;
+    // read state used by the calling thread
+    GenotypeCursor m_cursor;
     GenotypePool m_genotype_pool;
+    LDCache m_ld_cache;
     std::vector<SNP> m_existed_snps;
     std::unordered_map<std::string, size_t> m_existed_snps_index;
     std::unordered_set<std::string> m_sample_selection_list;
     std::unordered_set<std::string> m_snp_selection_list;
     std::vector<std::set<double>> m_set_thresholds;
     std::vector<Sample_ID> m_sample_id;
-    std::vector<PRS> m_prs_info;
+    PRSList m_prs_info;
+    // score used by calculate_score instead of m_prs_info when not nullptr
+    const PRSList* m_score_view = nullptr;
     std::vector<std::string> m_genotype_file_names;
     std::vector<char> m_chr_id_symbol;
-    std::vector<uintptr_t> m_tmp_genotype;
     // std::vector<uintptr_t> m_chrom_mask;
     std::vector<uintptr_t> m_sample_for_ld;
+    struct Run
+    {
+        std::string label;
+        std::vector<SNP> snps;
+        bool very_small_thresholds;
+    };
+    // variants of each clumping parameter combination or base file
+    std::vector<Run> m_runs;
+    // scores of each threshold generated by prepare_set_scores, per set
+    std::unordered_map<size_t, std::deque<PRSList>> m_set_scores;
+    std::deque<PRSList>* m_active_set_scores = nullptr;
+    size_t m_active_set_idx = 0;
+    // minimum fraction of variant-set pairs within a tile for the set scores
+    // to be accumulated with a dense matrix product
+    double m_gemm_min_density = 0.125;
+    // founders before LD sample subsetting, empty if not subsetted
+    std::vector<uintptr_t> m_full_sample_for_ld;
     std::vector<uintptr_t> m_founder_include2;
     std::vector<uintptr_t> m_calculate_prs;
     std::vector<uintptr_t> m_sample_include2;
@@ -672,6 +1076,8 @@ protected:
     std::vector<uintptr_t> m_in_regression;
     std::vector<uintptr_t> m_haploid_mask;
     std::vector<size_t> m_sort_by_p_index;
+    // index of each SNP in m_ld_cache, empty if cache isn't used
+    std::vector<uint32_t> m_ld_cache_idx;
     std::vector<int> m_chr_id_column;
     // std::vector<uintptr_t> m_sex_male;
     std::vector<int32_t> m_xymt_codes;
@@ -689,7 +1095,12 @@ protected:
     double m_homcom_weight = 0;
     double m_het_weight = 1;
     double m_homrar_weight = 2;
+    // weights of the models scored together with the main model
+    std::vector<std::array<double, 3>> m_model_weights;
+    size_t m_active_model = 0;
     size_t m_num_thresholds = 0;
+    // only chromosome read from the base file with --chr-stream
+    size_t m_stream_chr = ~size_t(0);
     size_t m_thread = 1; // number of final samples
     size_t m_max_window_size = 0;
     size_t m_num_ambig = 0;
@@ -710,6 +1121,8 @@ protected:
     uintptr_t m_sample_ct = 0;
     uintptr_t m_founder_ct = 0;
     uintptr_t m_marker_ct = 0;
+    // hash of the FID and IID of the included founders, in file order
+    uint64_t m_founder_id_hash = 0;
     uint32_t m_max_category = 0;
     uint32_t m_autosome_ct = 0;
     uint32_t m_max_code = 0;
@@ -721,6 +1134,7 @@ protected:
     bool m_ignore_fid = false;
     bool m_intermediate = false;
     bool m_is_ref = false;
+    bool m_keep_sample_id = false;
     bool m_keep_nonfounder = false;
     bool m_keep_ambig = false;
     bool m_remove_sample = true;
@@ -789,6 +1203,14 @@ protected:
         return message;
     }
     std::string chr_id_from_genotype(const SNP& snp) const;
+    /*!
+     * \brief Generate the identity key of the LD cache from the genotype file
+     *        names, sizes and modification times, the samples used for LD
+     *        calculation and the clumping distance
+     * \param distance is the clumping distance
+     * \return the key
+     */
+    uint64_t ld_cache_key(const size_t distance) const;
     std::string
     get_chr_id_from_base(const BaseFile& base_file,
                          const std::vector<std::string_view>& token) const;
@@ -1012,7 +1434,7 @@ protected:
      * \brief Function to read in the sample. Any subclass must implement
      * this function. They \b must initialize the \b m_sample_info \b
      * m_founder_info \b m_founder_ct \b m_sample_ct \b m_prs_info \b
-     * m_in_regression and \b m_tmp_genotype (optional) \return vector
+     * m_in_regression and \b m_cursor (optional) \return vector
      * containing the sample information
      */
     virtual std::vector<Sample_ID> gen_sample_vector()
@@ -1110,110 +1532,459 @@ protected:
         return -1;
     }
 
-    void update_sample_prs(PRS& sample_prs, const uint32_t geno,
-                           const std::vector<double>& scores,
-                           const std::vector<size_t>& counts)
-    {
-        sample_prs.num_snp += counts[geno];
-        sample_prs.prs += scores[geno];
-    }
-    void initialize_sample_prs(PRS& sample_prs, const uint32_t geno,
-                               const std::vector<double>& scores,
-                               const std::vector<size_t>& counts)
-    {
-        sample_prs.num_snp = counts[geno];
-        sample_prs.prs = scores[geno];
-    }
-    template <class T>
-    void process_sample_prs(uintptr_t* genotype, std::vector<PRS>& prs_list,
-                            const std::vector<double>& scores,
-                            const std::vector<size_t>& counts, T load_prs)
-    {
-        uintptr_t* lbptr = genotype;
-        uintptr_t byte_block;
-        uint32_t processed_samples;
-        uint32_t sample_idx;
-        uint32_t geno;
-        processed_samples = 0;
-        byte_block = 0;
-        do
-        {
-            // ulii contain the numeric representation of the current
-            // genotype
-            byte_block = ~(*lbptr++);
-            if (processed_samples + BITCT2 > m_unfiltered_sample_ct)
+    /*!
+     * \brief Add the score of one variant to all samples. The genotype is
+     *        decoded four samples (one byte) at a time and the score of each
+     *        sample is looked up from the four entry table of the variant.
+     *        The allele count is shared by all samples, and only samples with
+     *        missing genotype that are not imputed need to be recorded
+     * \tparam not_first indicate if we should add to the existing score
+     *         instead of overwriting it
+     * \tparam track_missing indicate if missing genotypes reduce the allele
+     *         count of the sample
+     * \param genotype is the packed genotype of the m_sample_ct samples
+     * \param prs is the per sample score to be updated
+     * \param prs_list is the score list recording the missing genotypes
+     * \param scores is the score of each genotype encoding, indexed by the
+     *        complement of the PLINK encoding
+     * \param miss_deficit is the number of alleles not counted for a sample
+     *        with missing genotype
+     */
+    template <bool not_first, bool track_missing>
+    void process_sample_prs(const uintptr_t* genotype, double* prs,
+                            PRSList& prs_list, const double scores[4],
+                            const size_t miss_deficit)
+    {
+        // index of missing genotype after the bitwise not
+        constexpr uint32_t miss_geno = 2;
+        const unsigned char* geno_byte =
+            reinterpret_cast<const unsigned char*>(genotype);
+        const size_t num_byte = m_sample_ct / 4;
+        size_t sample_idx = 0;
+        for (size_t i = 0; i < num_byte; ++i, sample_idx += 4)
+        {
+            const uint32_t byte = ~static_cast<uint32_t>(geno_byte[i]);
+            for (uint32_t j = 0; j < 4; ++j)
             {
-                byte_block &=
-                    (ONELU << ((m_unfiltered_sample_ct & (BITCT2 - 1)) * 2))
-                    - ONELU;
+                const uint32_t geno = (byte >> (2 * j)) & 3;
+                if (not_first) { prs[sample_idx + j] += scores[geno]; }
+                else
+                {
+                    prs[sample_idx + j] = scores[geno];
+                }
+                if (track_missing && geno == miss_geno)
+                { prs_list.add_missing(sample_idx + j, miss_deficit); }
             }
-            // ujj sample index of the current genotype block
-            sample_idx = 0;
-            while (sample_idx < BITCT)
+        }
+        // the remaining samples in the last, partial byte
+        if (sample_idx < m_sample_ct)
+        {
+            const uint32_t byte = ~static_cast<uint32_t>(geno_byte[num_byte]);
+            for (uint32_t j = 0; sample_idx + j < m_sample_ct; ++j)
             {
-                // go through the whole genotype block
-                // ukk is the current genotype
-                geno = (byte_block >> sample_idx) & 3;
-                // and the sample index can be calculated as uii+(ujj/2)
-                if (processed_samples + (sample_idx / 2) >= m_sample_ct)
-                { break; }
-                auto& sample_prs =
-                    prs_list[processed_samples + (sample_idx / 2)];
-                // now we will get all genotypes (0, 1, 2, 3)
-                (this->*load_prs)(sample_prs, geno, scores, counts);
-                sample_idx += 2;
+                const uint32_t geno = (byte >> (2 * j)) & 3;
+                if (not_first) { prs[sample_idx + j] += scores[geno]; }
+                else
+                {
+                    prs[sample_idx + j] = scores[geno];
+                }
+                if (track_missing && geno == miss_geno)
+                { prs_list.add_missing(sample_idx + j, miss_deficit); }
             }
-            // uii is the number of samples we have finished so far
-            processed_samples += BITCT2;
-        } while (processed_samples < m_sample_ct);
+        }
     }
 
-    void read_prs(uintptr_t* genotype, std::vector<PRS>& prs_list,
+    void read_prs(uintptr_t* genotype, PRSList& prs_list,
+                  const size_t ploidy, const double stat,
+                  const double adj_score, const double miss_score,
+                  const size_t miss_count, const double homcom_weight,
+                  const double het_weight, const double homrar_weight,
+                  const bool not_first)
+    {
+        const double scores[4] = {homcom_weight * stat - adj_score,
+                                  het_weight * stat - adj_score, miss_score,
+                                  homrar_weight * stat - adj_score};
+        const size_t miss_deficit = ploidy - miss_count;
+        if (not_first) { prs_list.num_snp += ploidy; }
+        else
+        {
+            prs_list.base = 0.0;
+            prs_list.num_snp = ploidy;
+            prs_list.num_miss.clear();
+        }
+        if (not_first && miss_deficit != 0)
+        {
+            process_sample_prs<true, true>(genotype, prs_list.prs.data(),
+                                           prs_list, scores, miss_deficit);
+        }
+        else if (not_first)
+        {
+            process_sample_prs<true, false>(genotype, prs_list.prs.data(),
+                                            prs_list, scores, miss_deficit);
+        }
+        else if (miss_deficit != 0)
+        {
+            process_sample_prs<false, true>(genotype, prs_list.prs.data(),
+                                            prs_list, scores, miss_deficit);
+        }
+        else
+        {
+            process_sample_prs<false, false>(genotype, prs_list.prs.data(),
+                                             prs_list, scores, miss_deficit);
+        }
+    }
+    /*!
+     * \brief Add the score of one rare variant to all samples. The score of
+     *        the baseline genotype is added to the shared score of the list
+     *        and only the carriers are updated
+     * \param carriers is the sparse genotype of the variant
+     * \param prs_list is the per sample score
+     * \param not_first indicate if we should add to the existing score
+     */
+    void read_prs(const CarrierList& carriers, PRSList& prs_list,
                   const size_t ploidy, const double stat,
                   const double adj_score, const double miss_score,
                   const size_t miss_count, const double homcom_weight,
                   const double het_weight, const double homrar_weight,
                   const bool not_first)
     {
-        std::vector<double> scores = {homcom_weight * stat - adj_score,
-                                      het_weight * stat - adj_score, miss_score,
-                                      homrar_weight * stat - adj_score};
-        std::vector<size_t> counts = {ploidy, ploidy, miss_count, ploidy};
+        constexpr uint32_t miss_geno = 2;
+        const double scores[4] = {homcom_weight * stat - adj_score,
+                                  het_weight * stat - adj_score, miss_score,
+                                  homrar_weight * stat - adj_score};
+        const size_t miss_deficit = ploidy - miss_count;
+        const double baseline = scores[carriers.baseline];
         if (not_first)
         {
-            process_sample_prs(genotype, prs_list, scores, counts,
-                               &Genotype::update_sample_prs);
+            prs_list.base += baseline;
+            prs_list.num_snp += ploidy;
+        }
+        else
+        {
+            std::fill(prs_list.prs.begin(), prs_list.prs.end(), 0.0);
+            prs_list.base = baseline;
+            prs_list.num_snp = ploidy;
+            prs_list.num_miss.clear();
+        }
+        double* prs = prs_list.prs.data();
+        for (auto&& carrier : carriers.samples)
+        {
+            const uint32_t geno = carrier & 3;
+            const size_t sample_idx = carrier >> 2;
+            prs[sample_idx] += scores[geno] - baseline;
+            if (geno == miss_geno)
+            { prs_list.add_missing(sample_idx, miss_deficit); }
+        }
+    }
+    /*!
+     * \brief Add the score of one rare variant under an additional genetic
+     *        model. The allele count is shared with the main model and is
+     *        not updated
+     * \param carriers is the sparse genotype of the variant
+     * \param prs is the per sample score of the model
+     * \param base is the score shared by all samples of the model
+     * \param scores is the score of each genotype encoding
+     * \param not_first indicate if we should add to the existing score
+     */
+    void read_model_prs(const CarrierList& carriers, std::vector<double>& prs,
+                        double& base, const double scores[4],
+                        const bool not_first) const
+    {
+        const double baseline = scores[carriers.baseline];
+        if (not_first) { base += baseline; }
+        else
+        {
+            std::fill(prs.begin(), prs.end(), 0.0);
+            base = baseline;
+        }
+        for (auto&& carrier : carriers.samples)
+        { prs[carrier >> 2] += scores[carrier & 3] - baseline; }
+    }
+    /*!
+     * \brief Check if a variant should be scored from its carriers
+     * \param homcom_ct is the number of homozygous common allele
+     * \param het_ct is the number of heterozygous
+     * \param homrar_ct is the number of homozygous rare allele
+     * \param baseline return the most common genotype, using the complement
+     *        of the PLINK encoding
+     * \return true if the MAF of the variant is below the sparse threshold
+     */
+    bool use_carrier_list(const uint32_t homcom_ct, const uint32_t het_ct,
+                          const uint32_t homrar_ct, uint32_t& baseline) const
+    {
+        const uint32_t total = homcom_ct + het_ct + homrar_ct;
+        if (total == 0) return false;
+        const double freq = static_cast<double>(het_ct + 2 * homrar_ct)
+                            / (2.0 * static_cast<double>(total));
+        if (std::min(freq, 1.0 - freq) >= m_prs_calculation.sparse_maf)
+            return false;
+        baseline = 0;
+        if (het_ct > homcom_ct && het_ct >= homrar_ct) { baseline = 1; }
+        else if (homrar_ct > homcom_ct && homrar_ct > het_ct)
+        {
+            baseline = 3;
+        }
+        return true;
+    }
+    /*!
+     * \brief Collect the samples whose genotype differs from the baseline.
+     *        Words where all samples carry the baseline are skipped
+     * \param genotype is the packed genotype of the m_sample_ct samples
+     * \param baseline is the most common genotype, using the complement of
+     *        the PLINK encoding
+     * \param carriers return the sparse genotype of the variant
+     */
+    void build_carrier_list(const uintptr_t* genotype, const uint32_t baseline,
+                            CarrierList& carriers) const
+    {
+        carriers.baseline = baseline;
+        carriers.samples.clear();
+        // PLINK encoding of the baseline, repeated for each sample of a word
+        const uintptr_t pattern =
+            static_cast<uintptr_t>(~baseline & 3) * (~uintptr_t(0) / 3);
+        const size_t num_word = (m_sample_ct + BITCT2 - 1) / BITCT2;
+        const size_t remain = m_sample_ct % BITCT2;
+        for (size_t i = 0; i < num_word; ++i)
+        {
+            uintptr_t diff = genotype[i] ^ pattern;
+            if (remain != 0 && i == num_word - 1)
+            { diff &= (ONELU << (2 * remain)) - ONELU; }
+            while (diff != 0)
+            {
+                const uint32_t shift =
+                    static_cast<uint32_t>(CTZLU(diff)) & ~uint32_t(1);
+                const uint32_t geno =
+                    static_cast<uint32_t>(~(genotype[i] >> shift)) & 3;
+                carriers.samples.push_back(
+                    static_cast<uint32_t>((i * BITCT2 + shift / 2) << 2)
+                    | geno);
+                diff &= ~(static_cast<uintptr_t>(3) << shift);
+            }
+        }
+    }
+    /*!
+     * \brief Call a function with the missing score handling of the current
+     *        run as a compile time constant, such that the scoring loop is
+     *        instantiated once per handling
+     * \param func is called with a std::integral_constant of MISSING_SCORE
+     */
+    template <typename Function>
+    void dispatch_missing_score(Function&& func) const
+    {
+        switch (m_prs_calculation.missing_score)
+        {
+        case MISSING_SCORE::MEAN_IMPUTE:
+            func(std::integral_constant<MISSING_SCORE,
+                                        MISSING_SCORE::MEAN_IMPUTE>());
+            break;
+        case MISSING_SCORE::IMPUTE_CONTROL:
+            func(std::integral_constant<MISSING_SCORE,
+                                        MISSING_SCORE::IMPUTE_CONTROL>());
+            break;
+        case MISSING_SCORE::SET_ZERO:
+            func(std::integral_constant<MISSING_SCORE,
+                                        MISSING_SCORE::SET_ZERO>());
+            break;
+        case MISSING_SCORE::CENTER:
+            func(
+                std::integral_constant<MISSING_SCORE, MISSING_SCORE::CENTER>());
+            break;
+        }
+    }
+    /*!
+     * \brief Add the hard coded score of a variant to all samples. The
+     *        handling of missing genotypes is fixed at compile time so that
+     *        the allele count table is constant and the MAF is only
+     *        calculated when it is used for centring or imputation. Rare
+     *        variants are scored from their carriers when requested. All
+     *        genetic models are scored from the same genotype
+     * \tparam missing is the missing score handling
+     * \param genotype is the packed genotype of the m_sample_ct samples, not
+     *        used if the carriers of the variant are stored
+     * \param prs_list is the per sample score
+     * \param snp is the variant
+     * \param homcom_ct is the number of homozygous common allele
+     * \param het_ct is the number of heterozygous
+     * \param homrar_ct is the number of homozygous rare allele
+     * \param not_first indicate if we should add to the existing score
+     * \param carriers is the buffer for the carriers of the variant
+     */
+    template <MISSING_SCORE missing>
+    void add_hard_coded_prs(uintptr_t* genotype, PRSList& prs_list,
+                            const SNP& snp, const uint32_t homcom_ct,
+                            const uint32_t het_ct, const uint32_t homrar_ct,
+                            const bool not_first, CarrierList& carriers)
+    {
+        // currently hard code ploidy to 2. Will keep it this way unil we
+        // know how to properly handly non-diploid chromosomes
+        constexpr size_t ploidy = 2;
+        constexpr size_t miss_count =
+            (missing != MISSING_SCORE::SET_ZERO) * ploidy;
+        const double stat = snp.stat();
+        // the centring or imputation score of a model, with the weights
+        // already flipped
+        auto model_adjust = [&](const std::array<double, 3>& weight) {
+            const double maf =
+                1.0
+                - static_cast<double>(weight[0] * homcom_ct
+                                      + het_ct * weight[1]
+                                      + weight[2] * homrar_ct)
+                      / (static_cast<double>(homcom_ct + het_ct + homrar_ct)
+                         * ploidy);
+            return ploidy * stat * maf;
+        };
+        std::array<double, 3> weight = {m_homcom_weight, m_het_weight,
+                                        m_homrar_weight};
+        if (snp.is_flipped()) { std::swap(weight[0], weight[2]); }
+        double adj_score = 0, miss_score = 0;
+        if constexpr (missing == MISSING_SCORE::CENTER)
+        { adj_score = model_adjust(weight); }
+        else if constexpr (missing == MISSING_SCORE::MEAN_IMPUTE)
+        {
+            miss_score = model_adjust(weight);
+        }
+        uint32_t baseline = 0;
+        const CarrierList* sparse = nullptr;
+        if (snp.sparse_genotype()) { sparse = &snp.carriers(); }
+        else if (use_carrier_list(homcom_ct, het_ct, homrar_ct, baseline))
+        {
+            build_carrier_list(genotype, baseline, carriers);
+            sparse = &carriers;
+        }
+        if (sparse != nullptr)
+        {
+            read_prs(*sparse, prs_list, ploidy, stat, adj_score, miss_score,
+                     miss_count, weight[0], weight[1], weight[2], not_first);
         }
         else
         {
-            process_sample_prs(genotype, prs_list, scores, counts,
-                               &Genotype::initialize_sample_prs);
+            read_prs(genotype, prs_list, ploidy, stat, adj_score, miss_score,
+                     miss_count, weight[0], weight[1], weight[2], not_first);
+        }
+        // the other genetic models reuse the genotype that was just read
+        for (size_t i_model = 0; i_model < m_model_weights.size(); ++i_model)
+        {
+            weight = m_model_weights[i_model];
+            if (snp.is_flipped()) { std::swap(weight[0], weight[2]); }
+            adj_score = 0;
+            miss_score = 0;
+            if constexpr (missing == MISSING_SCORE::CENTER)
+            { adj_score = model_adjust(weight); }
+            else if constexpr (missing == MISSING_SCORE::MEAN_IMPUTE)
+            {
+                miss_score = model_adjust(weight);
+            }
+            const double scores[4] = {weight[0] * stat - adj_score,
+                                      weight[1] * stat - adj_score, miss_score,
+                                      weight[2] * stat - adj_score};
+            auto&& prs = prs_list.model_prs[i_model];
+            auto&& base = prs_list.model_base[i_model];
+            if (sparse != nullptr)
+            { read_model_prs(*sparse, prs, base, scores, not_first); }
+            else if (not_first)
+            {
+                process_sample_prs<true, false>(genotype, prs.data(),
+                                                prs_list, scores, 0);
+            }
+            else
+            {
+                base = 0.0;
+                process_sample_prs<false, false>(genotype, prs.data(),
+                                                 prs_list, scores, 0);
+            }
         }
     }
 
 
-    virtual inline void count_and_read_genotype(SNP& /* snp*/) {}
+    /*!
+     * \brief Fill the rows of a block whose size and index are already set.
+     *        Variants are read one at a time unless overridden
+     */
+    virtual void read_block(GenotypeBlock& block, GenotypeCursor& cursor);
+    /*!
+     * \brief Fill the packed row of a variant already in memory
+     * \return false if the genotype of the variant has to be read from file
+     */
+    bool stored_row(SNP& snp, uintptr_t* row) const;
+    /*!
+     * \brief Add the score of a row of a decoded block to the per sample
+     *        score, with the same result as read_score on the variant.
+     *        Variants without any called genotype are skipped
+     * \param block is the decoded block
+     * \param i is the row of the variant in the block
+     * \param prs_list is the per sample score to add to
+     * \param carriers is the buffer for the carriers of the variant
+     */
+    void add_block_score(GenotypeBlock& block, const size_t i,
+                         PRSList& prs_list, CarrierList& carriers);
+    /*!
+     * \brief Add the dosage score of a variant to all samples, as the
+     *        Add_PRS interpreter does when reading the bgen file
+     * \param genotype is the probabilities of the three genotypes of each
+     *        sample, NaN for missing samples
+     * \param prs_list is the per sample score to add to
+     * \param snp is the variant
+     */
+    void add_dosage_prs(const double* genotype, PRSList& prs_list,
+                        const SNP& snp);
     virtual inline void
     read_genotype(const SNP& /*snp*/, const uintptr_t /* selected_size*/,
-                  FileRead& /*genotype_file*/, uintptr_t* /*tmp_store*/,
-                  uintptr_t* /*genotype*/, uintptr_t* /* subset_mask*/,
-                  bool is_ref = false)
+                  GenotypeCursor& /*cursor*/, uintptr_t* /*genotype*/,
+                  uintptr_t* /* subset_mask*/, bool is_ref = false)
     {
     }
+    /*!
+     * \brief Add the score of the variants to prs_list. Genotypes not in
+     *        memory are read with the provided cursor, so that different
+     *        threads can score concurrently as long as each has its own
+     *        cursor and score list
+     * \param cursor is the read state owned by the calling thread
+     */
     virtual void
-    read_score(std::vector<PRS>& /*prs_list*/,
+    read_score(PRSList& /*prs_list*/,
                const std::vector<size_t>::const_iterator& /*start*/,
                const std::vector<size_t>::const_iterator& /*end*/,
-               bool /*reset_zero*/)
+               bool /*reset_zero*/, GenotypeCursor& /*cursor*/)
+    {
+    }
+    void read_score(PRSList& prs_list,
+                    const std::vector<size_t>::const_iterator& start,
+                    const std::vector<size_t>::const_iterator& end,
+                    bool reset_zero)
     {
+        read_score(prs_list, start, end, reset_zero, m_cursor);
     }
     void read_score(const std::vector<size_t>::const_iterator& start,
                     const std::vector<size_t>::const_iterator& end,
                     bool reset_zero)
     {
-        read_score(m_prs_info, start, end, reset_zero);
+        const size_t num_variant =
+            static_cast<size_t>(std::distance(start, end));
+        if (num_variant > score_chunk_size)
+        { parallel_read_score(start, end, reset_zero); }
+        else
+        {
+            read_score(m_prs_info, start, end, reset_zero);
+        }
     }
+    /*!
+     * \brief Score the variants in chunks of score_chunk_size variants. The
+     *        first chunk is scored into m_prs_info, every other chunk into a
+     *        zeroed per thread buffer that is added to m_prs_info in chunk
+     *        order. The chunks, and therefore the rounding of the sum, don't
+     *        depend on the number of threads scoring them
+     */
+    void parallel_read_score(const std::vector<size_t>::const_iterator& start,
+                             const std::vector<size_t>::const_iterator& end,
+                             bool reset_zero);
+    // number of variants scored into a buffer before it is added to the
+    // score. Large enough for the addition of the buffer to be negligible
+    static constexpr size_t score_chunk_size = 256;
     void standardize_prs();
+    const PRSList& active_scores() const
+    {
+        return (m_score_view == nullptr) ? m_prs_info : *m_score_view;
+    }
     // for loading the sample inclusion / exclusion set
     /*!
      * \brief Function to load in the sample extraction exclusion list
@@ -1,11 +1,51 @@
 #ifndef GenotypePool_HPP
 #define GenotypePool_HPP
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <stdexcept>
 #include <plink_common.hpp>
+#include <utility>
 #include <vector>
 // modified based on https://thinkingeek.com/2017/11/19/simple-memory-pool/
 
+/*!
+ * \brief Memory budget (in bytes) shared by all GenotypePool of the same run
+ *        (e.g. one pool per clumping thread)
+ */
+class MemoryBudget
+{
+private:
+    std::atomic<size_t> m_used = 0;
+    size_t m_limit;
+
+public:
+    explicit MemoryBudget(size_t limit) : m_limit(limit) {}
+    /*!
+     * \brief Try to reserve memory from the budget
+     * \param bytes is the amount of memory required
+     * \return true if the memory is reserved
+     */
+    bool reserve(size_t bytes)
+    {
+        size_t used = m_used.load();
+        do
+        {
+            if (used + bytes > m_limit) return false;
+        } while (!m_used.compare_exchange_weak(used, used + bytes));
+        return true;
+    }
+    /*!
+     * \brief Reserve memory regardless of the limit. Used for the minimal
+     *        amount of memory required for any progress
+     */
+    void force_reserve(size_t bytes) { m_used += bytes; }
+    void release(size_t bytes) { m_used -= bytes; }
+    size_t used() const { return m_used.load(); }
+    size_t limit() const { return m_limit; }
+};
+
 class IndividualGenotype
 {
 private:
@@ -48,6 +88,12 @@ private:
             , m_genotype_list(new IndividualGenotype[num_snps])
 
         {
+            if (num_snps == 0)
+            {
+                throw std::runtime_error(
+                    "Error: Cannot create a genotype pool without any row. "
+                    "This should not happen. Please report this error");
+            }
             // m_genotypes.resize(num_snps * memory_per_snp, 0);
             // initialize the linked list
             m_genotype_list[0].set_start_location(m_genotypes.get());
@@ -78,6 +124,8 @@ private:
     size_t m_memory_per_snp;
     std::unique_ptr<MemoryPool> m_memory_pool;
     IndividualGenotype* m_free_list;
+    MemoryBudget* m_budget = nullptr;
+    size_t m_reserved = 0;
 
 public:
     GenotypePool() {};
@@ -88,10 +136,77 @@ public:
         , m_free_list(m_memory_pool->get_genotype_location())
     {
     }
+    /*!
+     * \brief Construct a pool that only grows when the shared budget allows.
+     *        The initial block is always allocated
+     */
+    GenotypePool(size_t num_snps, size_t memory_per_snp, MemoryBudget* budget)
+        : GenotypePool(num_snps, memory_per_snp)
+    {
+        m_budget = budget;
+        if (m_budget != nullptr)
+        {
+            m_reserved = block_size();
+            m_budget->force_reserve(m_reserved);
+        }
+    }
+    ~GenotypePool()
+    {
+        if (m_budget != nullptr) m_budget->release(m_reserved);
+    }
+    GenotypePool(GenotypePool&& other) noexcept { *this = std::move(other); }
+    GenotypePool& operator=(GenotypePool&& other) noexcept
+    {
+        if (m_budget != nullptr) m_budget->release(m_reserved);
+        m_num_snps = other.m_num_snps;
+        m_memory_per_snp = other.m_memory_per_snp;
+        m_memory_pool = std::move(other.m_memory_pool);
+        m_free_list = other.m_free_list;
+        m_budget = other.m_budget;
+        m_reserved = other.m_reserved;
+        other.m_free_list = nullptr;
+        other.m_budget = nullptr;
+        other.m_reserved = 0;
+        return *this;
+    }
+    /*!
+     * \brief Number of bytes required for each block of the pool. Uses the
+     *        same row size as row_size so that budgets calculated from it
+     *        match the memory reserved
+     */
+    size_t block_size() const
+    {
+        return m_num_snps * row_size(m_memory_per_snp) + sizeof(MemoryPool);
+    }
+    /*!
+     * \brief Number of bytes required for each genotype row
+     */
+    static size_t row_size(size_t memory_per_snp)
+    {
+        return round_up_pow2(memory_per_snp, CACHELINE) * sizeof(uintptr_t)
+               + sizeof(IndividualGenotype);
+    }
+    /*!
+     * \brief Check if a row can be allocated without exceeding the budget
+     */
+    bool can_alloc() const
+    {
+        return m_free_list != nullptr || m_budget == nullptr
+               || m_budget->used() + block_size() <= m_budget->limit();
+    }
+    /*!
+     * \brief Allocate a genotype row. Will grow the pool when required.
+     * \return the row, or nullptr if growing the pool would exceed the budget
+     */
     IndividualGenotype* alloc()
     {
         if (m_free_list == nullptr)
         {
+            if (m_budget != nullptr)
+            {
+                if (!m_budget->reserve(block_size())) return nullptr;
+                m_reserved += block_size();
+            }
             std::unique_ptr<MemoryPool> new_pool(
                 new MemoryPool(m_num_snps, m_memory_per_snp));
             new_pool->set_next_collection(std::move(m_memory_pool));
@@ -0,0 +1,155 @@
+// This file is part of PRSice-2, copyright (C) 2016-2019
+// Shing Wan Choi, Paul F. O’Reilly
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LD_CACHE_HPP
+#define LD_CACHE_HPP
+
+#include "misc.hpp"
+#include "snp.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * \brief Sparse on-disk store of the pairwise R2 between variants of a
+ *        reference panel. Only pairs within the clumping window with R2 above
+ *        the floor are kept. The R2 are stored at full precision so that
+ *        clumping with the cache gives the same result as clumping from the
+ *        genotypes. The cache is keyed by the identity of the reference file,
+ *        the samples used for LD calculation and the clumping distance, so
+ *        that repeated runs against the same reference can skip the genotype
+ *        reading and R2 calculation
+ */
+class LDCache
+{
+public:
+    static constexpr uint32_t not_cached = ~uint32_t(0);
+    LDCache() {}
+    /*!
+     * \brief Initialize an empty cache for the provided variants. Variant
+     *        index in the cache follows the order of snps
+     * \param key is the identity of the reference panel
+     * \param r2_floor is the minimum R2 to be stored
+     * \param snps is the list of variants
+     */
+    void reset(const uint64_t key, const double r2_floor,
+               const std::vector<SNP>& snps)
+    {
+        m_key = key;
+        m_r2_floor = r2_floor;
+        m_snp_id.clear();
+        m_chr.clear();
+        m_loc.clear();
+        m_snp_id.reserve(snps.size());
+        m_chr.reserve(snps.size());
+        m_loc.reserve(snps.size());
+        for (auto&& snp : snps)
+        {
+            m_snp_id.push_back(snp.rs());
+            m_chr.push_back(snp.chr());
+            m_loc.push_back(snp.loc());
+        }
+        m_partners.clear();
+        m_partners.resize(snps.size());
+    }
+    /*!
+     * \brief Add the R2 between two variants to the cache. Must be called
+     *        with first < second and with second in ascending order for
+     *        each first, so that the partner list remain sorted. Different
+     *        first can be added from different threads
+     * \param first is the cache index of the first variant
+     * \param second is the cache index of the second variant
+     * \param r2 is the R2 between the two variants
+     * \return the number of bytes the cache grew by
+     */
+    size_t add(const uint32_t first, const uint32_t second, const double r2)
+    {
+        assert(first < second);
+        if (r2 < m_r2_floor) return 0;
+        auto&& partners = m_partners[first];
+        const size_t capacity = partners.capacity();
+        partners.push_back(LDEntry {second, r2});
+        return (partners.capacity() - capacity) * sizeof(LDEntry);
+    }
+    /*!
+     * \brief Obtain the R2 between two cached variants. Pairs not stored are
+     *        below the floor, and are returned as 0
+     */
+    double r2(const uint32_t a, const uint32_t b) const
+    {
+        const uint32_t first = std::min(a, b), second = std::max(a, b);
+        auto&& partners = m_partners[first];
+        auto res = std::lower_bound(partners.begin(), partners.end(), second,
+                                    [](const LDEntry& e, const uint32_t idx) {
+                                        return e.partner < idx;
+                                    });
+        if (res == partners.end() || res->partner != second) return 0.0;
+        return res->r2;
+    }
+    /*!
+     * \brief Map each of the input variants to its cache index
+     * \param snps is the list of variants
+     * \return vector containing the cache index of each variant, or
+     *         not_cached if the variant isn't in the cache
+     */
+    std::vector<uint32_t> index_snps(const std::vector<SNP>& snps) const;
+    /*!
+     * \brief Load the cache from file
+     * \param file_name is the name of the cache file
+     * \param key is the expected identity of the reference panel
+     * \param min_r2 is the smallest R2 required. Cache with a floor larger
+     *        than this cannot be used
+     * \return true if the cache is loaded and valid
+     */
+    bool load(const std::string& file_name, const uint64_t key,
+              const double min_r2);
+    void save(const std::string& file_name) const;
+    size_t num_snps() const { return m_snp_id.size(); }
+    size_t num_pairs() const
+    {
+        size_t total = 0;
+        for (auto&& p : m_partners) total += p.size();
+        return total;
+    }
+    double r2_floor() const { return m_r2_floor; }
+    void clear()
+    {
+        m_snp_id.clear();
+        m_chr.clear();
+        m_loc.clear();
+        m_partners.clear();
+        m_key = 0;
+    }
+
+private:
+    struct LDEntry
+    {
+        uint32_t partner;
+        double r2;
+    };
+    std::vector<std::string> m_snp_id;
+    std::vector<size_t> m_chr;
+    std::vector<size_t> m_loc;
+    std::vector<std::vector<LDEntry>> m_partners;
+    uint64_t m_key = 0;
+    double m_r2_floor = 0.0;
+};
+
+#endif // LD_CACHE_HPP
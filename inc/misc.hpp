@@ -1308,6 +1308,35 @@ inline bool hasEnding(const std::string& fullString, const std::string& ending)
     }
 }
 
+/*!
+ * \brief 64 bit FNV-1a hash of a block of memory. Use for generating the
+ *        identity key of on-disk caches, thus must be stable across runs and
+ *        platforms (unlike std::hash)
+ * \param data is the start of the memory block
+ * \param size is the number of bytes to hash
+ * \param seed is the previous hash, allowing multiple blocks to be chained
+ * \return the hash value
+ */
+inline uint64_t hash_bytes(const void* data, const size_t size,
+                           uint64_t seed = 14695981039346656037ULL)
+{
+    const unsigned char* ptr = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        seed ^= ptr[i];
+        seed *= 1099511628211ULL;
+    }
+    return seed;
+}
+inline uint64_t hash_bytes(const std::string& str,
+                           uint64_t seed = 14695981039346656037ULL)
+{
+    // include the length so that "ab"+"c" and "a"+"bc" differ
+    const uint64_t length = str.size();
+    seed = hash_bytes(&length, sizeof(length), seed);
+    return hash_bytes(str.data(), str.size(), seed);
+}
+
 /**
  * Returns the peak (maximum so far) resident set size (physical
  * memory use) measured in bytes, or zero if the value cannot be
@@ -0,0 +1,87 @@
+// This file is part of PRSice-2, copyright (C) 2016-2019
+// Shing Wan Choi, Paul F. O’Reilly
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef PARTIAL_SCORES_HPP
+#define PARTIAL_SCORES_HPP
+
+#include "storage.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief Partial scores of each p-value threshold, one from each chromosome
+ *        scored with --chr-stream. The partial scores are written to a
+ *        temporary file as each chromosome is scored and are read back one at
+ *        a time when the score of each threshold is summed, so that only the
+ *        score being summed is held in memory instead of the score of every
+ *        threshold
+ */
+class PartialScores
+{
+public:
+    PartialScores() {}
+    PartialScores(const PartialScores&) = delete;
+    PartialScores& operator=(const PartialScores&) = delete;
+    ~PartialScores() { close(); }
+    /*!
+     * \brief Create the temporary file storing the partial scores. Any
+     *        existing file with the same name is overwritten
+     */
+    void open(const std::string& file_name);
+    /*!
+     * \brief Close and remove the temporary file
+     */
+    void close();
+    /*!
+     * \brief Store the partial score of a threshold. All partial scores must
+     *        have the same samples
+     * \param threshold is the p-value threshold of the score
+     * \param scores is the score of the variants of the threshold
+     * \param num_snp is the number of variants included in the score
+     */
+    void add(const double threshold, const PRSList& scores,
+             const uint32_t num_snp);
+    /*!
+     * \brief Add the partial scores of a threshold to scores
+     * \return the number of variants included in the partial scores
+     */
+    uint32_t add_to(const double threshold, PRSList& scores);
+    bool empty() const { return m_thresholds.empty(); }
+    size_t size() const { return m_thresholds.size(); }
+    /*!
+     * \brief Return the location of the partial scores of each threshold,
+     *        in ascending order of the thresholds
+     */
+    const std::map<double, std::vector<std::streampos>>& thresholds() const
+    {
+        return m_thresholds;
+    }
+
+private:
+    std::map<double, std::vector<std::streampos>> m_thresholds;
+    std::fstream m_file;
+    std::string m_file_name;
+    PRSList m_buffer;
+    size_t m_num_sample = 0;
+};
+
+#endif // PARTIAL_SCORES_HPP
@@ -7,7 +7,10 @@
 #include "region.hpp"
 #include "reporter.hpp"
 #include <exception>
+#include <map>
+#include <memory>
 #include <ostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -44,33 +47,43 @@ print_empty_region(const std::string& out,
     }
 }
 
+inline void configure_genotype(const Commander& commander,
+                               Genotype* current_file)
+{
+    current_file->keep_nonfounder(commander.nonfounders())
+        .keep_ambig(commander.keep_ambig())
+        .intermediate(commander.use_inter())
+        .keep_sample_id(!commander.prepare_ref().empty())
+        .set_prs_instruction(commander.get_prs_instruction())
+        .set_weight(commander.get_prs_instruction().genetic_model);
+    current_file->parse_chr_id_formula(commander.chr_id_formula());
+}
+
 inline void initialize_genotype(
     const std::vector<IITree<size_t, size_t>>& exclusion_regions,
     const Commander& commander, Genotype* current_file, Reporter& reporter,
-    Genotype* target_file)
+    Genotype* target_file, const BaseFile& base_file)
 {
     bool is_ref = true;
     std::string type = "reference";
     const std::string separator =
         "==================================================";
-    current_file =
-        &current_file->keep_nonfounder(commander.nonfounders())
-             .keep_ambig(commander.keep_ambig())
-             .intermediate(commander.use_inter())
-             .set_prs_instruction(commander.get_prs_instruction())
-             .set_weight(commander.get_prs_instruction().genetic_model);
-    current_file->parse_chr_id_formula(commander.chr_id_formula());
+    configure_genotype(commander, current_file);
     if (target_file == nullptr)
     {
         is_ref = false;
         type = "target";
-        const std::string base_name = commander.get_base_name();
+        const std::string base_name = misc::remove_extension<std::string>(
+            misc::base_name<std::string>(base_file.file_name));
         reporter.report("Start processing " + base_name + "\n" + separator);
         current_file->snp_extraction(commander.extract_file(),
                                      commander.exclude_file());
         auto [filter_count, dup_rs_id] = current_file->read_base(
-            commander.get_base(), commander.get_base_qc(),
+            base_file, commander.get_base_qc(),
             commander.get_p_threshold(), exclusion_regions);
+        // chromosome without any base variant is skipped by --chr-stream
+        if (current_file->streaming() && current_file->num_snps() == 0)
+            return;
         current_file->print_base_stat(filter_count, dup_rs_id, commander.out(),
                                       commander.get_base_qc().info_score);
         current_file->set_thresholds(commander.get_target_qc());
@@ -91,10 +104,13 @@ inline void initialize_genotype(
 inline void
 initialize_target(const std::vector<IITree<size_t, size_t>>& exclusion_regions,
                   const Commander& commander, Genotype* target_file,
-                  Reporter& reporter)
+                  Reporter& reporter, const std::string& base_file = "")
 {
+    // other base files of --base-list share the format of the first one
+    BaseFile base = commander.get_base();
+    if (!base_file.empty()) base.file_name = base_file;
     initialize_genotype(exclusion_regions, commander, target_file, reporter,
-                        nullptr);
+                        nullptr, base);
 }
 inline void initialize_reference(
     const std::vector<IITree<size_t, size_t>>& exclusion_regions,
@@ -102,7 +118,7 @@ inline void initialize_reference(
     Reporter& reporter)
 {
     initialize_genotype(exclusion_regions, commander, reference_file, reporter,
-                        target_file);
+                        target_file, commander.get_base());
 }
 
 std::string print_project_summary(std::vector<size_t>& significant_store)
@@ -153,6 +169,29 @@ std::string print_project_summary(std::vector<size_t>& significant_store)
     return message;
 }
 
+/*!
+ * \brief Return the label of each genetic model scored, with the main model
+ *        first
+ */
+inline std::vector<std::string> get_model_names(const CalculatePRS& prs_info)
+{
+    std::vector<MODEL> models = {prs_info.genetic_model};
+    models.insert(models.end(), prs_info.other_models.begin(),
+                  prs_info.other_models.end());
+    std::vector<std::string> names;
+    for (auto&& model : models)
+    {
+        switch (model)
+        {
+        case MODEL::DOMINANT: names.push_back("dom"); break;
+        case MODEL::RECESSIVE: names.push_back("rec"); break;
+        case MODEL::HETEROZYGOUS: names.push_back("het"); break;
+        default: names.push_back("add"); break;
+        }
+    }
+    return names;
+}
+
 inline std::tuple<std::vector<std::string>, size_t>
 add_gene_set_info(const Commander& commander, Genotype* target_file,
                   Reporter& reporter)
@@ -166,6 +205,90 @@ add_gene_set_info(const Commander& commander, Genotype* target_file,
     return {region.get_names(), num_regions};
 }
 
+/*!
+ * \brief Load, filter, clump and score the variants one chromosome at a time,
+ *        so that only the variants of a single chromosome are held in memory.
+ *        The target file only load the samples, which are used for the
+ *        regression
+ * \param partial stores the partial score of each chromosome and threshold,
+ *        in a temporary file named after the output prefix
+ */
+inline void
+stream_chromosomes(const std::vector<IITree<size_t, size_t>>& exclusion_regions,
+                   const Commander& commander, GenomeFactory& factory,
+                   Genotype* target_file, PartialScores& partial,
+                   Reporter& reporter)
+{
+    configure_genotype(commander, target_file);
+    target_file->load_samples();
+    auto&& clump_info = commander.get_clump_info();
+    const size_t thread = commander.get_prs_instruction().thread;
+    const unsigned long long max_memory = commander.max_memory(
+        static_cast<unsigned long long>(misc::getMemorySize() * 0.8));
+    partial.open(commander.out() + ".partial");
+    for (uint32_t chr = 1; chr <= target_file->num_autosome(); ++chr)
+    {
+        reporter.report("Processing chromosome " + std::to_string(chr));
+        std::unique_ptr<Genotype> chr_target(
+            factory.createGenotype(commander.get_target(),
+                                   commander.get_pheno(), commander.delim(),
+                                   reporter));
+        chr_target->stream_chr(chr);
+        initialize_target(exclusion_regions, commander, chr_target.get(),
+                          reporter);
+        if (chr_target->num_snps() == 0) continue;
+        std::unique_ptr<Genotype> chr_reference = nullptr;
+        if (commander.use_ref() && commander.need_ref())
+        {
+            chr_reference.reset(factory.createGenotype(
+                commander.get_reference(), commander.get_pheno(),
+                commander.delim(), reporter));
+            initialize_reference(exclusion_regions, commander, chr_target.get(),
+                                 chr_reference.get(), reporter);
+        }
+        chr_target->calc_freqs_and_intermediate(commander.get_target_qc(),
+                                                commander.out(), true);
+        if (chr_reference != nullptr)
+        {
+            chr_reference->set_thresholds(commander.get_ref_qc());
+            chr_reference->calc_freqs_and_intermediate(
+                commander.get_ref_qc(), commander.out(), true,
+                chr_target.get());
+        }
+        if (chr_target->num_snps() == 0) continue;
+        const auto [region_names, num_regions] =
+            add_gene_set_info(commander, chr_target.get(), reporter);
+        if (!clump_info.no_clump)
+        {
+            auto&& ld_reference =
+                (chr_reference != nullptr) ? *chr_reference : *chr_target;
+            ld_reference.subset_ld_samples(clump_info.ld_sample_size,
+                                           commander.get_perm().seed);
+            chr_target->build_clump_windows(clump_info.distance);
+            chr_target->sort_by_p();
+            // each chromosome has its own LD cache, so that the cache of one
+            // chromosome isn't replaced by the next
+            Clumping chr_clump = clump_info;
+            if (!chr_clump.ld_cache.empty())
+            { chr_clump.ld_cache.append(".chr" + std::to_string(chr)); }
+            chr_target->clumping(chr_clump, ld_reference, thread, max_memory);
+            ld_reference.restore_ld_samples();
+        }
+        // the reference is not required once the chromosome is clumped
+        chr_reference.reset();
+        if (commander.ultra_aggressive())
+        { chr_target->load_genotype_to_memory(); }
+        chr_target->prepare_prsice();
+        std::ostringstream snp_file;
+        const auto region_membership = chr_target->build_membership_matrix(
+            num_regions, region_names, false, snp_file);
+        chr_target->add_partial_scores(region_membership[0], partial);
+    }
+    if (partial.empty())
+    { throw std::runtime_error("Error: No variant remained!\n"); }
+    target_file->set_stream_thresholds(partial);
+}
+
 void print_prsice_header(const bool has_prevalence, const bool no_regress,
                          std::unique_ptr<std::ostream>& prsice_out)
 {
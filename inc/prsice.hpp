@@ -32,12 +32,15 @@
 #include <atomic>
 #include <chrono>
 #include <errno.h>
+#include <exception>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <map>
 #include <math.h>
 #include <mutex>
 #include <random>
+#include <sstream>
 #include <stdexcept>
 #include <stdio.h>
 #include <string>
@@ -67,6 +70,7 @@
 #endif
 // This should be the class to handle all the procedures
 
+struct PhenoRun;
 class PRSice
 {
 public:
@@ -140,6 +144,36 @@ public:
                     std::unique_ptr<std::ostream>& best_score_file,
                     std::unique_ptr<std::ostream>& all_score_file,
                     Genotype& target);
+    /*!
+     * \brief Calculate the PRS of a region once for each threshold and
+     * regress it against all phenotypes and genetic models
+     * \param set_snp_idx is the index of the SNPs within the region
+     * \param region_idx is the index of the current region
+     * \param all_scores is a boolean indicating if all scores are printed
+     * \param has_prevalence is a boolean indicating if prevalence is provided
+     * \param runs contains the PRSice object and output of each phenotype
+     * and genetic model
+     * \param target is the target genotype
+     */
+    static void run_prsice(const std::vector<size_t>& set_snp_idx,
+                           const size_t region_idx, const bool all_scores,
+                           const bool has_prevalence,
+                           std::vector<PhenoRun>& runs, Genotype& target);
+    /*!
+     * \brief Regress the scores summed from the partial scores of each
+     * chromosome against all phenotypes and genetic models. Used with
+     * --chr-stream, where only the base set is scored
+     * \param partial_scores contains the partial scores of each threshold
+     * \param all_scores is a boolean indicating if all scores are printed
+     * \param has_prevalence is a boolean indicating if prevalence is provided
+     * \param runs contains the PRSice object and output of each phenotype
+     * and genetic model
+     * \param target is the target genotype containing the samples
+     */
+    static void
+    run_prsice(PartialScores& partial_scores,
+               const bool all_scores, const bool has_prevalence,
+               std::vector<PhenoRun>& runs, Genotype& target);
     /*!
      * \brief Before calling this function, the target should have loaded the
      * PRS. Then this function will fill in the m_independent_variable matrix
@@ -204,6 +238,11 @@ public:
         m_total_competitive_perm_done = 0;
     }
 
+    /*!
+     * \brief Stop printing the progress, used when multiple phenotypes are
+     * processed together and only one of them need to report
+     */
+    void hide_progress() { m_show_progress = false; }
     PRSice(const PRSice&) = delete;            // disable copying
     PRSice& operator=(const PRSice&) = delete; // disable assignment
     void print_competitive_progress(bool completed = false)
@@ -221,6 +260,7 @@ public:
     }
     void print_progress(bool completed = false)
     {
+        if (!m_show_progress) return;
         double cur_progress = (static_cast<double>(m_analysis_done)
                                / static_cast<double>(m_total_process))
                               * 100.0;
@@ -356,6 +396,9 @@ protected:
     // TODO: Use other method for faster best output
     Eigen::MatrixXd m_fast_best_output;
     Eigen::VectorXd m_phenotype;
+    // covariates decomposed once for the linear regression of each score
+    Regression::CovariateProjection m_cov_projection;
+    BlockRegression m_block;
     std::unordered_map<std::string, size_t> m_sample_with_phenotypes;
     std::vector<prsice_result> m_prs_results;
     std::vector<prsice_summary> m_prs_summary; // for multiple traits
@@ -365,6 +408,7 @@ protected:
     std::vector<size_t> m_matrix_index;
     std::vector<size_t> m_significant_store {0, 0, 0};
     std::vector<bool> m_has_best_for_print;
+    std::vector<bool> m_valid_for_regress;
     column_file_info m_all_file, m_best_file;
     double m_previous_percentage = -1.0;
     double m_previous_competitive_percentage = -1.0;
@@ -382,6 +426,7 @@ protected:
     int m_best_index = -1;
     bool m_quick_best = true;
     bool m_printed_warning = false;
+    bool m_show_progress = true;
     Reporter* m_reporter;
     CalculatePRS m_prs_info;
     PThresholding m_p_info;
@@ -464,51 +509,57 @@ protected:
                           std::vector<size_t>& set_perm_res,
                           const std::vector<double>& obs_t_value,
                           const std::random_device::result_type seed,
-                          const Regress& decomposed, const size_t num_perm);
+                          const size_t first_perm, const Regress& decomposed,
+                          const size_t num_perm);
     /*!
      * \brief Once PRS analysis and permutation has been performed for all
      * p-value thresholds we will run this function to calculate the
      * empirical p-value
      */
     void process_permutations();
-
-
     /*!
-     * \brief Function to generate PRS for null set when multiple threading is
-     * used
-     * \param q is teh queue used to communicate with the consumer
-     * \param target is the target genotype, responsible for the generation of
-     * PRS
-     * \param num_consumer is the number of consumer. use for restricting the
-     * number of PRS read in at one time
-     * \param set_index is the dictionary containing the sizes of sets
-     * \param num_perm is the number of permutation to erpfrom
-     * \param require_standardize is a boolean, indicating if we want a
-     * standardized PRS
+     * \brief Reset the result containers before processing a region
      */
-    void
-    produce_null_prs(Thread_Queue<std::pair<std::vector<double>, size_t>>& q,
-                     Genotype& target, std::vector<size_t> background,
-                     size_t num_consumer,
-                     std::map<size_t, std::vector<size_t>>& set_index);
+    void start_region(const Genotype& target, const size_t region_idx);
+    /*!
+     * \brief Regress the scores of a block of thresholds together. Only
+     * used for quantitative traits, the results are used by regress_score
+     * \param block contains the score of each threshold
+     * \param start is the result index of the first threshold in the block
+     */
+    void fit_block(const std::vector<ScoreSnapshot>& block, const size_t start,
+                   Genotype& target);
+    /*!
+     * \brief Regress a block of thresholds against all runs, then process
+     * the thresholds of the block in order
+     * \param regress_threshold processes the threshold of the score
+     * currently used by target
+     */
+    static void regress_block(
+        std::vector<ScoreSnapshot>& block, const size_t prs_result_idx,
+        std::vector<PhenoRun>& runs, Genotype& target,
+        const std::function<void(double, uint32_t)>& regress_threshold);
+    /*!
+     * \brief Regress the PRS currently stored in target, and output the
+     * result of the current threshold
+     */
+    void process_threshold(const double cur_threshold,
+                           const size_t prs_result_idx,
+                           const std::string& pheno_name,
+                           const std::string& region_name, const double top,
+                           const double bot, const bool print_all_scores,
+                           const bool has_prevalence,
+                           std::unique_ptr<std::ostream>& prsice_out,
+                           std::unique_ptr<std::ostream>& all_score_file,
+                           Genotype& target);
     /*!
-     * \brief This is the "consumer" function responsible for reading in the PRS
-     * and perform the regression analysis
-     * \param q is the queue used for communication between the producer and
-     * consumer
-     * \param set_index is the dictionary containing index to ori_t_value for
-     * sets with size specified in the key
-     * \param ori_t_value contain the observed t-statistic for the  sets
-     * \param set_perm_res is the vector storing the result of permutation.
-     * Counting the number of time the permuted T is bigger than the observed T
-     * for a specific set
-     * \param is_binary indicate if the phenotype is binary or not
+     * \brief Store the best score and summary of the region after all
+     * thresholds are processed
      */
-    void consume_prs(Thread_Queue<std::pair<std::vector<double>, size_t>>& q,
-                     const Regress& decomposed,
-                     std::map<size_t, std::vector<size_t>>& set_index,
-                     const std::vector<double>& obs_t_value,
-                     std::vector<size_t>& set_perm_res);
+    void finish_region(const std::vector<std::string>& region_names,
+                       const size_t region_idx,
+                       std::unique_ptr<std::ostream>& best_score_file,
+                       Genotype& target);
 
     void null_set_no_thread(
         Genotype& target, const size_t num_background,
@@ -563,7 +614,8 @@ protected:
     void reset_result_containers(const Genotype& target,
                                  const size_t region_idx);
 
-    void fisher_yates(std::vector<size_t>& idx, std::mt19937& g, size_t n);
+    void fisher_yates(std::vector<size_t>& idx, std::mt19937& g, size_t n,
+                      std::vector<size_t>& swapped);
     template <typename T>
     class dummy_reporter
     {
@@ -581,4 +633,24 @@ protected:
     };
 };
 
+/*!
+ * \brief The PRSice object and output of a phenotype, used when the PRS of
+ * each threshold is regressed against multiple phenotypes. When runs share
+ * the thresholds, the prsice output is buffered so that the output follows
+ * the order of the phenotypes
+ */
+struct PhenoRun
+{
+    std::unique_ptr<PRSice> prsice;
+    std::unique_ptr<std::ostream> prsice_out;
+    std::unique_ptr<std::ostream> best_file;
+    std::unique_ptr<std::ostream> all_score_file;
+    // set names, labelled by the genetic model when multiple are used
+    std::vector<std::string> region_names;
+    std::string name;
+    double prevalence;
+    size_t idx;
+    size_t model = 0;
+};
+
 #endif // PRSICE_H
@@ -29,6 +29,7 @@
 #include <limits>
 #include <math.h>
 #include <stdexcept>
+#include <vector>
 namespace Regression
 {
 void glm(const Eigen::VectorXd& y, const Eigen::MatrixXd& x, double& p_value,
@@ -36,6 +37,63 @@ void glm(const Eigen::VectorXd& y, const Eigen::MatrixXd& x, double& p_value,
 void fastLm(const Eigen::VectorXd& y, const Eigen::MatrixXd& X, double& p_value,
             double& r2, double& r2_adjust, double& coeff,
             double& standard_error, int thread, bool intercept, int type = 0);
+
+/*!
+ * \brief Linear regression of a phenotype against a score column with fixed
+ *        covariates. Following the Frisch-Waugh-Lovell theorem, the
+ *        covariates are decomposed and the phenotype is residualized once,
+ *        so that each score only needs to be projected onto the covariates
+ *        instead of decomposing the whole design matrix again
+ */
+class CovariateProjection
+{
+public:
+    CovariateProjection() {}
+    /*!
+     * \brief Decompose the covariates of the design matrix
+     * \param y is the phenotype
+     * \param X is the design matrix, with the intercept as one of the
+     *        covariates
+     * \param score_col is the column of X holding the score, which is not
+     *        part of the covariates
+     */
+    CovariateProjection(const Eigen::VectorXd& y, const Eigen::MatrixXd& X,
+                        const Eigen::Index score_col);
+    /*!
+     * \brief Regress the phenotype against the score and the covariates,
+     *        with the same statistics as fastLm
+     * \return false if the covariates aren't of full rank or the score is
+     *         collinear with the covariates, where fastLm should be used
+     */
+    bool fit(const Eigen::VectorXd& score, double& p_value, double& r2,
+             double& r2_adjust, double& coeff, double& standard_error) const;
+    /*!
+     * \brief Regress the phenotype against each column of scores. All
+     *        columns are residualized together with matrix products, instead
+     *        of one projection per score
+     * \return whether each column was fitted. Columns not fitted should be
+     *         regressed with fastLm
+     */
+    std::vector<bool> fit_block(const Eigen::MatrixXd& scores,
+                                Eigen::VectorXd& p_value, Eigen::VectorXd& r2,
+                                Eigen::VectorXd& r2_adjust,
+                                Eigen::VectorXd& coeff,
+                                Eigen::VectorXd& standard_error) const;
+    bool valid() const { return m_valid; }
+
+private:
+    bool fit_residual(const Eigen::Ref<const Eigen::VectorXd>& resid_x,
+                      const double score_norm, double& p_value, double& r2,
+                      double& r2_adjust, double& coeff,
+                      double& standard_error) const;
+    // orthonormal basis of the covariates
+    Eigen::MatrixXd m_basis;
+    // phenotype with the covariates regressed out
+    Eigen::VectorXd m_resid_y;
+    double m_tss = 0.0;
+    Eigen::Index m_df = 0;
+    bool m_valid = false;
+};
 }
 
 #endif /* PRSICE_REGRESSION_H_ */
@@ -104,6 +104,24 @@ public:
         m_reference.byte_pos = src.get_byte_pos();
     }
 
+    /*!
+     * \brief Copy the reference file information and the genotype counts of
+     *        the same variant loaded with another base file. These only
+     *        depend on the target and reference
+     * \param src is the same variant loaded with another base file
+     */
+    void copy_genotype_info(const SNP& src)
+    {
+        m_reference = src.m_reference;
+        m_ref_flipped = src.m_ref_flipped;
+        m_ref_count = src.m_ref_count;
+        m_target_count = src.m_target_count;
+        m_expected_value = src.m_expected_value;
+        m_ref_expected_value = src.m_ref_expected_value;
+        m_has_expected = src.m_has_expected;
+        m_has_ref_expected = src.m_has_ref_expected;
+    }
+
     /*!
      * \brief Function to sort a vector of SNP by their chr then by their
      * p-value
@@ -456,6 +474,17 @@ public:
         pool.free(m_genotype_storage);
         m_genotype_storage = nullptr;
     }
+    /*!
+     * \brief Store the genotype of a rare variant as its carriers instead of
+     *        the packed genotype
+     */
+    void set_carriers(CarrierList&& carriers)
+    {
+        m_carriers = std::move(carriers);
+        m_sparse_genotype = true;
+    }
+    bool sparse_genotype() const { return m_sparse_genotype; }
+    const CarrierList& carriers() const { return m_carriers; }
 
 private:
     /*static std::string g_separator;
@@ -467,6 +496,7 @@ private:
     FileInfo m_reference;
     SNPClump m_clump_info;
     IndividualGenotype* m_genotype_storage = nullptr;
+    CarrierList m_carriers;
     std::vector<uintptr_t> m_genotype;
     std::string m_alt;
     std::string m_ref;
@@ -480,6 +510,7 @@ private:
     size_t m_loc = ~size_t(0);
     unsigned long long m_category = 0;
     bool m_has_expected = false;
+    bool m_sparse_genotype = false;
     bool m_has_ref_expected = false;
     bool m_flipped = false;
     bool m_ref_flipped = false;
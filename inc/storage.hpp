@@ -19,10 +19,12 @@
 #define PRSICE_INC_STORAGE_HPP_
 #include "enumerators.h"
 #include <Eigen/Dense>
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 #include <random>
 #include <string>
+#include <unordered_map>
 #include <vector>
 // From http://stackoverflow.com/a/12927952/1441789
 
@@ -42,11 +44,232 @@ struct Regress
     Eigen::VectorXd se_base;
 };
 
-struct PRS
+/*!
+ * \brief Linear regression results of a block of thresholds, which were
+ *        regressed together as a matrix. Thresholds not fitted are regressed
+ *        one at a time
+ */
+struct BlockRegression
 {
-    double prs;
-    size_t num_snp;
-    PRS() : prs(0.0), num_snp(0) {}
+    Eigen::VectorXd p_value;
+    Eigen::VectorXd r2;
+    Eigen::VectorXd r2_adjust;
+    Eigen::VectorXd coeff;
+    Eigen::VectorXd se;
+    std::vector<bool> fitted;
+    // result index of the first threshold in the block
+    size_t start = 0;
+};
+
+/*!
+ * \brief Number of alleles not counted for each sample. Missing genotypes are
+ *        usually rare, so the counts are kept as a list sorted by sample
+ *        until more than 1 / dense_ratio of the samples are listed, after
+ *        which the count of every sample is stored
+ */
+struct MissingCount
+{
+    // sample index and its count, sorted by the sample index
+    std::vector<std::pair<uint32_t, uint32_t>> sparse;
+    // count of every sample, empty unless the list became too dense
+    std::vector<uint32_t> dense;
+    static constexpr size_t dense_ratio = 16;
+    bool empty() const { return sparse.empty() && dense.empty(); }
+    void clear()
+    {
+        sparse.clear();
+        dense.clear();
+    }
+    uint32_t get(const size_t i) const
+    {
+        if (!dense.empty()) return dense[i];
+        auto&& miss = find(i);
+        return (miss == sparse.end() || miss->first != i) ? 0 : miss->second;
+    }
+    void add(const size_t i, const uint32_t count, const size_t num_sample)
+    {
+        if (!dense.empty())
+        {
+            dense[i] += count;
+            return;
+        }
+        auto&& miss = find(i);
+        if (miss != sparse.end() && miss->first == i)
+        {
+            miss->second += count;
+            return;
+        }
+        sparse.emplace(miss, static_cast<uint32_t>(i), count);
+        if (sparse.size() * dense_ratio > num_sample) to_dense(num_sample);
+    }
+    void add(const MissingCount& other, const size_t num_sample)
+    {
+        if (other.empty()) return;
+        if (!other.dense.empty() && dense.empty()) to_dense(num_sample);
+        if (!dense.empty())
+        {
+            for (size_t i = 0; i < other.dense.size(); ++i)
+            { dense[i] += other.dense[i]; }
+            for (auto&& miss : other.sparse) dense[miss.first] += miss.second;
+            return;
+        }
+        // merge the two sorted lists
+        std::vector<std::pair<uint32_t, uint32_t>> merged;
+        merged.reserve(sparse.size() + other.sparse.size());
+        auto cur = sparse.cbegin();
+        for (auto&& miss : other.sparse)
+        {
+            while (cur != sparse.cend() && cur->first < miss.first)
+            { merged.push_back(*cur++); }
+            if (cur != sparse.cend() && cur->first == miss.first)
+            { merged.emplace_back(miss.first, (cur++)->second + miss.second); }
+            else
+            {
+                merged.push_back(miss);
+            }
+        }
+        merged.insert(merged.end(), cur, sparse.cend());
+        sparse.swap(merged);
+        if (sparse.size() * dense_ratio > num_sample) to_dense(num_sample);
+    }
+
+private:
+    std::vector<std::pair<uint32_t, uint32_t>>::iterator find(const size_t i)
+    {
+        return std::lower_bound(
+            sparse.begin(), sparse.end(), i,
+            [](const std::pair<uint32_t, uint32_t>& miss, const size_t idx) {
+                return miss.first < idx;
+            });
+    }
+    std::vector<std::pair<uint32_t, uint32_t>>::const_iterator
+    find(const size_t i) const
+    {
+        return std::lower_bound(
+            sparse.cbegin(), sparse.cend(), i,
+            [](const std::pair<uint32_t, uint32_t>& miss, const size_t idx) {
+                return miss.first < idx;
+            });
+    }
+    void to_dense(const size_t num_sample)
+    {
+        dense.assign(num_sample, 0);
+        for (auto&& miss : sparse) dense[miss.first] += miss.second;
+        sparse.clear();
+    }
+};
+
+/*!
+ * \brief Per-sample polygenic score and number of alleles contributing to
+ *        it. All samples share the same allele count, except those with
+ *        missing genotypes that are set to zero, so only the shared count
+ *        and the alleles missed by those samples are stored. Scores of
+ *        additional genetic models share the allele count of the main model
+ */
+struct PRSList
+{
+    std::vector<double> prs;
+    // score of each additional genetic model
+    std::vector<std::vector<double>> model_prs;
+    // score shared by all samples, added to prs when the score is used
+    double base = 0.0;
+    std::vector<double> model_base;
+    // number of alleles of a sample without missing genotype
+    size_t num_snp = 0;
+    // number of alleles not counted for each sample
+    MissingCount num_miss;
+    PRSList() {}
+    PRSList(const size_t n, const size_t num_extra_model = 0)
+        : prs(n, 0.0)
+        , model_prs(num_extra_model, std::vector<double>(n, 0.0))
+        , model_base(num_extra_model, 0.0)
+    {
+    }
+    size_t size() const { return prs.size(); }
+    void resize(const size_t n, const size_t num_extra_model = 0)
+    {
+        prs.resize(n, 0.0);
+        model_prs.resize(num_extra_model);
+        for (auto&& model : model_prs) model.resize(n, 0.0);
+        model_base.resize(num_extra_model, 0.0);
+    }
+    double score(const size_t i) const { return prs[i] + base; }
+    /*!
+     * \brief Return the score of the i th sample under the model th genetic
+     *        model, where 0 is the main model
+     */
+    double score(const size_t i, const size_t model) const
+    {
+        if (model == 0) return score(i);
+        return model_prs[model - 1][i] + model_base[model - 1];
+    }
+    /*!
+     * \brief Return the number of alleles contributing to the score of the
+     *        i th sample
+     */
+    size_t snp_count(const size_t i) const
+    {
+        if (num_miss.empty()) return num_snp;
+        return num_snp - num_miss.get(i);
+    }
+    void add_missing(const size_t i, const size_t count)
+    {
+        if (count != 0)
+        { num_miss.add(i, static_cast<uint32_t>(count), prs.size()); }
+    }
+    /*!
+     * \brief Set the score and count of all samples to 0
+     */
+    void reset()
+    {
+        std::fill(prs.begin(), prs.end(), 0.0);
+        base = 0.0;
+        for (auto&& model : model_prs)
+        { std::fill(model.begin(), model.end(), 0.0); }
+        std::fill(model_base.begin(), model_base.end(), 0.0);
+        num_snp = 0;
+        num_miss.clear();
+    }
+    /*!
+     * \brief Add the score and count of another list with the same samples
+     */
+    void add(const PRSList& other)
+    {
+        for (size_t i = 0; i < prs.size(); ++i) prs[i] += other.prs[i];
+        base += other.base;
+        for (size_t m = 0; m < model_prs.size(); ++m)
+        {
+            for (size_t i = 0; i < prs.size(); ++i)
+            { model_prs[m][i] += other.model_prs[m][i]; }
+            model_base[m] += other.model_base[m];
+        }
+        num_snp += other.num_snp;
+        num_miss.add(other.num_miss, prs.size());
+    }
+};
+
+/*!
+ * \brief Score of one p-value threshold, handed from the scoring thread to
+ *        the regression thread. The last snapshot of a set has no score
+ */
+struct ScoreSnapshot
+{
+    PRSList scores;
+    double threshold = 0.0;
+    uint32_t num_snp_included = 0;
+    bool last = false;
+};
+
+/*!
+ * \brief Sparse genotype of a rare variant. All samples carry the baseline
+ *        genotype except those listed, which are stored as the sample index
+ *        times 4 plus their genotype, in ascending sample order. Genotypes
+ *        use the complement of the PLINK encoding, so missing genotype is 2
+ */
+struct CarrierList
+{
+    std::vector<uint32_t> samples;
+    uint32_t baseline = 0;
 };
 
 struct Sample_ID
@@ -73,6 +296,9 @@ struct BaseFile
     // use int as vector<bool> is abnormal
     std::vector<int> has_column = std::vector<int>(+BASE_INDEX::MAX + 1, false);
     std::string file_name;
+    std::string file_list;
+    // base files read from file_list, all sharing the same format
+    std::vector<std::string> file_names;
     int is_index = false;
     int is_beta = false;
     int is_or = false;
@@ -171,10 +397,16 @@ struct CalculatePRS
     MISSING_SCORE missing_score = MISSING_SCORE::MEAN_IMPUTE;
     SCORING scoring_method = SCORING::AVERAGE;
     MODEL genetic_model = MODEL::ADDITIVE;
+    // models scored in the same pass as genetic_model
+    std::vector<MODEL> other_models;
     int thread = 1;
     int no_regress = false;
     int non_cumulate = false;
     int use_ref_maf = false;
+    // variants with MAF below this are scored from their carriers only
+    double sparse_maf = 0.0;
+    // number of thresholds regressed together, 0 to regress one at a time
+    size_t regress_block = 0;
 };
 
 struct QCFiltering
@@ -192,11 +424,21 @@ struct QCFiltering
 
 struct Clumping
 {
+    std::string clump_cache;
+    std::string ld_cache;
+    double ld_cache_r2 = 0.05;
+    size_t ld_sample_size = 0;
+    // clumping parameters to sweep through, each combination is a separate
+    // run. Contain only the single setting if no sweep is required
+    std::vector<double> sweep_r2;
+    std::vector<double> sweep_pvalue;
+    std::vector<size_t> sweep_distance;
     double r2 = 0.1;
     double proxy = 0.0;
     double pvalue = 1;
     size_t distance = 250000;
     int no_clump = false;
+    int stream = false;
     bool use_proxy = false;
     bool provided_distance = false;
 };
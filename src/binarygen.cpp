@@ -108,22 +108,25 @@ std::vector<Sample_ID> BinaryGen::gen_sample_vector()
     // we always know the sample size from context
     m_unfiltered_sample_ct = m_context_map[0].number_of_samples;
     init_sample_vectors();
-    if (m_is_ref && m_sample_selection_list.empty())
+    // the sample ID of the reference are only required when filtering samples
+    // or writing them out (e.g. the reference package)
+    if (m_is_ref && m_sample_selection_list.empty() && !m_keep_sample_id)
     {
         for (size_t i = 0; i < m_unfiltered_sample_ct; ++i)
         {
             ++m_sample_ct;
             SET_BIT(i, m_calculate_prs.data());
             // we assume all bgen samples to be founder
+            ++m_founder_ct;
             SET_BIT(i, m_sample_for_ld.data());
         }
     }
-    else if (!m_is_ref || !m_sample_selection_list.empty())
+    else
     {
         // this is the target, where the m_sample_file must be correct, or
-        // this is the reference, which we asked for --keep or --remove and
-        // an external sample file was provided (that's why we don't get
-        // into the runtime_error)
+        // this is the reference, which we asked for --keep or --remove or
+        // need the sample ID, and an external sample file was provided
+        // (that's why we don't get into the runtime_error)
         if (m_is_ref && m_sample_file.empty())
         {
             throw std::runtime_error("Error: Cannot perform sample "
@@ -380,7 +383,7 @@ void BinaryGen::gen_snp_vector(
     size_t total_unfiltered_snps = 0;
     size_t ref_target_match = 0;
     bool chr_error = false, sex_error = false;
-    if (!m_is_ref)
+    if (!m_is_ref || m_keep_sample_id)
     {
         auto bgen_file = misc::load_stream(
             m_genotype_file_names.front() + ".bgen", std::ios_base::binary);
@@ -446,8 +449,9 @@ bool BinaryGen::calc_freq_gen_inter(const QCFiltering& filter_info,
     // TODO: This isn't correct if there are non-founder samples in our datas
     // and if we account for ref and target, we also need to consider situation
     // where we use target as reference.
-    PLINK_generator setter(m_calculate_prs.data(), m_tmp_genotype.data(),
-                           m_hard_threshold, m_dose_threshold);
+    PLINK_generator setter(m_calculate_prs.data(),
+                           m_cursor.tmp_genotype.data(), m_hard_threshold,
+                           m_dose_threshold);
     // now consider if we are generating the intermediate file
     std::ofstream inter_out;
     if (m_intermediate)
@@ -477,9 +481,10 @@ bool BinaryGen::calc_freq_gen_inter(const QCFiltering& filter_info,
         snp.get_file_info(cur_file_idx, byte_pos, m_is_ref);
         // now read in the genotype information
         genfile::bgen::read_and_parse_genotype_data_block<PLINK_generator>(
-            m_genotype_file, m_genotype_file_names[cur_file_idx] + ".bgen",
-            m_context_map[cur_file_idx], setter, &m_buffer1, &m_buffer2,
-            byte_pos);
+            m_cursor.genotype_file,
+            m_genotype_file_names[cur_file_idx] + ".bgen",
+            m_context_map[cur_file_idx], setter, &m_cursor.buffer1,
+            &m_cursor.buffer2, byte_pos);
         // no founder, much easier
         setter.get_count(ref_count, het_count, alt_count, missing_count);
         ++processed_count;
@@ -513,8 +518,9 @@ bool BinaryGen::calc_freq_gen_inter(const QCFiltering& filter_info,
             // 4. We are dealing with target file and we are
             // expected to use hard_coding
             tmp_byte_pos = inter_out.tellp();
-            inter_out.write(reinterpret_cast<char*>(m_tmp_genotype.data()),
-                            m_tmp_genotype.size() * sizeof(uintptr_t));
+            inter_out.write(
+                reinterpret_cast<char*>(m_cursor.tmp_genotype.data()),
+                m_cursor.tmp_genotype.size() * sizeof(uintptr_t));
             if (!m_is_ref)
             {
                 // target file
@@ -567,9 +573,11 @@ BinaryGen::~BinaryGen()
 }
 
 void BinaryGen::dosage_score(
-    std::vector<PRS>& prs_list,
+    PRSList& prs_list,
     const std::vector<size_t>::const_iterator& start_idx,
-    const std::vector<size_t>::const_iterator& end_idx, bool reset_zero)
+    const std::vector<size_t>::const_iterator& end_idx, bool reset_zero,
+    FileRead& genotype_file, std::vector<genfile::byte_t>& buffer1,
+    std::vector<genfile::byte_t>& buffer2)
 {
     // currently, use_ref_maf doesn't work on bgen dosage file
     // main reason is we need expected value instead of
@@ -603,8 +611,8 @@ void BinaryGen::dosage_score(
                          m_homrar_weight, snp.is_flipped());
         // start performing the parsing
         genfile::bgen::read_and_parse_genotype_data_block<PRS_Interpreter>(
-            m_genotype_file, m_genotype_file_names[file_idx] + ".bgen", context,
-            *setter, &m_buffer1, &m_buffer2, byte_pos);
+            genotype_file, m_genotype_file_names[file_idx] + ".bgen", context,
+            *setter, &buffer1, &buffer2, byte_pos);
         if (!not_first)
         {
             setter.reset(new Add_PRS(&prs_list, &m_calculate_prs,
@@ -616,40 +624,33 @@ void BinaryGen::dosage_score(
 }
 
 
+template <MISSING_SCORE missing>
 void BinaryGen::hard_code_score(
-    std::vector<PRS>& prs_list,
+    PRSList& prs_list,
     const std::vector<size_t>::const_iterator& start_idx,
-    const std::vector<size_t>::const_iterator& end_idx, bool reset_zero)
+    const std::vector<size_t>::const_iterator& end_idx, bool reset_zero,
+    FileRead& genotype_file, std::vector<uintptr_t>& tmp_genotype,
+    std::vector<genfile::byte_t>& buffer1,
+    std::vector<genfile::byte_t>& buffer2)
 {
     // genotype counts
     uint32_t homrar_ct = 0;
     uint32_t missing_ct = 0;
     uint32_t het_ct = 0;
     uint32_t homcom_ct = 0;
-    // weight of each genotype
-    double homcom_weight = m_homcom_weight;
-    double het_weight = m_het_weight;
-    double homrar_weight = m_homrar_weight;
-    // this is needed if we want to calculate the MAF of the sample
-    const size_t ploidy = 2;
-    const size_t miss_count =
-        (m_prs_calculation.missing_score != MISSING_SCORE::SET_ZERO) * ploidy;
-    const bool is_centre =
-        (m_prs_calculation.missing_score == MISSING_SCORE::CENTER);
-    const bool mean_impute =
-        (m_prs_calculation.missing_score == MISSING_SCORE::MEAN_IMPUTE);
     // check if we need to reset the sample's PRS
     bool not_first = !reset_zero;
-    double stat, maf, adj_score, miss_score;
     genfile::bgen::Context context;
-    PLINK_generator setter(m_calculate_prs.data(), m_tmp_genotype.data(),
+    PLINK_generator setter(m_calculate_prs.data(), tmp_genotype.data(),
                            m_hard_threshold, m_dose_threshold);
+    CarrierList carriers;
     std::vector<size_t>::const_iterator cur_idx = start_idx;
     uintptr_t* genotype_ptr;
     for (; cur_idx != end_idx; ++cur_idx)
     {
         auto&& cur_snp = m_existed_snps[(*cur_idx)];
-        if (cur_snp.current_genotype() == nullptr)
+        if (cur_snp.current_genotype() == nullptr
+            && !cur_snp.sparse_genotype())
         {
             auto [idx, byte_pos] = cur_snp.get_file_info(m_is_ref);
             if (m_intermediate)
@@ -665,9 +666,9 @@ void BinaryGen::hard_code_score(
                 // read in the genotype information to the genotype vector
                 const uintptr_t unfiltered_sample_ct4 =
                     (m_unfiltered_sample_ct + 3) / 4;
-                m_genotype_file.read(
+                genotype_file.read(
                     m_genotype_file_names[idx], byte_pos, unfiltered_sample_ct4,
-                    reinterpret_cast<char*>(m_tmp_genotype.data()));
+                    reinterpret_cast<char*>(tmp_genotype.data()));
             }
             else
             {
@@ -676,8 +677,8 @@ void BinaryGen::hard_code_score(
                 // start performing the parsing
                 genfile::bgen::read_and_parse_genotype_data_block<
                     PLINK_generator>(
-                    m_genotype_file, m_genotype_file_names[idx] + ".bgen",
-                    context, setter, &m_buffer1, &m_buffer2, byte_pos);
+                    genotype_file, m_genotype_file_names[idx] + ".bgen",
+                    context, setter, &buffer1, &buffer2, byte_pos);
                 if (!m_prs_calculation.use_ref_maf)
                 {
                     setter.get_count(homcom_ct, het_ct, homrar_ct, missing_ct);
@@ -694,7 +695,7 @@ void BinaryGen::hard_code_score(
                     }
                 }
             }
-            genotype_ptr = m_tmp_genotype.data();
+            genotype_ptr = tmp_genotype.data();
         }
         else
         {
@@ -703,73 +704,94 @@ void BinaryGen::hard_code_score(
             { throw std::runtime_error("Error: Sam has a logic error"); }
             genotype_ptr = cur_snp.current_genotype();
         }
-        homcom_weight = m_homcom_weight;
-        het_weight = m_het_weight;
-        homrar_weight = m_homrar_weight;
-        if (cur_snp.is_flipped()) { std::swap(homcom_weight, homrar_weight); }
-        maf = 1.0
-              - static_cast<double>(homcom_weight * homcom_ct
-                                    + het_ct * het_weight
-                                    + homrar_weight * homrar_ct)
-                    / (static_cast<double>(homcom_ct + het_ct + homrar_ct)
-                       * ploidy);
-
-        stat = cur_snp.stat();
-        adj_score = 0;
-        if (is_centre) { adj_score = ploidy * stat * maf; }
-        miss_score = 0;
-        if (mean_impute) { miss_score = ploidy * stat * maf; }
-        read_prs(genotype_ptr, prs_list, ploidy, stat, adj_score, miss_score,
-                 miss_count, homcom_weight, het_weight, homrar_weight,
-                 not_first);
+        add_hard_coded_prs<missing>(genotype_ptr, prs_list, cur_snp,
+                                    homcom_ct, het_ct, homrar_ct, not_first,
+                                    carriers);
         not_first = true;
     }
 }
 
-void BinaryGen::count_and_read_genotype(SNP& snp)
+void BinaryGen::read_block(GenotypeBlock& block, GenotypeCursor& cursor)
 {
-    auto [file_idx, byte_pos] = snp.get_file_info(false);
-    auto&& genotype = snp.current_genotype();
-    // load into memory is useless for dosage score
-    if (!m_hard_coded) return;
-
-    if (m_intermediate)
+    if (!block.is_dosage)
     {
-        // this is the intermediate
-        uint32_t homrar_ct = 0;
-        uint32_t missing_ct = 0;
-        uint32_t het_ct = 0;
-        uint32_t homcom_ct = 0;
-        if (!snp.get_counts(homcom_ct, het_ct, homrar_ct, missing_ct,
-                            m_prs_calculation.use_ref_maf))
-        { throw std::logic_error("Error: Sam has a logic error in bgen"); }
-        const uintptr_t unfiltered_sample_ct4 =
-            (m_unfiltered_sample_ct + 3) / 4;
-        m_genotype_file.read(m_genotype_file_names[file_idx], byte_pos,
-                             unfiltered_sample_ct4,
-                             reinterpret_cast<char*>(genotype));
+        read_hard_coded_block(block, cursor);
+        return;
     }
-    else
+    for (size_t i = 0; i < block.size(); ++i)
     {
+        auto [file_idx, byte_pos] =
+            m_existed_snps[block.index[i]].get_file_info(m_is_ref);
+        Dosage_generator setter(m_calculate_prs.data(),
+                                block.dosage.data() + i * 3 * block.num_sample);
+        genfile::bgen::read_and_parse_genotype_data_block<Dosage_generator>(
+            cursor.genotype_file, m_genotype_file_names[file_idx] + ".bgen",
+            m_context_map[file_idx], setter, &cursor.buffer1, &cursor.buffer2,
+            byte_pos);
+    }
+}
 
-        // start performing the parsing
-        PLINK_generator setter(m_calculate_prs.data(), genotype,
-                               m_hard_threshold, m_dose_threshold);
+void BinaryGen::read_hard_coded_block(GenotypeBlock& block,
+                                      GenotypeCursor& cursor)
+{
+    const uintptr_t unfiltered_sample_ct4 = (m_unfiltered_sample_ct + 3) / 4;
+    for (size_t i = 0; i < block.size(); ++i)
+    {
+        auto&& snp = m_existed_snps[block.index[i]];
+        auto&& row = block.packed_row(i);
+        if (stored_row(snp, row)) continue;
+        auto [file_idx, byte_pos] = snp.get_file_info(m_is_ref);
+        if (m_intermediate)
+        {
+            // the intermediate file only has the samples used for scoring,
+            // and the counts were recorded when it was generated
+            cursor.genotype_file.read(
+                m_genotype_file_names[file_idx], byte_pos,
+                unfiltered_sample_ct4,
+                reinterpret_cast<char*>(cursor.tmp_genotype.data()));
+            std::copy_n(cursor.tmp_genotype.data(), block.row_words, row);
+            continue;
+        }
+        std::fill_n(row, block.row_words, 0);
+        PLINK_generator setter(m_calculate_prs.data(), row, m_hard_threshold,
+                               m_dose_threshold);
         genfile::bgen::read_and_parse_genotype_data_block<PLINK_generator>(
-            m_genotype_file, m_genotype_file_names[file_idx] + ".bgen",
-            m_context_map[file_idx], setter, &m_buffer1, &m_buffer2, byte_pos);
+            cursor.genotype_file, m_genotype_file_names[file_idx] + ".bgen",
+            m_context_map[file_idx], setter, &cursor.buffer1, &cursor.buffer2,
+            byte_pos);
+        if (m_prs_calculation.use_ref_maf) continue;
+        auto&& ct = block.counts[i];
+        setter.get_count(ct.homcom, ct.het, ct.homrar, ct.missing);
+        ct.has_count = true;
     }
 }
 
-void BinaryGen::read_score(std::vector<PRS>& prs_list,
+void BinaryGen::read_score(PRSList& prs_list,
                            const std::vector<size_t>::const_iterator& start_idx,
                            const std::vector<size_t>::const_iterator& end_idx,
-                           bool reset_zero)
+                           bool reset_zero, GenotypeCursor& cursor)
 {
-    if (m_hard_coded)
-    { hard_code_score(prs_list, start_idx, end_idx, reset_zero); }
-    else
+    score(prs_list, start_idx, end_idx, reset_zero, cursor.genotype_file,
+          cursor.tmp_genotype, cursor.buffer1, cursor.buffer2);
+}
+
+void BinaryGen::score(PRSList& prs_list,
+                      const std::vector<size_t>::const_iterator& start_idx,
+                      const std::vector<size_t>::const_iterator& end_idx,
+                      bool reset_zero, FileRead& genotype_file,
+                      std::vector<uintptr_t>& tmp_genotype,
+                      std::vector<genfile::byte_t>& buffer1,
+                      std::vector<genfile::byte_t>& buffer2)
+{
+    if (!m_hard_coded)
     {
-        dosage_score(prs_list, start_idx, end_idx, reset_zero);
+        dosage_score(prs_list, start_idx, end_idx, reset_zero, genotype_file,
+                     buffer1, buffer2);
+        return;
     }
+    dispatch_missing_score([&](auto missing) {
+        hard_code_score<decltype(missing)::value>(
+            prs_list, start_idx, end_idx, reset_zero, genotype_file,
+            tmp_genotype, buffer1, buffer2);
+    });
 }
@@ -127,14 +127,14 @@ bool BinaryPlink::calc_freq_gen_inter(const QCFiltering& filter_info,
             prev_progress = progress;
         }
         snp.get_file_info(cur_file_idx, byte_pos, m_is_ref);
-        m_genotype_file.read(m_genotype_file_names[cur_file_idx] + ".bed",
-                             byte_pos,
-                             static_cast<long long>(unfiltered_sample_ct4),
-                             reinterpret_cast<char*>(m_tmp_genotype.data()));
+        m_cursor.genotype_file.read(
+            m_genotype_file_names[cur_file_idx] + ".bed", byte_pos,
+            static_cast<long long>(unfiltered_sample_ct4),
+            reinterpret_cast<char*>(m_cursor.tmp_genotype.data()));
         // calculate the MAF using PLINK2 function (take into account of founder
         // status)
         single_marker_freqs_and_hwe(
-            unfiltered_sample_ctv2, m_tmp_genotype.data(),
+            unfiltered_sample_ctv2, m_cursor.tmp_genotype.data(),
             m_sample_include2.data(), m_founder_include2.data(), m_sample_ct,
             &ref_count, &het_count, &alt_count, m_founder_ct,
             &ref_founder_count, &het_founder_count, &alt_founder_count);
@@ -357,9 +357,82 @@ void BinaryPlink::check_bed(const std::string& bed_name, size_t num_marker,
 
 BinaryPlink::~BinaryPlink() {}
 void BinaryPlink::read_score(
-    std::vector<PRS>& prs_list,
-    const std::vector<size_t>::const_iterator& start_idx,
-    const std::vector<size_t>::const_iterator& end_idx, bool reset_zero)
+    PRSList& prs_list, const std::vector<size_t>::const_iterator& start_idx,
+    const std::vector<size_t>::const_iterator& end_idx, bool reset_zero,
+    GenotypeCursor& cursor)
+{
+    dispatch_missing_score([&](auto missing) {
+        hard_code_score<decltype(missing)::value>(prs_list, start_idx, end_idx,
+                                                  reset_zero, cursor);
+    });
+}
+
+void BinaryPlink::read_block(GenotypeBlock& block, GenotypeCursor& cursor)
+{
+    const uintptr_t unfiltered_sample_ct4 = (m_unfiltered_sample_ct + 3) / 4;
+    const uintptr_t final_mask =
+        get_final_mask(static_cast<uint32_t>(m_sample_ct));
+    size_t i = 0;
+    while (i < block.size())
+    {
+        if (stored_row(m_existed_snps[block.index[i]], block.packed_row(i)))
+        {
+            ++i;
+            continue;
+        }
+        // find the run of variants following each other in the file
+        auto [file_idx, byte_pos] =
+            m_existed_snps[block.index[i]].get_file_info(false);
+        size_t run_end = i + 1;
+        for (; run_end < block.size(); ++run_end)
+        {
+            auto&& next = m_existed_snps[block.index[run_end]];
+            auto [next_file, next_pos] = next.get_file_info(false);
+            const std::streamoff offset = static_cast<std::streamoff>(
+                (run_end - i) * unfiltered_sample_ct4);
+            if (next.current_genotype() != nullptr || next.sparse_genotype()
+                || next_file != file_idx || next_pos != byte_pos + offset)
+            { break; }
+        }
+        const size_t run_size = run_end - i;
+        cursor.buffer1.resize(run_size * unfiltered_sample_ct4);
+        cursor.genotype_file.read(
+            m_genotype_file_names[file_idx] + ".bed", byte_pos,
+            static_cast<std::streamsize>(cursor.buffer1.size()),
+            reinterpret_cast<char*>(cursor.buffer1.data()));
+        for (size_t j = 0; j < run_size; ++j, ++i)
+        {
+            const uint8_t* raw =
+                cursor.buffer1.data() + j * unfiltered_sample_ct4;
+            auto&& row = block.packed_row(i);
+            auto&& ct = block.counts[i];
+            std::memcpy(cursor.tmp_genotype.data(), raw, unfiltered_sample_ct4);
+            get_or_count(m_existed_snps[block.index[i]],
+                         cursor.tmp_genotype.data(), ct.homcom, ct.het,
+                         ct.homrar, ct.missing);
+            ct.has_count = true;
+            std::fill_n(row, block.row_words, 0);
+            if (m_unfiltered_sample_ct == m_sample_ct)
+            {
+                std::memcpy(row, raw, unfiltered_sample_ct4);
+                row[(m_sample_ct - 1) / BITCT2] &= final_mask;
+            }
+            else
+            {
+                copy_quaterarr_nonempty_subset(
+                    cursor.tmp_genotype.data(), m_calculate_prs.data(),
+                    static_cast<uint32_t>(m_unfiltered_sample_ct),
+                    static_cast<uint32_t>(m_sample_ct), row);
+            }
+        }
+    }
+}
+
+template <MISSING_SCORE missing>
+void BinaryPlink::hard_code_score(
+    PRSList& prs_list, const std::vector<size_t>::const_iterator& start_idx,
+    const std::vector<size_t>::const_iterator& end_idx, bool reset_zero,
+    GenotypeCursor& cursor)
 {
     // for removing unwanted bytes from the end of the genotype vector
     const uintptr_t final_mask =
@@ -375,68 +448,46 @@ void BinaryPlink::read_score(
     uint32_t missing_ct = 0;
     uint32_t het_ct = 0;
     uint32_t homcom_ct = 0;
-    // currently hard code ploidy to 2. Will keep it this way unil we know how
-    // to properly handly non-diploid chromosomes in human and other organisms
-    const size_t ploidy = 2;
-    // those are the weight (0,1,2) for each genotype observation
-    double homcom_weight = m_homcom_weight;
-    double het_weight = m_het_weight;
-    double homrar_weight = m_homrar_weight;
-    const size_t miss_count =
-        (m_prs_calculation.missing_score != MISSING_SCORE::SET_ZERO) * ploidy;
-    const bool is_centre =
-        (m_prs_calculation.missing_score == MISSING_SCORE::CENTER);
-    const bool mean_impute =
-        (m_prs_calculation.missing_score == MISSING_SCORE::MEAN_IMPUTE);
     // check if it is not the frist run, if it is the first run, we will reset
     // the PRS to zero instead of addint it up
     bool not_first = !reset_zero;
-    double stat, maf, adj_score, miss_score;
-    std::vector<uintptr_t> genotype(unfiltered_sample_ctl * 2, 0);
+    auto&& tmp_genotype = cursor.tmp_genotype;
+    // only required when some samples are excluded from scoring
+    auto&& genotype = cursor.subset_genotype;
+    if (m_unfiltered_sample_ct != m_sample_ct)
+    { genotype.resize(unfiltered_sample_ctv2, 0); }
+    CarrierList carriers;
     std::vector<size_t>::const_iterator cur_idx = start_idx;
     uintptr_t* genotype_ptr;
     for (; cur_idx != end_idx; ++cur_idx)
     {
         auto&& cur_snp = m_existed_snps[(*cur_idx)];
-        if (cur_snp.current_genotype() == nullptr)
+        if (cur_snp.current_genotype() == nullptr
+            && !cur_snp.sparse_genotype())
         {
             auto [file_idx, byte_pos] = cur_snp.get_file_info(false);
-            m_genotype_file.read(
+            cursor.genotype_file.read(
                 m_genotype_file_names[file_idx] + ".bed", byte_pos,
                 unfiltered_sample_ct4,
-                reinterpret_cast<char*>(m_tmp_genotype.data()));
-            if (!cur_snp.get_counts(homcom_ct, het_ct, homrar_ct, missing_ct,
-                                    m_prs_calculation.use_ref_maf))
-            {
-                // we need to calculate the MA
-                // if we want to use reference, we will always have calculated
-                // the MAF
-                uint32_t ll_ct, lh_ct, hh_ct;
-                uint32_t tmp_total = 0;
-                single_marker_freqs_and_hwe(
-                    unfiltered_sample_ctv2, m_tmp_genotype.data(),
-                    m_sample_include2.data(), m_founder_include2.data(),
-                    m_sample_ct, &ll_ct, &lh_ct, &hh_ct, m_founder_ct,
-                    &homcom_ct, &het_ct, &homrar_ct);
-                tmp_total = (homcom_ct + het_ct + homrar_ct);
-                assert(m_founder_ct >= tmp_total);
-                missing_ct = m_founder_ct - tmp_total;
-                cur_snp.set_counts(homcom_ct, het_ct, homrar_ct, missing_ct,
-                                   false);
-            }
+                reinterpret_cast<char*>(tmp_genotype.data()));
+            get_or_count(cur_snp, tmp_genotype.data(), homcom_ct, het_ct,
+                         homrar_ct, missing_ct);
             if (m_unfiltered_sample_ct != m_sample_ct)
             {
                 copy_quaterarr_nonempty_subset(
-                    m_tmp_genotype.data(), m_calculate_prs.data(),
+                    tmp_genotype.data(), m_calculate_prs.data(),
                     static_cast<uint32_t>(m_unfiltered_sample_ct),
                     static_cast<uint32_t>(m_sample_ct), genotype.data());
+                genotype_ptr = genotype.data();
             }
             else
             {
-                genotype = m_tmp_genotype;
-                genotype[(m_unfiltered_sample_ct - 1) / BITCT2] &= final_mask;
+                // the raw genotype is read again for the next variant, so
+                // it can be masked in place
+                tmp_genotype[(m_unfiltered_sample_ct - 1) / BITCT2] &=
+                    final_mask;
+                genotype_ptr = tmp_genotype.data();
             }
-            genotype_ptr = genotype.data();
         }
         else
         {
@@ -450,24 +501,9 @@ void BinaryPlink::read_score(
             cur_snp.invalid();
             continue;
         }
-        homcom_weight = m_homcom_weight;
-        het_weight = m_het_weight;
-        homrar_weight = m_homrar_weight;
-        if (cur_snp.is_flipped()) { std::swap(homcom_weight, homrar_weight); }
-        maf = 1.0
-              - static_cast<double>(homcom_weight * homcom_ct
-                                    + het_ct * het_weight
-                                    + homrar_weight * homrar_ct)
-                    / (static_cast<double>((homcom_ct + het_ct + homrar_ct)
-                                           * ploidy));
-        stat = cur_snp.stat();
-        adj_score = 0;
-        if (is_centre) { adj_score = ploidy * stat * maf; }
-        miss_score = 0;
-        if (mean_impute) { miss_score = ploidy * stat * maf; }
-        read_prs(genotype_ptr, prs_list, ploidy, stat, adj_score, miss_score,
-                 miss_count, homcom_weight, het_weight, homrar_weight,
-                 not_first);
+        add_hard_coded_prs<missing>(genotype_ptr, prs_list, cur_snp,
+                                    homcom_ct, het_ct, homrar_ct, not_first,
+                                    carriers);
         not_first = true;
     }
 }
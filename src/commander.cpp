@@ -88,6 +88,8 @@ bool Commander::init(int argc, char* argv[], bool& early_termination,
         {"allow-inter", no_argument, &m_allow_inter, 1},
         {"all-score", no_argument, &m_print_all_scores, 1},
         {"beta", no_argument, &m_base_info.is_beta, 1},
+        {"chr-stream", no_argument, &m_chr_stream, 1},
+        {"clump-stream", no_argument, &m_clump_info.stream, 1},
         {"fastscore", no_argument, &m_p_thresholds.fastscore, 1},
         {"full-back", no_argument, &m_prset.full_as_background, 1},
         {"hard", no_argument, &m_target.hard_coded, 1},
@@ -103,6 +105,7 @@ bool Commander::init(int argc, char* argv[], bool& early_termination,
         {"nonfounders", no_argument, &m_include_nonfounders, 1},
         {"or", no_argument, &m_base_info.is_or, 1},
         {"print-snp", no_argument, &m_print_snp, 1},
+        {"score-once", no_argument, &m_score_once, 1},
         {"ultra", no_argument, &m_ultra_aggressive, 1},
         {"use-ref-maf", no_argument, &m_prs_info.use_ref_maf, 1},
         // long flags, need to work on them
@@ -113,11 +116,13 @@ bool Commander::init(int argc, char* argv[], bool& early_termination,
         {"background", required_argument, nullptr, 0},
         {"bar-levels", required_argument, nullptr, 0},
         {"base-info", required_argument, nullptr, 0},
+        {"base-list", required_argument, nullptr, 0},
         {"base-maf", required_argument, nullptr, 0},
         {"binary-target", required_argument, nullptr, 0},
         {"bp", required_argument, nullptr, 0},
         {"chr", required_argument, nullptr, 0},
         {"chr-id", required_argument, nullptr, 0},
+        {"clump-cache", required_argument, nullptr, 0},
         {"clump-kb", required_argument, nullptr, 0},
         {"clump-p", required_argument, nullptr, 0},
         {"clump-r2", required_argument, nullptr, 0},
@@ -132,11 +137,14 @@ bool Commander::init(int argc, char* argv[], bool& early_termination,
         {"info", required_argument, nullptr, 0},
         {"info-type", required_argument, nullptr, 0},
         {"keep", required_argument, nullptr, 0},
+        {"ld-cache", required_argument, nullptr, 0},
+        {"ld-cache-r2", required_argument, nullptr, 0},
         {"ld-dose-thres", required_argument, nullptr, 0},
         {"ld-keep", required_argument, nullptr, 0},
         {"ld-list", required_argument, nullptr, 0},
         {"ld-type", required_argument, nullptr, 0},
         {"ld-remove", required_argument, nullptr, 0},
+        {"ld-sample-size", required_argument, nullptr, 0},
         {"ld-maf", required_argument, nullptr, 0},
         {"ld-geno", required_argument, nullptr, 0},
         {"ld-hard-thres", required_argument, nullptr, 0},
@@ -147,12 +155,15 @@ bool Commander::init(int argc, char* argv[], bool& early_termination,
         {"model", required_argument, nullptr, 0},
         {"num-auto", required_argument, nullptr, 0},
         {"perm", required_argument, nullptr, 0},
+        {"prepare-ref", required_argument, nullptr, 0},
         {"proxy", required_argument, nullptr, 0},
+        {"regress-block", required_argument, nullptr, 0},
         {"remove", required_argument, nullptr, 0},
         {"score", required_argument, nullptr, 0},
         {"set-perm", required_argument, nullptr, 0},
         {"snp", required_argument, nullptr, 0},
         {"snp-set", required_argument, nullptr, 0},
+        {"sparse-maf", required_argument, nullptr, 0},
         {"stat", required_argument, nullptr, 0},
         {"target-list", required_argument, nullptr, 0},
         {"type", required_argument, nullptr, 0},
@@ -205,6 +216,8 @@ bool Commander::parse_command(int argc, char* argv[], const char* optString,
             }
             else if (command == "base-info")
                 set_string(optarg, command, +BASE_INDEX::INFO);
+            else if (command == "base-list")
+                set_string(optarg, command, m_base_info.file_list);
             else if (command == "base-maf")
                 set_string(optarg, command, +BASE_INDEX::MAF);
             else if (command == "binary-target")
@@ -216,17 +229,33 @@ bool Commander::parse_command(int argc, char* argv[], const char* optString,
                 set_string(optarg, command, +BASE_INDEX::CHR);
             else if (command == "chr-id")
                 set_string(optarg, command, m_chr_id_formula);
+            else if (command == "clump-cache")
+                set_string(optarg, command, m_clump_info.clump_cache);
             else if (command == "clump-kb")
             {
-                error |= !parse_unit_value(optarg, command, 1,
-                                           m_clump_info.distance);
+                error |= !parse_unit_vector(optarg, command, 1,
+                                            m_clump_info.sweep_distance);
+                if (!m_clump_info.sweep_distance.empty())
+                {
+                    m_clump_info.distance =
+                        m_clump_info.sweep_distance.front();
+                }
                 m_clump_info.provided_distance = true;
             }
             else if (command == "clump-p")
-                error |=
-                    !set_numeric<double>(optarg, command, m_clump_info.pvalue);
+            {
+                error |= !load_numeric_vector<double>(
+                    optarg, command, m_clump_info.sweep_pvalue);
+                if (!m_clump_info.sweep_pvalue.empty())
+                { m_clump_info.pvalue = m_clump_info.sweep_pvalue.front(); }
+            }
             else if (command == "clump-r2")
-                error |= !set_numeric<double>(optarg, command, m_clump_info.r2);
+            {
+                error |= !load_numeric_vector<double>(optarg, command,
+                                                      m_clump_info.sweep_r2);
+                if (!m_clump_info.sweep_r2.empty())
+                { m_clump_info.r2 = m_clump_info.sweep_r2.front(); }
+            }
             else if (command == "cov-factor")
                 load_string_vector(optarg, command, m_pheno_info.factor_cov);
             else if (command == "dose-thres")
@@ -253,6 +282,11 @@ bool Commander::parse_command(int argc, char* argv[], const char* optString,
                 error |= !set_info(optarg);
             else if (command == "keep")
                 set_string(optarg, command, m_target.keep);
+            else if (command == "ld-cache")
+                set_string(optarg, command, m_clump_info.ld_cache);
+            else if (command == "ld-cache-r2")
+                error |= !set_numeric<double>(optarg, command,
+                                              m_clump_info.ld_cache_r2);
             else if (command == "ld-dose-thres")
                 error |= !set_numeric<double>(optarg, command,
                                               m_ref_filter.dose_threshold);
@@ -274,6 +308,9 @@ bool Commander::parse_command(int argc, char* argv[], const char* optString,
                     !set_numeric<double>(optarg, command, m_ref_filter.maf);
             else if (command == "ld-remove")
                 set_string(optarg, command, m_reference.remove);
+            else if (command == "ld-sample-size")
+                error |= !set_numeric<size_t>(optarg, command,
+                                              m_clump_info.ld_sample_size);
             else if (command == "ld-type")
                 set_string(optarg, command, m_reference.type);
             else if (command == "maf")
@@ -303,10 +340,15 @@ bool Commander::parse_command(int argc, char* argv[], const char* optString,
                                               m_perm_info.num_permutation);
                 m_perm_info.run_perm = true;
             }
+            else if (command == "prepare-ref")
+                set_string(optarg, command, m_prepare_ref);
             else if (command == "proxy")
                 error |=
                     !set_numeric<double>(optarg, command, m_clump_info.proxy,
                                          m_clump_info.use_proxy);
+            else if (command == "regress-block")
+                error |= !set_numeric<size_t>(optarg, command,
+                                              m_prs_info.regress_block);
             else if (command == "remove")
                 set_string(optarg, command, m_target.remove);
             else if (command == "score")
@@ -324,6 +366,9 @@ bool Commander::parse_command(int argc, char* argv[], const char* optString,
                 load_string_vector(optarg, command, m_prset.snp);
                 m_prset.run = true;
             }
+            else if (command == "sparse-maf")
+                error |= !set_numeric<double>(optarg, command,
+                                              m_prs_info.sparse_maf);
             else if (command == "stat")
                 set_string(optarg, command, +BASE_INDEX::STAT);
             else if (command == "target-list")
@@ -417,6 +462,7 @@ bool Commander::parse_command(int argc, char* argv[], const char* optString,
         opt = getopt_long(argc, argv, optString, longOpts, &longIndex);
     }
     if (m_allow_inter) m_parameter_log["allow-inter"] = "";
+    if (m_chr_stream) m_parameter_log["chr-stream"] = "";
     if (m_p_thresholds.fastscore) m_parameter_log["fastscore"] = "";
     if (m_pheno_info.ignore_fid) m_parameter_log["ignore-fid"] = "";
     if (m_include_nonfounders) m_parameter_log["nonfounders"] = "";
@@ -424,11 +470,13 @@ bool Commander::parse_command(int argc, char* argv[], const char* optString,
     if (m_keep_ambig) m_parameter_log["keep-ambig"] = "";
     if (m_perm_info.logit_perm) m_parameter_log["logit-perm"] = "";
     if (m_clump_info.no_clump) m_parameter_log["no-clump"] = "";
+    if (m_clump_info.stream) m_parameter_log["clump-stream"] = "";
     if (m_p_thresholds.no_full) m_parameter_log["no-full"] = "";
     if (m_prs_info.no_regress) m_parameter_log["no-regress"] = "";
     if (m_prs_info.non_cumulate) m_parameter_log["non-cumulate"] = "";
     if (m_print_all_scores) m_parameter_log["all-score"] = "";
     if (m_print_snp) m_parameter_log["print-snp"] = "";
+    if (m_score_once) m_parameter_log["score-once"] = "";
     if (m_base_info.is_beta) m_parameter_log["beta"] = "";
     if (m_base_info.is_or) m_parameter_log["or"] = "";
     if (m_target.hard_coded) m_parameter_log["hard"] = "";
@@ -523,6 +571,16 @@ void Commander::set_help_message()
         "ignored\n"
         "                            Column name default: INFO\n"
         "                            Threshold default: 0.9\n"
+        "    --base-list             File containing the base association "
+        "files, one\n"
+        "                            per line. All files must share the same "
+        "format.\n"
+        "                            The LD reference is processed and "
+        "clumped once\n"
+        "                            for all base files and results are "
+        "written to\n"
+        "                            <out>.<base name>. Mutually exclusive "
+        "from --base\n"
         "    --base-maf              Base MAF filtering. Format should be\n"
         "                            <Column name>:<Threshold>. SNPs with maf\n"
         "                            less than <Threshold> will be ignored. "
@@ -683,6 +741,16 @@ void Commander::set_help_message()
           "hard coding\n"
           // clumping
           "\nClumping:\n"
+          "    --clump-cache           File storing the clumping result. If "
+          "the base,\n"
+          "                            LD reference and clumping parameters "
+          "are the\n"
+          "                            same as the run generating the file, "
+          "clumping\n"
+          "                            will be skipped and the stored result "
+          "used\n"
+          "                            instead. Otherwise, the file will be "
+          "updated\n"
           "    --clump-kb              The distance for clumping in kb\n"
           "                            Default: "
         + misc::to_string(m_clump_info.distance / 1000)
@@ -696,6 +764,25 @@ void Commander::set_help_message()
           "                            Default: "
         + misc::to_string(m_clump_info.pvalue)
         + "\n"
+          "                            Comma separated values can be "
+          "provided to\n"
+          "                            --clump-kb, --clump-r2 and --clump-p. "
+          "Clumping\n"
+          "                            is then performed for each combination "
+          "of them,\n"
+          "                            reusing the LD calculated for the "
+          "largest window,\n"
+          "                            and each clumped result is analysed as "
+          "a separate\n"
+          "                            run\n"
+          "    --clump-stream          Read the LD reference once in file "
+          "order for each\n"
+          "                            chromosome and calculate the R2 of "
+          "all pairs\n"
+          "                            within the clumping window before "
+          "clumping.\n"
+          "                            Avoid random access to the LD "
+          "reference\n"
           "    --ld            | -L    LD reference file. Use for LD "
           "calculation. If not\n"
           "                            provided, will use the post-filtered "
@@ -704,6 +791,23 @@ void Commander::set_help_message()
           "chromosome input\n"
           "                            Please see --target for more "
           "information\n"
+          "    --ld-cache              File storing the pairwise LD of the "
+          "reference.\n"
+          "                            If the file does not exist, or was "
+          "generated\n"
+          "                            from a different reference, sample or "
+          "clump-kb,\n"
+          "                            it will be generated during clumping. "
+          "Otherwise,\n"
+          "                            the stored R2 will be used instead of "
+          "the genotypes\n"
+          "    --ld-cache-r2           Minimum R2 stored in the LD cache. Must "
+          "be smaller\n"
+          "                            than --clump-r2 for the cache to be "
+          "reused.\n"
+          "                            Default: "
+        + misc::to_string(m_clump_info.ld_cache_r2)
+        + "\n"
           "    --ld-dose-thres         Translate any SNPs with highest "
           "genotype probability\n"
           "                            less than this threshold to missing "
@@ -746,10 +850,25 @@ void Commander::set_help_message()
           "--ignore-fid is\n"
           "                            set, first column should be IID\n"
           "                            Mutually exclusive from --ld-keep\n"
+          "    --ld-sample-size        Number of founders randomly selected "
+          "from the LD\n"
+          "                            reference for LD calculation. The "
+          "selection is\n"
+          "                            reproducible with --seed. Default: "
+          "use all founders\n"
           "    --ld-type               File type of the LD file. Support bed "
           "(binary plink)\n"
           "                            and bgen format. Default: bed\n"
           "    --no-clump              Stop PRSice from performing clumping\n"
+          "    --prepare-ref           Write the QCed LD founders and variants "
+          "as a packed\n"
+          "                            PLINK binary file set with this prefix, "
+          "together\n"
+          "                            with the founder genotype counts "
+          "(.prsref). Using\n"
+          "                            the package as --ld in later runs skip "
+          "the\n"
+          "                            reference QC and BGEN hard coding\n"
           "    --proxy                 Proxy threshold for index SNP to be "
           "considered\n"
           "                            as part of the region represented by "
@@ -826,6 +945,13 @@ void Commander::set_help_message()
           "                            rec - Recessive model, code as 0/0/1\n"
           "                            het - Heterozygous only model, code as "
           "0/1/0\n"
+          "                            all - All of the above\n"
+          "                            Multiple models can be provided as a "
+          "comma\n"
+          "                            separated list. They are scored from "
+          "the same\n"
+          "                            genotype read and reported side by "
+          "side\n"
           "    --missing               Method to handle missing genotypes. By "
           "default, \n"
           "                            final scores are averages of valid "
@@ -846,6 +972,13 @@ void Commander::set_help_message()
           "    --no-regress            Do not perform the regression analysis "
           "and simply\n"
           "                            output all PRS.\n"
+          "    --regress-block         Number of p-value thresholds whose "
+          "scores are\n"
+          "                            regressed together as a matrix for "
+          "quantitative\n"
+          "                            traits. Keeps the scores of the block "
+          "in memory.\n"
+          "                            Default: 0 (one threshold at a time)\n"
           "    --score                 Method to calculate the polygenic "
           "score.\n"
           "                            Available methods include:\n"
@@ -858,6 +991,14 @@ void Commander::set_help_message()
           "samples\n"
           "                            sum     - Direct summation of the "
           "effect size \n"
+          "    --sparse-maf            Variants with MAF below this threshold "
+          "are scored\n"
+          "                            from the samples that do not carry the "
+          "most\n"
+          "                            common genotype, and are stored as such "
+          "with --ultra.\n"
+          "                            Has no effect for dosage score. "
+          "Default: 0\n"
           "    --upper         | -u    The final p-value threshold. Default: "
         + misc::to_string(m_p_thresholds.upper)
         + "\n"
@@ -931,6 +1072,17 @@ void Commander::set_help_message()
           "                            base file, this is only used if the RS "
           "ID \n"
           "                            wasn't provided\n"
+          "    --chr-stream            Load, filter, clump and score one "
+          "chromosome at\n"
+          "                            a time, so that only the variants of "
+          "a single\n"
+          "                            chromosome are held in memory. The "
+          "scores of\n"
+          "                            each threshold are summed across "
+          "chromosomes\n"
+          "                            before the regression. Requires the "
+          "chromosome\n"
+          "                            column in the base file\n"
           "    --exclude               File contains SNPs to be excluded from "
           "the\n"
           "                            analysis\n"
@@ -959,7 +1111,10 @@ void Commander::set_help_message()
           "                            will substantially slow down PRSice\n"
           "    --memory                Maximum memory usage allowed (in Mb). "
           "PRSice will try\n"
-          "                            its best to honor this setting\n"
+          "                            its best to honor this setting. "
+          "Genotypes held\n"
+          "                            during clumping are limited to the "
+          "memory left\n"
           "    --non-cumulate          Calculate non-cumulative PRS. PRS will "
           "be reset\n"
           "                            to 0 for each new P-value threshold "
@@ -984,6 +1139,17 @@ void Commander::set_help_message()
           "                            \"Base\" will be presented with all "
           "entries\n"
           "                            marked as Y\n"
+          "    --score-once            Calculate the PRS of each threshold "
+          "once and\n"
+          "                            regress it against all phenotypes, "
+          "instead of\n"
+          "                            reading the genotypes once per "
+          "phenotype.\n"
+          "                            Keeps the regression results of all "
+          "phenotypes\n"
+          "                            in memory. Not available when "
+          "binary traits\n"
+          "                            are standardized with con-std\n"
           "    --seed          | -s    Seed used for permutation. If not "
           "provided,\n"
           "                            system time will be used as seed. When "
@@ -1147,9 +1313,35 @@ bool Commander::get_statistic_flag()
 bool Commander::base_check()
 {
     m_ran_base_check = true;
+    bool error = false;
+    if (!m_base_info.file_list.empty())
+    {
+        if (!m_base_info.file_name.empty())
+        {
+            error = true;
+            m_error_message.append(
+                "Error: --base and --base-list are mutually exclusive\n");
+        }
+        auto input = misc::load_stream(m_base_info.file_list);
+        std::string line;
+        m_base_info.file_names.clear();
+        while (std::getline(*input, line))
+        {
+            misc::trim(line);
+            if (line.empty()) continue;
+            m_base_info.file_names.push_back(line);
+        }
+        if (m_base_info.file_names.empty())
+        {
+            throw std::runtime_error("Error: No base file found in "
+                                     + m_base_info.file_list + "\n");
+        }
+        // column names are obtained from the first base file
+        m_base_info.file_name = m_base_info.file_names.front();
+    }
     std::vector<std::string> column_names =
         get_base_header(m_base_info.file_name);
-    return base_column_check(column_names);
+    return base_column_check(column_names) && !error;
 }
 
 bool Commander::base_column_check(std::vector<std::string>& column_names)
@@ -1275,25 +1467,74 @@ bool Commander::clump_check()
         m_error_message.append(
             "Error: Proxy threshold must be within 0 and 1!\n");
     }
-    if (!misc::within_bound<double>(m_clump_info.pvalue, 0.0, 1.0))
+    if (!m_clump_info.provided_distance && m_prset.run)
+    { m_clump_info.distance = 1000000; }
+    // without sweep, the vectors contain the single (or default) setting
+    if (m_clump_info.sweep_pvalue.empty())
+    { m_clump_info.sweep_pvalue.push_back(m_clump_info.pvalue); }
+    if (m_clump_info.sweep_r2.empty())
+    { m_clump_info.sweep_r2.push_back(m_clump_info.r2); }
+    if (m_clump_info.sweep_distance.empty())
+    { m_clump_info.sweep_distance.push_back(m_clump_info.distance); }
+    for (auto&& p : m_clump_info.sweep_pvalue)
+    {
+        if (!misc::within_bound<double>(p, 0.0, 1.0))
+        {
+            error = true;
+            m_error_message.append(
+                "Error: P-value threshold must be within 0 and 1!\n");
+            break;
+        }
+    }
+    for (auto&& r2 : m_clump_info.sweep_r2)
+    {
+        if (!misc::within_bound<double>(r2, 0.0, 1.0))
+        {
+            error = true;
+            m_error_message.append(
+                "Error: R2 threshold must be within 0 and 1!\n");
+            break;
+        }
+    }
+    const bool sweep = m_clump_info.sweep_pvalue.size() > 1
+                       || m_clump_info.sweep_r2.size() > 1
+                       || m_clump_info.sweep_distance.size() > 1;
+    if (sweep && !m_clump_info.clump_cache.empty())
+    {
+        error = true;
+        m_error_message.append("Error: --clump-cache cannot be used with "
+                               "multiple clumping parameters\n");
+    }
+    if (m_base_info.file_names.size() > 1
+        && (sweep || !m_clump_info.clump_cache.empty()))
     {
         error = true;
         m_error_message.append(
-            "Error: P-value threshold must be within 0 and 1!\n");
+            "Error: --base-list cannot be used with --clump-cache or "
+            "multiple clumping parameters\n");
     }
-    if (!misc::within_bound<double>(m_clump_info.r2, 0.0, 1.0))
+    if (!m_clump_info.ld_cache.empty()
+        && !misc::within_bound<double>(m_clump_info.ld_cache_r2, 0.0, 1.0))
     {
         error = true;
-        m_error_message.append("Error: R2 threshold must be within 0 and 1!\n");
+        m_error_message.append(
+            "Error: LD cache R2 threshold must be within 0 and 1!\n");
     }
-    m_parameter_log["clump-r2"] = std::to_string(m_clump_info.r2);
-    m_parameter_log["clump-p"] = std::to_string(m_clump_info.pvalue);
+    std::string r2_log, p_log, kb_log;
+    for (auto&& r2 : m_clump_info.sweep_r2)
+    { r2_log.append((r2_log.empty() ? "" : ",") + std::to_string(r2)); }
+    for (auto&& p : m_clump_info.sweep_pvalue)
+    { p_log.append((p_log.empty() ? "" : ",") + std::to_string(p)); }
     // we divided by 1000 here to make sure it is in KB (our preferred
     // format)
-    if (!m_clump_info.provided_distance && m_prset.run)
-    { m_clump_info.distance = 1000000; }
-    m_parameter_log["clump-kb"] =
-        std::to_string(m_clump_info.distance / 1000) + "kb";
+    for (auto&& kb : m_clump_info.sweep_distance)
+    {
+        kb_log.append((kb_log.empty() ? "" : ",") + std::to_string(kb / 1000)
+                      + "kb");
+    }
+    m_parameter_log["clump-r2"] = r2_log;
+    m_parameter_log["clump-p"] = p_log;
+    m_parameter_log["clump-kb"] = kb_log;
     return !error;
 }
 
@@ -1889,6 +2130,12 @@ bool Commander::misc_check()
     }
 
     m_parameter_log["seed"] = misc::to_string(m_perm_info.seed);
+    if (!misc::within_bound(m_prs_info.sparse_maf, 0.0, 0.5))
+    {
+        error = true;
+        m_error_message.append("Error: --sparse-maf must be between 0 and "
+                               "0.5\n");
+    }
     if (m_prs_info.thread <= 0)
     {
         error = true;
@@ -1928,6 +2175,15 @@ bool Commander::misc_check()
             "Error: Cannot use reference MAF for missingness "
             "imputation if reference file isn't used\n");
     }
+    if (!m_prepare_ref.empty()
+        && (m_prepare_ref == m_reference.file_name
+            || m_prepare_ref == m_target.file_name))
+    {
+        error = true;
+        m_error_message.append(
+            "Error: Reference package cannot overwrite the input genotype "
+            "file\n");
+    }
     if (m_allow_inter)
     {
         if ((m_target.type != "bgen"
@@ -1945,6 +2201,12 @@ bool Commander::misc_check()
                 "Warning: Intermediate not required. Will not "
                 "generate intermediate file\n");
         }
+        else if (m_base_info.file_names.size() > 1)
+        {
+            error = true;
+            m_error_message.append(
+                "Error: --allow-inter cannot be used with --base-list\n");
+        }
     }
     if (m_prs_info.no_regress && m_pheno_info.pheno_col.size() > 1)
     {
@@ -1953,12 +2215,66 @@ bool Commander::misc_check()
             "phenotype provided. As regression isn't performed, we will not "
             "utilize any of the phenotype information\n");
     }
+    if (m_target.type == "bgen" && !m_target.hard_coded
+        && !m_prs_info.other_models.empty())
+    {
+        m_error_message.append(
+            "Warning: Multiple genetic models can only be scored from hard "
+            "coded genotypes. Will only use the first model\n");
+        m_prs_info.other_models.clear();
+        m_parameter_log["model"] =
+            m_parameter_log["model"].substr(0, 3);
+    }
     if (m_target.type == "bgen" && !m_target.hard_coded && m_ultra_aggressive)
     {
         m_error_message.append("Warning: --ultra does not work with none "
                                "hard-coded bgen file. Will disable it\n");
         m_ultra_aggressive = false;
     }
+    if (m_chr_stream)
+    {
+        // the variants of each chromosome are released once they are scored,
+        // so options requiring all variants at once cannot be used
+        if (!m_base_info.has_column[+BASE_INDEX::CHR])
+        {
+            error = true;
+            m_error_message.append("Error: --chr-stream requires the "
+                                   "chromosome column of the base file\n");
+        }
+        if (m_prset.run)
+        {
+            error = true;
+            m_error_message.append(
+                "Error: --chr-stream cannot be used with PRSet\n");
+        }
+        if (m_base_info.file_names.size() > 1)
+        {
+            error = true;
+            m_error_message.append(
+                "Error: --chr-stream cannot be used with --base-list\n");
+        }
+        if (m_clump_info.sweep_r2.size() > 1
+            || m_clump_info.sweep_distance.size() > 1
+            || m_clump_info.sweep_pvalue.size() > 1)
+        {
+            error = true;
+            m_error_message.append("Error: --chr-stream cannot be used with "
+                                   "multiple clumping parameters\n");
+        }
+        if (!m_prepare_ref.empty() || !m_clump_info.clump_cache.empty())
+        {
+            error = true;
+            m_error_message.append(
+                "Error: --chr-stream cannot be used with --prepare-ref or "
+                "--clump-cache\n");
+        }
+        if (m_print_snp)
+        {
+            m_error_message.append("Warning: --print-snp is not supported "
+                                   "with --chr-stream and will be ignored\n");
+            m_print_snp = false;
+        }
+    }
     return !error;
 }
 
@@ -2070,6 +2386,18 @@ bool Commander::prsice_check()
             bar_message.append("," + misc::to_string(b));
     }
     m_parameter_log["bar-levels"] = bar_message;
+    if (m_score_once && m_prs_info.scoring_method == SCORING::CONTROL_STD
+        && std::find(m_pheno_info.binary.begin(), m_pheno_info.binary.end(),
+                     true)
+               != m_pheno_info.binary.end())
+    {
+        // the score of binary trait depends on the controls of each phenotype
+        m_error_message.append(
+            "Warning: --score-once cannot be used when binary traits are "
+            "standardized with con-std. Will score each phenotype "
+            "separately\n");
+        m_score_once = false;
+    }
     if (!m_p_thresholds.fastscore)
     {
         // perform high resolution scoring
@@ -15,6 +15,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "genotype.hpp"
+#include <sys/stat.h>
 
 std::string Genotype::print_duplicated_snps(
     const std::unordered_set<std::string>& duplicated_snp,
@@ -262,6 +263,8 @@ Genotype::transverse_base_file(
                          rs_id))
         { continue; }
         if (!parse_chr(token, base_file, filter_count, chr)) { continue; }
+        // only keep the chromosome being processed with --chr-stream
+        if (streaming() && chr != m_stream_chr) continue;
         parse_allele(token, base_file, +BASE_INDEX::EFFECT, ref_allele);
         parse_allele(token, base_file, +BASE_INDEX::NONEFFECT, alt_allele);
         if (!parse_loc(token, base_file, loc))
@@ -661,6 +664,9 @@ void Genotype::gen_sample(const size_t fid_idx, const size_t iid_idx,
         else
         {
             ++m_founder_ct;
+            m_founder_id_hash = misc::hash_bytes(
+                token[iid_idx], misc::hash_bytes(token[fid_idx],
+                                                 m_founder_id_hash));
             SET_BIT(cur_idx, m_sample_for_ld.data());
             SET_BIT(cur_idx, m_calculate_prs.data());
             in_regression = true;
@@ -678,7 +684,7 @@ void Genotype::gen_sample(const size_t fid_idx, const size_t iid_idx,
         ++m_num_ambig_sex;
     }
     // this must be incremented within each loop
-    if (inclusion && !m_is_ref)
+    if (inclusion && (!m_is_ref || m_keep_sample_id))
     {
         sample_storage.emplace_back(
             Sample_ID(token[fid_idx], token[iid_idx], pheno, in_regression));
@@ -887,7 +893,7 @@ void Genotype::load_samples(bool verbose)
         auto input = misc::load_stream(m_keep_file);
         m_sample_selection_list = load_ref(std::move(input), m_ignore_fid);
     }
-    if (!m_is_ref) { m_sample_id = gen_sample_vector(); }
+    if (!m_is_ref || m_keep_sample_id) { m_sample_id = gen_sample_vector(); }
     else
     {
         // don't bother loading up the sample vector as it should
@@ -910,6 +916,7 @@ bool Genotype::perform_freqs_and_inter(const QCFiltering& filter_info,
                                        const std::string& prefix,
                                        Genotype* target)
 {
+    if (m_is_ref && load_reference_package(filter_info, target)) return true;
     if (!m_intermediate
         && (misc::logically_equal(filter_info.geno, 1.0)
             || filter_info.geno > 1.0)
@@ -1058,7 +1065,10 @@ void Genotype::load_snps(
 
     if (verbose) m_reporter->report(message);
     m_snp_selection_list.clear();
-    if (snp_store_location->m_marker_ct == 0)
+    // with --chr-stream, the target might not have any variant of the
+    // chromosome
+    if (snp_store_location->m_marker_ct == 0
+        && !snp_store_location->streaming())
     {
         message = "Error: No vairant remained!\n";
         throw std::runtime_error(message);
@@ -1174,9 +1184,160 @@ std::vector<std::pair<size_t, size_t>> Genotype::get_chrom_boundary()
     return chrom_bound;
 }
 void Genotype::clumping(const Clumping& clump_info, Genotype& reference,
-                        size_t threads)
+                        size_t threads, const unsigned long long max_memory,
+                        LDCache* shared_ld_cache)
 {
     m_reporter->report("Start performing clumping");
+    if (shared_ld_cache != nullptr)
+    {
+        std::swap(m_ld_cache, *shared_ld_cache);
+        perform_clumping(clump_info, reference, threads, max_memory);
+        std::swap(m_ld_cache, *shared_ld_cache);
+        return;
+    }
+    if (!clump_info.ld_cache.empty() || clump_info.stream)
+    { prepare_ld_cache(clump_info, reference, threads, max_memory); }
+    perform_clumping(clump_info, reference, threads, max_memory);
+    m_ld_cache.clear();
+}
+
+void Genotype::clump_sweep(const Clumping& clump_info, Genotype& reference,
+                           size_t threads, const unsigned long long max_memory)
+{
+    m_reporter->report("Start performing clumping for "
+                       + misc::to_string(clump_info.sweep_r2.size()
+                                         * clump_info.sweep_distance.size()
+                                         * clump_info.sweep_pvalue.size())
+                       + " combination(s) of clumping parameters");
+    // calculate the R2 of all pairs within the largest window once, so that
+    // each combination is clumped without reading the genotype again
+    Clumping setting = clump_info;
+    setting.distance = *std::max_element(clump_info.sweep_distance.begin(),
+                                         clump_info.sweep_distance.end());
+    setting.r2 = *std::min_element(clump_info.sweep_r2.begin(),
+                                   clump_info.sweep_r2.end());
+    build_clump_windows(setting.distance);
+    prepare_ld_cache(setting, reference, threads, max_memory);
+    m_ld_cache_idx.clear();
+    const std::vector<SNP> unclumped = m_existed_snps;
+    m_runs.clear();
+    for (auto&& distance : clump_info.sweep_distance)
+    {
+        for (auto&& r2 : clump_info.sweep_r2)
+        {
+            for (auto&& pvalue : clump_info.sweep_pvalue)
+            {
+                setting.distance = distance;
+                setting.r2 = r2;
+                setting.pvalue = pvalue;
+                const std::string label =
+                    "r2-" + misc::to_string(r2) + "_kb-"
+                    + misc::to_string(static_cast<double>(distance) / 1000.0)
+                    + "_p-" + misc::to_string(pvalue);
+                m_reporter->report("Clumping with " + label);
+                m_existed_snps = unclumped;
+                m_existed_snps_index.clear();
+                build_clump_windows(distance);
+                sort_by_p();
+                perform_clumping(setting, reference, threads, max_memory);
+                m_runs.push_back(Run {label, std::move(m_existed_snps),
+                                      m_very_small_thresholds});
+            }
+        }
+    }
+    m_existed_snps.clear();
+    m_ld_cache.clear();
+}
+
+void Genotype::build_ld_cache(const Clumping& clump_info, Genotype& reference,
+                              size_t threads, LDCache& ld_cache,
+                              const unsigned long long max_memory)
+{
+    m_reporter->report("Calculating LD shared by all base files");
+    build_clump_windows(clump_info.distance);
+    prepare_ld_cache(clump_info, reference, threads, max_memory);
+    m_ld_cache_idx.clear();
+    ld_cache = std::move(m_ld_cache);
+    m_ld_cache.clear();
+}
+
+void Genotype::merge_snps(const Genotype& other)
+{
+    update_snp_index();
+    for (auto&& snp : other.m_existed_snps)
+    {
+        if (m_existed_snps_index.find(snp.rs()) != m_existed_snps_index.end())
+            continue;
+        m_existed_snps_index[snp.rs()] = m_existed_snps.size();
+        m_existed_snps.push_back(snp);
+    }
+    m_marker_ct = m_existed_snps.size();
+}
+
+void Genotype::sync_snps(const Genotype& merged)
+{
+    std::unordered_map<std::string, size_t> merged_index;
+    for (size_t i = 0; i < merged.m_existed_snps.size(); ++i)
+    { merged_index[merged.m_existed_snps[i].rs()] = i; }
+    std::vector<bool> retain(m_existed_snps.size(), false);
+    size_t retained = 0;
+    for (size_t i = 0; i < m_existed_snps.size(); ++i)
+    {
+        auto&& idx = merged_index.find(m_existed_snps[i].rs());
+        if (idx == merged_index.end()) continue;
+        m_existed_snps[i].copy_genotype_info(
+            merged.m_existed_snps[idx->second]);
+        retain[i] = true;
+        ++retained;
+    }
+    if (retained != m_existed_snps.size()) { shrink_snp_vector(retain); }
+    m_existed_snps_index.clear();
+    m_marker_ct = m_existed_snps.size();
+}
+
+void Genotype::add_run(const std::string& label, Genotype& other)
+{
+    if (&other == this)
+    {
+        m_runs.push_back(Run {label, m_existed_snps, m_very_small_thresholds});
+        return;
+    }
+    m_runs.push_back(Run {label, std::move(other.m_existed_snps),
+                          other.m_very_small_thresholds});
+    other.m_existed_snps.clear();
+}
+
+void Genotype::swap_run(const size_t idx, Genotype& other)
+{
+    auto&& run = m_runs.at(idx);
+    std::swap(run.snps, other.m_existed_snps);
+    std::swap(run.very_small_thresholds, other.m_very_small_thresholds);
+    other.m_existed_snps_index.clear();
+    other.m_marker_ct = other.m_existed_snps.size();
+}
+
+std::string Genotype::select_run(const size_t idx)
+{
+    auto&& [label, snps, very_small_thresholds] = m_runs.at(idx);
+    m_existed_snps = std::move(snps);
+    m_very_small_thresholds = very_small_thresholds;
+    m_existed_snps_index.clear();
+    // thresholds of each set are gathered from the current variants
+    m_set_thresholds.clear();
+    return label;
+}
+
+void Genotype::perform_clumping(const Clumping& clump_info, Genotype& reference,
+                                size_t threads,
+                                const unsigned long long max_memory)
+{
+    if (m_ld_cache.num_snps() != 0 && m_ld_cache_idx.empty())
+    { m_ld_cache_idx = m_ld_cache.index_snps(m_existed_snps); }
+    if (threads > 1 && threads > m_autosome_ct) { threads = m_autosome_ct; }
+    threads = std::max<size_t>(threads, 1);
+    // genotype rows held by all clumping threads must fit into the memory not
+    // already used by PRSice
+    MemoryBudget budget(ld_memory_limit(max_memory));
     std::vector<std::atomic<bool>> remain_snps(m_existed_snps.size());
     for (auto&& s : remain_snps) { s = false; }
     std::atomic<size_t> num_core = 0;
@@ -1187,11 +1348,10 @@ void Genotype::clumping(const Clumping& clump_info, Genotype& reference,
                                          !m_reporter->unit_testing());
         threaded_clumping(std::vector<range> {range(0, m_existed_snps.size())},
                           clump_info, progress_reporter, remain_snps, num_core,
-                          reference);
+                          reference, budget, threads);
     }
     else
     {
-        if (threads > m_autosome_ct) { threads = m_autosome_ct; }
         // get boundaries
 
         std::vector<range> snp_range = get_chrom_boundary();
@@ -1213,7 +1373,8 @@ void Genotype::clumping(const Clumping& clump_info, Genotype& reference,
                 std::thread(&Genotype::threaded_clumping<Thread_Queue<size_t>>,
                             this, job_sets, std::cref(clump_info),
                             std::ref(progress_observer), std::ref(remain_snps),
-                            std::ref(num_core), std::ref(reference)));
+                            std::ref(num_core), std::ref(reference),
+                            std::ref(budget), threads));
             job_start += job_per_thread + (remain > 0);
             remain--;
         }
@@ -1227,9 +1388,546 @@ void Genotype::clumping(const Clumping& clump_info, Genotype& reference,
         for (size_t i = 0; i < remain_snps.size(); ++i)
         { non_atomic_remain[i] = remain_snps[i]; }*/
     if (num_core != m_existed_snps.size()) { shrink_snp_vector(remain_snps); }
+    // cache index is no longer valid after shrinking
+    m_ld_cache_idx.clear();
+    m_existed_snps_index.clear();
+    m_reporter->report("Number of variant(s) after clumping : "
+                       + misc::to_string(m_existed_snps.size()));
+}
+
+void Genotype::subset_ld_samples(const size_t sample_size,
+                                 const std::random_device::result_type seed)
+{
+    if (sample_size == 0 || sample_size >= m_founder_ct) return;
+    std::vector<size_t> founders;
+    founders.reserve(m_founder_ct);
+    for (size_t i = 0; i < m_unfiltered_sample_ct; ++i)
+    {
+        if (IS_SET(m_sample_for_ld.data(), i)) founders.push_back(i);
+    }
+    // partial Fisher-Yates shuffle, the first sample_size founders are
+    // selected
+    std::mt19937 g(seed);
+    for (size_t i = 0; i < sample_size; ++i)
+    {
+        std::uniform_int_distribution<size_t> dist(i, founders.size() - 1);
+        std::swap(founders[i], founders[dist(g)]);
+    }
+    m_full_sample_for_ld = m_sample_for_ld;
+    std::fill(m_sample_for_ld.begin(), m_sample_for_ld.end(), 0);
+    for (size_t i = 0; i < sample_size; ++i)
+    { SET_BIT(founders[i], m_sample_for_ld.data()); }
+    m_reporter->report("Randomly selected " + misc::to_string(sample_size)
+                       + " out of " + misc::to_string(m_founder_ct)
+                       + " founder(s) for LD calculation");
+    m_founder_ct = sample_size;
+    init_quaterarr_from_bitarr(m_sample_for_ld.data(), m_unfiltered_sample_ct,
+                               m_founder_include2.data());
+}
+
+void Genotype::restore_ld_samples()
+{
+    if (m_full_sample_for_ld.empty()) return;
+    m_sample_for_ld.swap(m_full_sample_for_ld);
+    m_full_sample_for_ld.clear();
+    m_founder_ct = static_cast<uintptr_t>(
+        popcount_longs(m_sample_for_ld.data(), m_sample_for_ld.size()));
+    init_quaterarr_from_bitarr(m_sample_for_ld.data(), m_unfiltered_sample_ct,
+                               m_founder_include2.data());
+}
+
+uint64_t Genotype::clump_cache_key(const Clumping& clump_info,
+                                   const Genotype& reference) const
+{
+    uint64_t key = reference.ld_cache_key(clump_info.distance);
+    key = misc::hash_bytes(&clump_info.r2, sizeof(clump_info.r2), key);
+    key = misc::hash_bytes(&clump_info.pvalue, sizeof(clump_info.pvalue), key);
+    const uint64_t proxy = clump_info.use_proxy;
+    key = misc::hash_bytes(&proxy, sizeof(proxy), key);
+    if (clump_info.use_proxy)
+    {
+        key = misc::hash_bytes(&clump_info.proxy, sizeof(clump_info.proxy),
+                               key);
+    }
+    // the variants remaining after base, target and reference QC
+    for (auto&& snp : m_existed_snps)
+    {
+        const uint64_t chr = snp.chr(), loc = snp.loc();
+        const double p = snp.p_value();
+        key = misc::hash_bytes(snp.rs(), key);
+        key = misc::hash_bytes(&chr, sizeof(chr), key);
+        key = misc::hash_bytes(&loc, sizeof(loc), key);
+        key = misc::hash_bytes(&p, sizeof(p), key);
+        auto&& flags = snp.get_flag();
+        key = misc::hash_bytes(flags.data(), flags.size() * sizeof(uintptr_t),
+                               key);
+    }
+    return key;
+}
+
+bool Genotype::load_clump_cache(const std::string& file_name,
+                                const uint64_t key)
+{
+    std::ifstream cache(file_name.c_str());
+    if (!cache.is_open()) return false;
+    std::string line;
+    if (!std::getline(cache, line)) return false;
+    std::vector<std::string_view> token = misc::tokenize(line);
+    if (token.size() != 2 || token[0] != "#CLUMP_CACHE"
+        || std::string(token[1]) != std::to_string(key))
+    { return false; }
+    if (m_existed_snps_index.empty()) update_snp_index();
+    std::vector<bool> retain(m_existed_snps.size(), false);
+    std::vector<std::pair<size_t, std::vector<uintptr_t>>> clumped;
+    while (std::getline(cache, line))
+    {
+        misc::trim(line);
+        if (line.empty()) continue;
+        token = misc::tokenize(line);
+        auto&& idx = m_existed_snps_index.find(std::string(token[0]));
+        // the stored result does not belong to the current data
+        if (idx == m_existed_snps_index.end()) return false;
+        std::vector<uintptr_t> flags(token.size() - 1);
+        for (size_t i = 1; i < token.size(); ++i)
+        { flags[i - 1] = std::stoull(std::string(token[i]), nullptr, 16); }
+        if (flags.size() != m_existed_snps[idx->second].get_flag().size())
+            return false;
+        retain[idx->second] = true;
+        clumped.emplace_back(idx->second, std::move(flags));
+    }
+    for (auto&& [idx, flags] : clumped)
+    {
+        m_existed_snps[idx].get_flag() = std::move(flags);
+        m_existed_snps[idx].set_clumped();
+    }
+    if (clumped.size() != m_existed_snps.size()) { shrink_snp_vector(retain); }
     m_existed_snps_index.clear();
+    m_reporter->report("Loaded clumped result from " + file_name);
     m_reporter->report("Number of variant(s) after clumping : "
                        + misc::to_string(m_existed_snps.size()));
+    return true;
+}
+
+void Genotype::save_clump_cache(const std::string& file_name,
+                                const uint64_t key) const
+{
+    std::ofstream cache(file_name.c_str());
+    if (!cache.is_open())
+    { throw std::runtime_error("Error: Cannot open file: " + file_name); }
+    cache << "#CLUMP_CACHE\t" << key << "\n";
+    cache << std::hex;
+    for (auto&& snp : m_existed_snps)
+    {
+        cache << snp.rs();
+        for (auto&& flag : snp.get_flag()) cache << "\t" << flag;
+        cache << "\n";
+    }
+    if (!cache.good())
+    {
+        throw std::runtime_error("Error: Cannot write clump cache: "
+                                 + file_name);
+    }
+}
+
+void Genotype::prepare_reference(const std::string& prefix,
+                                 Genotype& reference)
+{
+    const uintptr_t founder_ct = reference.m_founder_ct;
+    if (founder_ct == 0)
+    {
+        throw std::runtime_error(
+            "Error: No founder in LD reference, cannot generate reference "
+            "package");
+    }
+    if (reference.m_sample_id.size() != reference.m_sample_ct)
+    {
+        throw std::runtime_error(
+            "Error: Sample ID of the LD reference were not loaded, cannot "
+            "generate reference package");
+    }
+    m_reporter->report("Writing reference package to " + prefix);
+    const std::string bed_name = prefix + ".bed";
+    const std::string bim_name = prefix + ".bim";
+    const std::string fam_name = prefix + ".fam";
+    const std::string count_name = prefix + ".prsref";
+    std::ofstream bed(bed_name.c_str(), std::ios::binary);
+    std::ofstream bim(bim_name.c_str()), fam(fam_name.c_str()),
+        count(count_name.c_str());
+    for (auto&& [name, file] :
+         {std::make_pair(&bed_name, &bed), std::make_pair(&bim_name, &bim),
+          std::make_pair(&fam_name, &fam), std::make_pair(&count_name, &count)})
+    {
+        if (!file->is_open())
+        { throw std::runtime_error("Error: Cannot open file: " + *name); }
+    }
+    // only founders used for LD calculation are kept, so all samples in the
+    // package are founders
+    size_t sample_idx = 0;
+    uint64_t founder_id_hash = 0;
+    for (size_t i = 0; i < reference.m_unfiltered_sample_ct; ++i)
+    {
+        if (!IS_SET(reference.m_calculate_prs.data(), i)) continue;
+        auto&& sample = reference.m_sample_id[sample_idx++];
+        if (!IS_SET(reference.m_sample_for_ld.data(), i)) continue;
+        fam << sample.FID << " " << sample.IID << " 0 0 0 -9\n";
+        founder_id_hash = misc::hash_bytes(
+            sample.IID, misc::hash_bytes(sample.FID, founder_id_hash));
+    }
+    // SNP-major PLINK binary
+    const char magic[3] = {0x6c, 0x1b, 0x01};
+    bed.write(magic, 3);
+    count << "#PRSICE_REF\t" << founder_ct << "\t" << founder_id_hash << "\n";
+    std::vector<size_t> order(m_existed_snps.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        auto&& snp_a = m_existed_snps[a];
+        auto&& snp_b = m_existed_snps[b];
+        if (snp_a.chr() == snp_b.chr()) return snp_a.loc() < snp_b.loc();
+        return snp_a.chr() < snp_b.chr();
+    });
+    const uintptr_t unfiltered_sample_ctv2 =
+        2 * BITCT_TO_WORDCT(reference.m_unfiltered_sample_ct);
+    const uintptr_t founder_ctl2 = QUATERCT_TO_WORDCT(founder_ct);
+    const std::streamsize founder_ct4 =
+        static_cast<std::streamsize>((founder_ct + 3) / 4);
+    std::vector<uintptr_t> genotype(unfiltered_sample_ctv2, 0);
+    GenotypeCursor cursor;
+    cursor.tmp_genotype.resize(unfiltered_sample_ctv2, 0);
+    const bool is_ref = reference.m_is_ref;
+    for (auto&& idx : order)
+    {
+        auto&& snp = m_existed_snps[idx];
+        reference.read_genotype(snp, founder_ct, cursor, genotype.data(),
+                                reference.m_sample_for_ld.data(), is_ref);
+        bed.write(reinterpret_cast<char*>(genotype.data()), founder_ct4);
+        // genotypes are in the allele order of the LD reference
+        const bool flipped = is_ref && snp.is_ref_flipped();
+        bim << snp.chr() << "\t" << snp.rs() << "\t0\t" << snp.loc() << "\t"
+            << (flipped ? snp.alt() : snp.ref()) << "\t"
+            << (flipped ? snp.ref() : snp.alt()) << "\n";
+        // 00 = homozygous A1, 01 = missing, 10 = heterozygous and
+        // 11 = homozygous A2. Trailing bits are masked to 00
+        uint32_t het_ct = 0, hom_a2_ct = 0, missing_ct = 0;
+        for (uintptr_t i = 0; i < founder_ctl2; ++i)
+        {
+            const uintptr_t low = genotype[i] & FIVEMASK;
+            const uintptr_t high = (genotype[i] >> 1) & FIVEMASK;
+            het_ct += popcount2_long(high & ~low);
+            hom_a2_ct += popcount2_long(high & low);
+            missing_ct += popcount2_long(low & ~high);
+        }
+        const uint32_t hom_a1_ct =
+            static_cast<uint32_t>(founder_ct) - het_ct - hom_a2_ct - missing_ct;
+        count << snp.rs() << "\t" << snp.chr() << "\t" << snp.loc() << "\t"
+              << hom_a1_ct << "\t" << het_ct << "\t" << hom_a2_ct << "\n";
+    }
+    if (!bed.good() || !bim.good() || !fam.good() || !count.good())
+    {
+        throw std::runtime_error("Error: Cannot write reference package: "
+                                 + prefix);
+    }
+    m_reporter->report(misc::to_string(order.size()) + " variant(s) and "
+                       + misc::to_string(founder_ct)
+                       + " founder(s) written to reference package");
+}
+
+bool Genotype::load_reference_package(const QCFiltering& filter_info,
+                                      Genotype* target)
+{
+    if (m_genotype_file_names.size() != 1) return false;
+    const std::string package_name = m_genotype_file_names.front() + ".prsref";
+    std::ifstream package(package_name.c_str());
+    if (!package.is_open()) return false;
+    std::string line;
+    if (!std::getline(package, line)) return false;
+    misc::trim(line);
+    std::vector<std::string_view> token = misc::tokenize(line);
+    if (token.size() != 3 || token[0] != "#PRSICE_REF") return false;
+    // counts are only valid if all founders of the package are used
+    if (std::string(token[1]) != std::to_string(m_founder_ct)
+        || std::string(token[2]) != std::to_string(m_founder_id_hash)
+        || m_sample_ct != m_founder_ct)
+    {
+        m_reporter->report("Warning: Samples differ from those in the "
+                           "reference package. Will recalculate the allele "
+                           "frequencies");
+        return false;
+    }
+    // chromosome, coordinate and the genotype counts of each variant
+    std::unordered_map<std::string, std::array<size_t, 5>> package_counts;
+    while (std::getline(package, line))
+    {
+        misc::trim(line);
+        if (line.empty()) continue;
+        token = misc::tokenize(line);
+        if (token.size() != 6)
+        {
+            throw std::runtime_error("Error: Malformed reference package: "
+                                     + package_name);
+        }
+        std::array<size_t, 5> record;
+        for (size_t i = 0; i < record.size(); ++i)
+        { record[i] = misc::convert<size_t>(std::string(token[i + 1])); }
+        package_counts[std::string(token[0])] = record;
+    }
+    auto&& snps = target->m_existed_snps;
+    for (auto&& snp : snps)
+    {
+        auto&& record = package_counts.find(snp.rs());
+        if (record == package_counts.end()) return false;
+        if (record->second[0] != snp.chr() || record->second[1] != snp.loc())
+        {
+            m_reporter->report("Warning: Variants differ from those in the "
+                               "reference package. Will recalculate the "
+                               "allele frequencies");
+            return false;
+        }
+    }
+    m_reporter->report("Perform filtering on reference SNPs using counts from "
+                       + package_name + "\n"
+                       + "==================================================");
+    std::vector<bool> retain_snps(snps.size(), false);
+    size_t retained = 0;
+    uint32_t missing_founder_ct = 0;
+    for (size_t i = 0; i < snps.size(); ++i)
+    {
+        auto&& record = package_counts[snps[i].rs()];
+        const uint32_t hom_a1_ct = static_cast<uint32_t>(record[2]);
+        const uint32_t het_ct = static_cast<uint32_t>(record[3]);
+        const uint32_t hom_a2_ct = static_cast<uint32_t>(record[4]);
+        // all samples in the package are founders
+        if (filter_snp(hom_a1_ct, het_ct, hom_a2_ct, hom_a1_ct, het_ct,
+                       hom_a2_ct, filter_info.geno, filter_info.maf,
+                       missing_founder_ct))
+        { continue; }
+        snps[i].set_counts(hom_a1_ct, het_ct, hom_a2_ct, missing_founder_ct,
+                           true);
+        retain_snps[i] = true;
+        ++retained;
+    }
+    if (retained != snps.size()) { target->shrink_snp_vector(retain_snps); }
+    return true;
+}
+
+uint64_t Genotype::ld_cache_key(const size_t distance) const
+{
+    const uint64_t clump_distance = distance;
+    const uint64_t sample_ct = m_unfiltered_sample_ct;
+    uint64_t key = misc::hash_bytes(&clump_distance, sizeof(clump_distance));
+    key = misc::hash_bytes(&sample_ct, sizeof(sample_ct), key);
+    key = misc::hash_bytes(m_sample_for_ld.data(),
+                           m_sample_for_ld.size() * sizeof(uintptr_t), key);
+    // hard coding of dosage data will change the genotype
+    key = misc::hash_bytes(&m_hard_threshold, sizeof(m_hard_threshold), key);
+    key = misc::hash_bytes(&m_dose_threshold, sizeof(m_dose_threshold), key);
+    for (auto&& prefix : m_genotype_file_names)
+    {
+        key = misc::hash_bytes(prefix, key);
+        for (auto&& suffix : {".bed", ".bgen"})
+        {
+            // the content is too large to hash, the file is assumed unchanged
+            // if both its size and modification time are the same
+            struct stat file_stat;
+            if (stat((prefix + suffix).c_str(), &file_stat) != 0) continue;
+            const int64_t file_size = file_stat.st_size;
+            const int64_t modified = file_stat.st_mtime;
+            key = misc::hash_bytes(&file_size, sizeof(file_size), key);
+            key = misc::hash_bytes(&modified, sizeof(modified), key);
+        }
+    }
+    return key;
+}
+
+size_t Genotype::ld_memory_limit(const unsigned long long max_memory)
+{
+    if (max_memory == 0) return std::numeric_limits<size_t>::max();
+    const size_t current_usage = misc::getCurrentRSS();
+    return max_memory > current_usage ? max_memory - current_usage : 0;
+}
+
+void Genotype::prepare_ld_cache(const Clumping& clump_info,
+                                Genotype& reference, size_t threads,
+                                const unsigned long long max_memory)
+{
+    const double min_r2 = clump_info.use_proxy
+                              ? std::min(clump_info.proxy, clump_info.r2)
+                              : clump_info.r2;
+    const uint64_t key = reference.ld_cache_key(clump_info.distance);
+    const std::string memory_warning =
+        "Warning: Not enough memory (--memory) to keep the R2 of all variant "
+        "pairs. Clumping will read the LD reference on demand instead";
+    struct stat cache_stat;
+    if (!clump_info.ld_cache.empty()
+        && stat(clump_info.ld_cache.c_str(), &cache_stat) == 0
+        && static_cast<size_t>(cache_stat.st_size)
+               > ld_memory_limit(max_memory))
+    {
+        m_reporter->report(memory_warning);
+        return;
+    }
+    if (!clump_info.ld_cache.empty()
+        && m_ld_cache.load(clump_info.ld_cache, key, min_r2))
+    {
+        m_ld_cache_idx = m_ld_cache.index_snps(m_existed_snps);
+        const auto num_cached =
+            std::count_if(m_ld_cache_idx.begin(), m_ld_cache_idx.end(),
+                          [](uint32_t i) { return i != LDCache::not_cached; });
+        m_reporter->report("Loaded LD cache: " + clump_info.ld_cache + ". "
+                           + misc::to_string(num_cached) + " out of "
+                           + misc::to_string(m_existed_snps.size())
+                           + " variant(s) found in the cache");
+        return;
+    }
+    // without a cache file, the cache is only kept in memory and only need
+    // to store pairs relevant to the current clumping
+    if (!clump_info.ld_cache.empty())
+    {
+        m_reporter->report("Generating LD cache: " + clump_info.ld_cache);
+        m_ld_cache.reset(key, std::min(clump_info.ld_cache_r2, min_r2),
+                         m_existed_snps);
+    }
+    else
+    {
+        m_reporter->report("Streaming LD reference in file order");
+        m_ld_cache.reset(key, min_r2, m_existed_snps);
+    }
+    if (threads > 1 && threads > m_autosome_ct) { threads = m_autosome_ct; }
+    threads = std::max<size_t>(threads, 1);
+    // genotype rows of the windows and the stored R2 share the memory not
+    // already used by PRSice
+    MemoryBudget budget(ld_memory_limit(max_memory));
+    std::atomic<bool> exceeded = false;
+    using range = std::pair<size_t, size_t>;
+    if (threads == 1)
+    {
+        threaded_ld_cache(std::vector<range> {range(0, m_existed_snps.size())},
+                          reference, budget, threads, exceeded);
+    }
+    else
+    {
+        // each chromosome can be processed independently
+        std::vector<range> snp_range = get_chrom_boundary();
+        std::vector<std::thread> subjects;
+        size_t job_per_thread = snp_range.size() / threads;
+        size_t remain = snp_range.size() % threads;
+        size_t job_start = 0;
+        for (size_t i_thread = 0; i_thread < threads; ++i_thread)
+        {
+            const size_t job_end = job_start + job_per_thread + (remain > 0);
+            std::vector<range> job_sets(snp_range.begin() + job_start,
+                                        snp_range.begin() + job_end);
+            subjects.push_back(std::thread(&Genotype::threaded_ld_cache, this,
+                                           job_sets, std::ref(reference),
+                                           std::ref(budget), threads,
+                                           std::ref(exceeded)));
+            job_start = job_end;
+            if (remain > 0) --remain;
+        }
+        for (auto&& thread : subjects) thread.join();
+    }
+    if (exceeded)
+    {
+        m_reporter->report(memory_warning);
+        m_ld_cache.clear();
+        m_ld_cache_idx.clear();
+        return;
+    }
+    if (!clump_info.ld_cache.empty()) m_ld_cache.save(clump_info.ld_cache);
+    m_ld_cache_idx.resize(m_existed_snps.size());
+    std::iota(m_ld_cache_idx.begin(), m_ld_cache_idx.end(), 0);
+    m_reporter->report("Stored " + misc::to_string(m_ld_cache.num_pairs())
+                       + " variant pair(s) with R2 >= "
+                       + misc::to_string(m_ld_cache.r2_floor())
+                       + " in the LD cache");
+}
+
+void Genotype::threaded_ld_cache(
+    const std::vector<std::pair<size_t, size_t>> snp_range,
+    Genotype& reference, MemoryBudget& budget, const size_t threads,
+    std::atomic<bool>& exceeded)
+{
+    const uint32_t founder_ctv3 =
+        BITCT_TO_ALIGNED_WORDCT(static_cast<uint32_t>(reference.m_founder_ct));
+    const uintptr_t founder_ctl2 = QUATERCT_TO_WORDCT(reference.m_founder_ct);
+    const uint32_t founder_ctsplit = 3 * founder_ctv3;
+    const uintptr_t founder_ctv2 =
+        QUATERCT_TO_ALIGNED_WORDCT(reference.m_founder_ct);
+    const uintptr_t unfiltered_sample_ctl =
+        BITCT_TO_WORDCT(reference.m_unfiltered_sample_ct);
+    const uintptr_t unfiltered_sample_ctv2 = 2 * unfiltered_sample_ctl;
+    std::vector<uintptr_t> index_data(3 * founder_ctsplit + founder_ctv3);
+    std::vector<uintptr_t> index_tots(6);
+    std::vector<uintptr_t> founder_include2(founder_ctv2, 0);
+    fill_quatervec_55(static_cast<uint32_t>(reference.m_founder_ct),
+                      founder_include2.data());
+    // only SNPs within the current window are kept in memory, each as a row
+    // compacted to the founders used for LD calculation. The pool starts
+    // with the thread's share of the budget and grows while the budget allows
+    const size_t budget_rows =
+        budget.limit() / (threads * GenotypePool::row_size(founder_ctv2));
+    const size_t pool_size = std::max<size_t>(
+        std::min<size_t>(m_max_window_size + 1, budget_rows), 2);
+    GenotypePool genotype_pool(pool_size, founder_ctv2, &budget);
+    GenotypeCursor cursor;
+    cursor.tmp_genotype.resize(unfiltered_sample_ctv2);
+    auto&& sample_for_ld = reference.m_sample_for_ld.data();
+    for (auto&& range : snp_range)
+    {
+        if (exceeded) break;
+        const size_t range_start = std::get<0>(range);
+        const size_t range_end = std::get<1>(range);
+        size_t release_idx = range_start;
+        // SNPs are sorted by coordinate, so we can go through the file
+        // sequentially and calculate the R2 between the current SNP and all
+        // SNPs before it within the window
+        size_t i_snp = range_start;
+        for (; i_snp < range_end && !exceeded; ++i_snp)
+        {
+            auto&& cur_snp = m_existed_snps[i_snp];
+            // all SNPs of the window are required for the R2 of the next
+            // SNP, so none of them can be evicted
+            auto storage = genotype_pool.alloc();
+            if (storage == nullptr)
+            {
+                exceeded = true;
+                break;
+            }
+            cur_snp.set_genotype_storage(storage);
+            reference.read_genotype(cur_snp, reference.m_founder_ct, cursor,
+                                    cur_snp.current_genotype(), sample_for_ld,
+                                    true);
+            update_index_tot(founder_ctl2, founder_ctv2, reference.m_founder_ct,
+                             index_data, index_tots, founder_include2,
+                             cur_snp.current_genotype());
+            for (size_t j_snp = std::max(cur_snp.low_bound(), range_start);
+                 j_snp < i_snp; ++j_snp)
+            {
+                const double r2 = get_r2(
+                    founder_ctl2, founder_ctv2,
+                    m_existed_snps[j_snp].current_genotype(), index_data,
+                    index_tots);
+                const size_t grown = m_ld_cache.add(
+                    static_cast<uint32_t>(j_snp), static_cast<uint32_t>(i_snp),
+                    r2);
+                if (grown != 0 && !budget.reserve(grown)) exceeded = true;
+            }
+            // release SNPs that are no longer within the window of the next
+            // SNP
+            while (release_idx <= i_snp
+                   && m_existed_snps[release_idx].up_bound() <= i_snp + 1)
+            {
+                m_existed_snps[release_idx].freed_geno_storage(genotype_pool);
+                ++release_idx;
+            }
+        }
+        // when stopped early, the SNP that failed to get a row holds none
+        for (; release_idx < std::min(i_snp + 1, range_end); ++release_idx)
+        {
+            auto&& snp = m_existed_snps[release_idx];
+            if (snp.current_genotype() != nullptr)
+                snp.freed_geno_storage(genotype_pool);
+        }
+    }
 }
 
 void Genotype::clump_progress_observer(Thread_Queue<size_t>& progress_observer,
@@ -1256,7 +1954,7 @@ void Genotype::threaded_clumping(
     const std::vector<std::pair<size_t, size_t>> snp_range,
     const Clumping& clump_info, T& progress_observer,
     std::vector<std::atomic<bool>>& remain_snps, std::atomic<size_t>& num_core,
-    Genotype& reference)
+    Genotype& reference, MemoryBudget& budget, const size_t threads)
 {
     const double min_r2 = clump_info.use_proxy
                               ? std::min(clump_info.proxy, clump_info.r2)
@@ -1285,14 +1983,25 @@ void Genotype::threaded_clumping(
     const auto max_size = m_max_window_size > std::floor(num_snp_in_chr * 0.2)
                               ? m_max_window_size
                               : std::floor(num_snp_in_chr * 0.2);
-    GenotypePool genotype_pool(max_size + 1, unfiltered_sample_ctv2);
-    auto tmp_genotype = genotype_pool.alloc();
+    // each thread starts with its share of the memory budget, and need at
+    // least the index row and one window row. Rows only contain the founders
+    // used for LD calculation, the full row is only needed when reading
+    const size_t budget_rows =
+        budget.limit() / (threads * GenotypePool::row_size(founder_ctv2));
+    const size_t pool_size = std::max<size_t>(
+        std::min<size_t>(static_cast<size_t>(max_size) + 1, budget_rows), 2);
+    GenotypePool genotype_pool(pool_size, founder_ctv2, &budget);
+    GenotypeCursor cursor;
+    cursor.tmp_genotype.resize(unfiltered_sample_ctv2);
+    // SNPs currently holding a genotype row. Might contain SNPs whose row was
+    // already freed, which are removed during eviction
+    std::vector<size_t> held_geno;
     double r2 = -1;
-    FileRead genotype_file;
     size_t num_processed = 0, prev_processed = 0;
     double local_progress = 0.0, prev_progress = 0.0;
     size_t local_num_core = 0;
     auto&& sample_for_ld = reference.m_sample_for_ld.data();
+    const bool use_cache = !m_ld_cache_idx.empty();
     for (auto&& range : snp_range)
     {
         for (size_t i_snp = std::get<0>(range); i_snp < std::get<1>(range);
@@ -1314,36 +2023,97 @@ void Genotype::threaded_clumping(
             { continue; }
             const size_t clump_start_idx = core_snp.low_bound();
             const size_t clump_end_idx = core_snp.up_bound();
+            const uint32_t core_cache_idx =
+                use_cache ? m_ld_cache_idx[core_snp_idx] : LDCache::not_cached;
+            // pairs with both SNPs in the LD cache do not require the genotype
+            auto in_cache = [&](const size_t clump_idx) {
+                return core_cache_idx != LDCache::not_cached
+                       && m_ld_cache_idx[clump_idx] != LDCache::not_cached;
+            };
+            // when the memory budget is reached, evict rows of SNPs outside
+            // the current window first, then rows within the window, which
+            // will be re-read when required
+            auto evict = [&](const bool within_window) {
+                size_t num_evicted = 0;
+                auto released = [&](const size_t idx) {
+                    auto&& snp = m_existed_snps[idx];
+                    if (snp.current_genotype() == nullptr) return true;
+                    if (idx == core_snp_idx
+                        || (!within_window && idx >= clump_start_idx
+                            && idx < clump_end_idx))
+                    { return false; }
+                    snp.freed_geno_storage(genotype_pool);
+                    ++num_evicted;
+                    return true;
+                };
+                held_geno.erase(std::remove_if(held_geno.begin(),
+                                               held_geno.end(), released),
+                                held_geno.end());
+                return num_evicted;
+            };
+            // return false if the genotype isn't required and cannot be read
+            // without evicting rows within the window
+            auto load_genotype = [&](SNP& snp, const size_t idx,
+                                     const bool required) {
+                if (snp.current_genotype() != nullptr) return true;
+                auto storage = genotype_pool.alloc();
+                if (storage == nullptr
+                    && (evict(false) > 0 || (required && evict(true) > 0)))
+                { storage = genotype_pool.alloc(); }
+                if (storage == nullptr)
+                {
+                    if (!required) return false;
+                    throw std::runtime_error(
+                        "Error: Insufficient memory for clumping");
+                }
+                snp.set_genotype_storage(storage);
+                reference.read_genotype(snp, reference.m_founder_ct, cursor,
+                                        snp.current_genotype(), sample_for_ld,
+                                        true);
+                held_geno.push_back(idx);
+                return true;
+            };
+            bool index_ready = false;
+            auto prepare_index = [&]() {
+                if (index_ready) return;
+                load_genotype(core_snp, core_snp_idx, true);
+                update_index_tot(founder_ctl2, founder_ctv2,
+                                 reference.m_founder_ct, index_data, index_tots,
+                                 founder_include2, core_snp.current_genotype());
+                core_snp.freed_geno_storage(genotype_pool);
+                index_ready = true;
+            };
+            auto pair_r2 = [&](SNP& clump_snp, const size_t clump_idx) {
+                if (in_cache(clump_idx))
+                {
+                    return m_ld_cache.r2(core_cache_idx,
+                                         m_ld_cache_idx[clump_idx]);
+                }
+                // index row is freed once prepared, so prepare it first
+                prepare_index();
+                load_genotype(clump_snp, clump_idx, true);
+                return get_r2(founder_ctl2, founder_ctv2,
+                              clump_snp.current_genotype(), index_data,
+                              index_tots);
+            };
             // the reason this is a two part process is so that we can reduce
             // the number of fseek
+            bool need_index = false;
             for (size_t clump_idx = clump_start_idx; clump_idx < core_snp_idx;
                  ++clump_idx)
             {
                 auto&& clump_snp = m_existed_snps[clump_idx];
                 if (clump_snp.clumped()
-                    || clump_snp.p_value() > clump_info.pvalue)
+                    || clump_snp.p_value() > clump_info.pvalue
+                    || in_cache(clump_idx))
                 { continue; }
-                if (clump_snp.current_genotype() == nullptr)
-                {
-                    clump_snp.set_genotype_storage(genotype_pool.alloc());
-                    reference.read_genotype(
-                        clump_snp, reference.m_founder_ct, genotype_file,
-                        tmp_genotype->get_geno(), clump_snp.current_genotype(),
-                        sample_for_ld, true);
-                }
+                need_index = true;
+                // stop reading ahead once the memory budget is reached, the
+                // remaining SNPs are read on demand
+                if (!load_genotype(clump_snp, clump_idx, false)) break;
             }
-            if (core_snp.current_genotype() == nullptr)
-            {
-                core_snp.set_genotype_storage(genotype_pool.alloc());
-                reference.read_genotype(core_snp, reference.m_founder_ct,
-                                        genotype_file, tmp_genotype->get_geno(),
-                                        core_snp.current_genotype(),
-                                        sample_for_ld, true);
-            }
-            update_index_tot(founder_ctl2, founder_ctv2, reference.m_founder_ct,
-                             index_data, index_tots, founder_include2,
-                             core_snp.current_genotype());
-            core_snp.freed_geno_storage(genotype_pool);
+            if (need_index || core_cache_idx == LDCache::not_cached)
+            { prepare_index(); }
 
             for (size_t clump_idx = clump_start_idx; clump_idx < core_snp_idx;
                  ++clump_idx)
@@ -1352,15 +2122,13 @@ void Genotype::threaded_clumping(
                 if (clump_snp.clumped()
                     || clump_snp.p_value() > clump_info.pvalue)
                 { continue; }
-                r2 = get_r2(founder_ctl2, founder_ctv2,
-                            clump_snp.current_genotype(), index_data,
-                            index_tots);
-
+                r2 = pair_r2(clump_snp, clump_idx);
                 if (r2 >= min_r2)
                 {
                     core_snp.clump(clump_snp, r2, clump_info.use_proxy,
                                    clump_info.proxy);
-                    if (clump_snp.clumped())
+                    if (clump_snp.clumped()
+                        && clump_snp.current_genotype() != nullptr)
                     { clump_snp.freed_geno_storage(genotype_pool); }
                 }
             }
@@ -1373,26 +2141,20 @@ void Genotype::threaded_clumping(
                 if (clump_snp.clumped()
                     || clump_snp.p_value() > clump_info.pvalue)
                     continue;
-                if (clump_snp.current_genotype() == nullptr)
-                {
-                    clump_snp.set_genotype_storage(genotype_pool.alloc());
-                    reference.read_genotype(
-                        clump_snp, reference.m_founder_ct, genotype_file,
-                        tmp_genotype->get_geno(), clump_snp.current_genotype(),
-                        sample_for_ld, true);
-                }
-                r2 = get_r2(founder_ctl2, founder_ctv2,
-                            clump_snp.current_genotype(), index_data,
-                            index_tots);
-
+                r2 = pair_r2(clump_snp, clump_idx);
                 if (r2 >= min_r2)
                 {
                     core_snp.clump(clump_snp, r2, clump_info.use_proxy,
                                    clump_info.proxy);
-                    if (clump_snp.clumped())
+                    if (clump_snp.clumped()
+                        && clump_snp.current_genotype() != nullptr)
                     { clump_snp.freed_geno_storage(genotype_pool); }
                 }
             }
+            // core SNP might still hold a genotype read as part of an earlier
+            // window if all of its pairs were served by the LD cache
+            if (core_snp.current_genotype() != nullptr)
+            { core_snp.freed_geno_storage(genotype_pool); }
             core_snp.set_clumped();
             // we set the remain_core to true so that we will keep it at the end
             remain_snps[core_snp_idx] = true;
@@ -1403,7 +2165,6 @@ void Genotype::threaded_clumping(
 
     progress_observer.completed();
     num_core += local_num_core;
-    genotype_pool.free(tmp_genotype);
 }
 void Genotype::recalculate_categories(const PThresholding& p_info)
 { // need to loop through the SNPs to check
@@ -1590,25 +2351,27 @@ Genotype::build_membership_matrix(const size_t num_sets,
 void Genotype::standardize_prs()
 {
     misc::RunningStat rs;
-    const size_t num_prs = m_prs_info.size();
+    auto&& scores = active_scores();
+    const size_t num_prs = scores.size();
     for (size_t i = 0; i < num_prs; ++i)
     {
         // only standardize using samples that are selected and have valid pheno
         if (!IS_SET(m_calculate_prs, i) || !m_sample_id[i].in_regression
             || IS_SET(m_exclude_from_std, i))
             continue;
-        if (m_prs_info[i].num_snp == 0) { rs.push(0.0); }
+        const size_t num_snp = scores.snp_count(i);
+        if (num_snp == 0) { rs.push(0.0); }
         else
         {
-            rs.push(m_prs_info[i].prs
-                    / static_cast<double>(m_prs_info[i].num_snp));
+            rs.push(scores.score(i, m_active_model)
+                    / static_cast<double>(num_snp));
         }
     }
     m_mean_score = rs.mean();
     m_score_sd = rs.sd();
 }
 
-void Genotype::get_null_score(std::vector<PRS>& prs_list,
+void Genotype::get_null_score(PRSList& prs_list, GenotypeCursor& cursor,
                               const size_t& set_size, const size_t& prev_size,
                               std::vector<size_t>& background_list,
                               const bool first_run)
@@ -1624,11 +2387,60 @@ void Genotype::get_null_score(std::vector<PRS>& prs_list,
     std::vector<size_t>::iterator select_end = background_list.begin();
     std::advance(select_end, static_cast<long>(set_size));
     std::sort(select_start, select_end);
-    read_score(prs_list, select_start, select_end, first_run);
-    if (m_prs_calculation.scoring_method == SCORING::STANDARDIZE
-        || m_prs_calculation.scoring_method == SCORING::CONTROL_STD)
-    { standardize_prs(); }
+    read_score(prs_list, select_start, select_end, first_run, cursor);
+}
+
+void Genotype::parallel_read_score(
+    const std::vector<size_t>::const_iterator& start,
+    const std::vector<size_t>::const_iterator& end, bool reset_zero)
+{
+    const size_t num_variant = static_cast<size_t>(std::distance(start, end));
+    const size_t num_chunk =
+        (num_variant + score_chunk_size - 1) / score_chunk_size;
+    auto chunk_start = [&](const size_t i_chunk) {
+        return start
+               + static_cast<long>(
+                   std::min(i_chunk * score_chunk_size, num_variant));
+    };
+    // chunks are taken in order, and each thread waits for the chunks before
+    // its own to be added, so only one buffer per thread is required
+    std::atomic<size_t> next_chunk(1);
+    size_t num_added = 0;
+    std::mutex add_mutex;
+    std::condition_variable added;
+    auto score_chunks = [&](GenotypeCursor& cursor) {
+        PRSList buffer = new_prs_list();
+        size_t i_chunk;
+        while ((i_chunk = next_chunk++) < num_chunk)
+        {
+            buffer.reset();
+            read_score(buffer, chunk_start(i_chunk), chunk_start(i_chunk + 1),
+                       false, cursor);
+            std::unique_lock<std::mutex> lock(add_mutex);
+            added.wait(lock, [&] { return num_added == i_chunk; });
+            m_prs_info.add(buffer);
+            ++num_added;
+            added.notify_all();
+        }
+    };
+    const size_t num_thread = std::min(
+        static_cast<size_t>(std::max(m_prs_calculation.thread, 1)), num_chunk);
+    std::vector<GenotypeCursor> cursors;
+    for (size_t i = 0; i + 1 < num_thread; ++i)
+    { cursors.push_back(new_cursor()); }
+    std::vector<std::thread> subjects;
+    for (auto&& cursor : cursors)
+    { subjects.emplace_back(score_chunks, std::ref(cursor)); }
+    read_score(m_prs_info, start, chunk_start(1), reset_zero);
+    {
+        std::lock_guard<std::mutex> lock(add_mutex);
+        num_added = 1;
+    }
+    added.notify_all();
+    score_chunks(m_cursor);
+    for (auto&& thread : subjects) thread.join();
 }
+
 void Genotype::load_genotype_to_memory()
 {
     // don't reserve memory if we don't need to run hard coding
@@ -1639,8 +2451,13 @@ void Genotype::load_genotype_to_memory()
         BITCT_TO_WORDCT(m_unfiltered_sample_ct);
     const uintptr_t unfiltered_sample_ctv2 = 2 * unfiltered_sample_ctl;
     std::streampos cur_line;
-    m_genotype_pool =
-        GenotypePool(m_existed_snps.size(), unfiltered_sample_ctv2);
+    // rare variants are stored as their carriers without a genotype row, so
+    // the pool is grown in smaller blocks
+    const bool sparse = m_prs_calculation.sparse_maf > 0.0;
+    const size_t block_size =
+        sparse ? std::min<size_t>(m_existed_snps.size(), 1024)
+               : m_existed_snps.size();
+    m_genotype_pool = GenotypePool(block_size, unfiltered_sample_ctv2);
     std::sort(begin(m_existed_snps), end(m_existed_snps),
               [](SNP const& t1, SNP const& t2) {
                   if (t1.get_file_idx() == t2.get_file_idx())
@@ -1648,18 +2465,204 @@ void Genotype::load_genotype_to_memory()
                   else
                       return t1.get_file_idx() < t2.get_file_idx();
               });
-    for (auto&& snp : m_existed_snps)
+    // variants are read in small chunks taken in turn by each thread, with
+    // each chunk decoded as one block using the thread's own file handle and
+    // buffers. Only the pool is shared
+    const auto load_start = std::chrono::steady_clock::now();
+    const size_t num_snp = m_existed_snps.size();
+    const size_t chunk_size = 256;
+    const size_t num_thread = std::max<size_t>(
+        1, std::min((num_snp + chunk_size - 1) / chunk_size,
+                    static_cast<size_t>(m_prs_calculation.thread)));
+    std::atomic<size_t> next_chunk(0);
+    std::atomic<size_t> num_sparse(0);
+    std::mutex pool_mutex;
+    std::vector<std::exception_ptr> load_error(num_thread, nullptr);
+    auto load_chunks = [&](const size_t i_thread) {
+        GenotypeCursor cursor = new_cursor();
+        GenotypeBlock block;
+        std::vector<size_t> chunk_index;
+        std::vector<bool> is_sparse;
+        uint32_t baseline;
+        try
+        {
+            size_t start;
+            while ((start = next_chunk.fetch_add(chunk_size)) < num_snp)
+            {
+                chunk_index.resize(std::min(start + chunk_size, num_snp)
+                                   - start);
+                std::iota(chunk_index.begin(), chunk_index.end(), start);
+                auto cur = chunk_index.cbegin();
+                next_block(cur, chunk_index.cend(), chunk_size, block, cursor);
+                is_sparse.assign(block.size(), false);
+                for (size_t i = 0; sparse && i < block.size(); ++i)
+                {
+                    auto&& ct = block.counts[i];
+                    if (!use_carrier_list(ct.homcom, ct.het, ct.homrar,
+                                          baseline))
+                    { continue; }
+                    CarrierList carriers;
+                    build_carrier_list(block.packed_row(i), baseline,
+                                       carriers);
+                    carriers.samples.shrink_to_fit();
+                    m_existed_snps[block.index[i]].set_carriers(
+                        std::move(carriers));
+                    is_sparse[i] = true;
+                    ++num_sparse;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(pool_mutex);
+                    for (size_t i = 0; i < block.size(); ++i)
+                    {
+                        if (is_sparse[i]) continue;
+                        m_existed_snps[block.index[i]].set_genotype_storage(
+                            m_genotype_pool.alloc());
+                    }
+                }
+                for (size_t i = 0; i < block.size(); ++i)
+                {
+                    if (is_sparse[i]) continue;
+                    std::copy_n(
+                        block.packed_row(i), block.row_words,
+                        m_existed_snps[block.index[i]].current_genotype());
+                }
+            }
+        }
+        catch (...)
+        {
+            load_error[i_thread] = std::current_exception();
+            // stop the other threads from taking new chunks
+            next_chunk = num_snp;
+        }
+    };
+    std::vector<std::thread> loaders;
+    for (size_t i_thread = 1; i_thread < num_thread; ++i_thread)
+    { loaders.emplace_back(load_chunks, i_thread); }
+    load_chunks(0);
+    for (auto&& loader : loaders) loader.join();
+    for (auto&& error : load_error)
+    {
+        if (error) std::rethrow_exception(error);
+    }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                      - load_start)
+            .count();
+    const double megabytes =
+        static_cast<double>((num_snp - num_sparse)
+                            * GenotypePool::row_size(unfiltered_sample_ctv2))
+        / (1024.0 * 1024.0);
+    std::string message = "Loaded " + std::to_string(num_snp)
+                          + " variants into memory ("
+                          + misc::to_string(megabytes) + " MB) in "
+                          + misc::to_string(seconds) + " seconds using "
+                          + std::to_string(num_thread) + " thread(s)";
+    if (seconds > 0)
+    {
+        message.append(", " + misc::to_string(num_snp / seconds)
+                       + " variants per second");
+    }
+    if (num_sparse != 0)
+    {
+        message.append(". " + std::to_string(num_sparse.load())
+                       + " rare variants are stored as their carriers");
+    }
+    m_reporter->report(message + "\n");
+}
+
+bool Genotype::next_block(std::vector<size_t>::const_iterator& cur,
+                          const std::vector<size_t>::const_iterator& end,
+                          const size_t block_size, GenotypeBlock& block,
+                          GenotypeCursor& cursor)
+{
+    block.index.clear();
+    while (cur != end && block.index.size() < block_size)
+    { block.index.push_back(*(cur++)); }
+    if (block.index.empty()) return false;
+    const size_t num_row = block.index.size();
+    block.is_dosage = !m_hard_coded;
+    if (block.num_sample != m_sample_ct || block.sample_mask.empty())
+    {
+        block.num_sample = m_sample_ct;
+        block.row_words = 2 * BITCT_TO_WORDCT(m_sample_ct);
+        block.sample_mask.assign(block.row_words, 0);
+        fill_quatervec_55(static_cast<uint32_t>(m_sample_ct),
+                          block.sample_mask.data());
+    }
+    if (block.is_dosage)
     {
-        snp.set_genotype_storage(m_genotype_pool.alloc());
-        this->count_and_read_genotype(snp);
+        block.packed.clear();
+        block.dosage.resize(num_row * 3 * block.num_sample);
     }
+    else
+    {
+        block.dosage.clear();
+        block.packed.resize(num_row * block.row_words);
+    }
+    block.counts.assign(num_row, AlleleCounts());
+    // the backend fills in the counts it uses for scoring
+    read_block(block, cursor);
+    for (size_t i = 0; i < num_row; ++i)
+    {
+        auto&& ct = block.counts[i];
+        if (ct.has_count) continue;
+        ct.has_count = m_existed_snps[block.index[i]].get_counts(
+            ct.homcom, ct.het, ct.homrar, ct.missing,
+            m_prs_calculation.use_ref_maf);
+        if (ct.has_count || block.is_dosage) continue;
+        genovec_3freq(block.packed_row(i), block.sample_mask.data(),
+                      block.row_words, &ct.missing, &ct.het, &ct.homrar);
+        ct.homcom = static_cast<uint32_t>(m_sample_ct) - ct.missing - ct.het
+                    - ct.homrar;
+        ct.has_count = true;
+    }
+    return true;
 }
 
+bool Genotype::stored_row(SNP& snp, uintptr_t* row) const
+{
+    const uintptr_t row_words = 2 * BITCT_TO_WORDCT(m_sample_ct);
+    if (snp.current_genotype() != nullptr)
+    {
+        std::copy_n(snp.current_genotype(), row_words, row);
+        return true;
+    }
+    if (!snp.sparse_genotype()) return false;
+    // fill with the baseline genotype then add the carriers
+    auto&& carriers = snp.carriers();
+    const uintptr_t pattern =
+        static_cast<uintptr_t>(~carriers.baseline & 3) * (~uintptr_t(0) / 3);
+    std::fill_n(row, row_words, pattern);
+    const size_t remain = m_sample_ct % BITCT2;
+    const size_t num_word = (m_sample_ct + BITCT2 - 1) / BITCT2;
+    if (remain != 0) { row[num_word - 1] &= (ONELU << (2 * remain)) - ONELU; }
+    std::fill(row + num_word, row + row_words, 0);
+    for (auto&& carrier : carriers.samples)
+    {
+        const size_t sample = carrier >> 2;
+        const uintptr_t code = static_cast<uintptr_t>(~carrier & 3);
+        const uint32_t shift = static_cast<uint32_t>(2 * (sample % BITCT2));
+        auto&& word = row[sample / BITCT2];
+        word = (word & ~(static_cast<uintptr_t>(3) << shift)) | (code << shift);
+    }
+    return true;
+}
+
+void Genotype::read_block(GenotypeBlock& block, GenotypeCursor& cursor)
+{
+    for (size_t i = 0; i < block.size(); ++i)
+    {
+        auto&& snp = m_existed_snps[block.index[i]];
+        auto&& row = block.packed_row(i);
+        if (stored_row(snp, row)) continue;
+        read_genotype(snp, m_sample_ct, cursor, row, m_calculate_prs.data());
+    }
+}
 
 bool Genotype::get_score(std::vector<size_t>::const_iterator& start_index,
                          const std::vector<size_t>::const_iterator& end_index,
                          double& cur_threshold, uint32_t& num_snp_included,
-                         const bool first_run)
+                         const bool first_run, const bool standardize)
 {
     // if there are no SNPs or we are at the end
     if (m_existed_snps.size() == 0 || start_index == end_index
@@ -1694,17 +2697,325 @@ bool Genotype::get_score(std::vector<size_t>::const_iterator& start_index,
             ++num_snp_included;
         }
     }
-    read_score(start_index, region_end,
-               (m_prs_calculation.non_cumulate || first_run));
+    if (m_active_set_scores != nullptr && !m_active_set_scores->empty())
+    {
+        m_prs_info = std::move(m_active_set_scores->front());
+        m_active_set_scores->pop_front();
+    }
+    else
+    {
+        read_score(start_index, region_end,
+                   (m_prs_calculation.non_cumulate || first_run));
+    }
     // update the current index
     start_index = region_end;
     // if ((*start_index) == 0) return -1;
-    if (m_prs_calculation.scoring_method == SCORING::STANDARDIZE
-        || m_prs_calculation.scoring_method == SCORING::CONTROL_STD)
+    if (standardize
+        && (m_prs_calculation.scoring_method == SCORING::STANDARDIZE
+            || m_prs_calculation.scoring_method == SCORING::CONTROL_STD))
     { standardize_prs(); }
     return true;
 }
 
+void Genotype::add_partial_scores(const std::vector<size_t>& set_snp_idx,
+                                  PartialScores& partial)
+{
+    // thresholds derived from the p-value of each chromosome cannot be
+    // matched across chromosomes
+    if (m_very_small_thresholds)
+    {
+        throw std::runtime_error(
+            "Error: Cannot use --chr-stream when the p-value thresholds are "
+            "too small to be binned\n");
+    }
+    std::vector<size_t>::const_iterator start = set_snp_idx.begin();
+    double cur_threshold = 0.0;
+    uint32_t num_snp_included = 0;
+    // score each threshold from zero, standardization is done on the sum
+    while (get_score(start, set_snp_idx.cend(), cur_threshold,
+                     num_snp_included, true, false))
+    {
+        partial.add(cur_threshold, m_prs_info, num_snp_included);
+        num_snp_included = 0;
+    }
+}
+
+void Genotype::add_block_score(GenotypeBlock& block, const size_t i,
+                               PRSList& prs_list, CarrierList& carriers)
+{
+    auto&& snp = m_existed_snps[block.index[i]];
+    if (block.is_dosage)
+    {
+        add_dosage_prs(block.dosage_row(i), prs_list, snp);
+        return;
+    }
+    auto&& ct = block.counts[i];
+    if (ct.homcom + ct.het + ct.homrar == 0) return;
+    dispatch_missing_score([&](auto missing) {
+        add_hard_coded_prs<decltype(missing)::value>(
+            block.packed_row(i), prs_list, snp, ct.homcom, ct.het, ct.homrar,
+            true, carriers);
+    });
+}
+
+void Genotype::add_dosage_prs(const double* genotype, PRSList& prs_list,
+                              const SNP& snp)
+{
+    // currently hard code ploidy to 2, as in add_hard_coded_prs
+    constexpr size_t ploidy = 2;
+    const double stat = snp.stat();
+    // to match the order of the genotype probabilities, the weights of
+    // variants that are not flipped are reversed
+    std::array<double, 3> weight = {m_homcom_weight, m_het_weight,
+                                    m_homrar_weight};
+    if (!snp.is_flipped()) { std::swap(weight[0], weight[2]); }
+    misc::RunningStat dose_statistic;
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < m_sample_ct; ++i)
+    {
+        const double* geno = genotype + 3 * i;
+        if (std::isnan(geno[0]))
+        {
+            missing.push_back(i);
+            continue;
+        }
+        double sum = 0.0;
+        for (size_t g = 0; g < 3; ++g) { sum += geno[g] * weight[g]; }
+        prs_list.prs[i] += sum * stat;
+        dose_statistic.push(sum);
+    }
+    const MISSING_SCORE missing_score = m_prs_calculation.missing_score;
+    const bool centre = (missing_score == MISSING_SCORE::CENTER);
+    const bool set_zero = (missing_score == MISSING_SCORE::SET_ZERO);
+    const double adj_score = centre ? stat * dose_statistic.mean() : 0.0;
+    const double miss_score = set_zero ? 0.0 : stat * dose_statistic.mean();
+    const size_t miss_count = set_zero ? 0 : ploidy;
+    prs_list.num_snp += ploidy;
+    size_t cur_idx = 0;
+    for (size_t i = 0; i < m_sample_ct; ++i)
+    {
+        if (cur_idx < missing.size() && i == missing[cur_idx])
+        {
+            prs_list.prs[i] += miss_score;
+            prs_list.add_missing(i, ploidy - miss_count);
+            ++cur_idx;
+        }
+        else if (centre)
+        {
+            prs_list.prs[i] -= adj_score;
+        }
+    }
+}
+
+void Genotype::prepare_set_scores(
+    const std::vector<std::vector<size_t>>& region_membership,
+    const size_t set_idx, const unsigned long long max_memory)
+{
+    // scores of the previous set are all consumed
+    if (m_active_set_scores != nullptr)
+    {
+        m_set_scores.erase(m_active_set_idx);
+        m_active_set_scores = nullptr;
+    }
+    // the stored scores only hold the main genetic model, so each set is
+    // scored by get_score when multiple models are required
+    if (!m_model_weights.empty()) return;
+    auto cached = m_set_scores.find(set_idx);
+    m_active_set_idx = set_idx;
+    if (cached != m_set_scores.end())
+    {
+        m_active_set_scores = &cached->second;
+        return;
+    }
+    auto same_group = [this](const SNP& a, const SNP& b) {
+        if (m_very_small_thresholds)
+        { return misc::logically_equal(a.p_value(), b.p_value()); }
+        return a.category() == b.category();
+    };
+    // select the sets to be scored in this pass, with the background set
+    // (index 1) always skipped. Each set stores one score vector per
+    // threshold until it is consumed
+    const unsigned long long current = misc::getCurrentRSS();
+    const unsigned long long budget =
+        (max_memory > current) ? (max_memory - current) / 2 : 0;
+    const unsigned long long score_size =
+        m_sample_ct * (sizeof(double) + sizeof(size_t));
+    std::vector<size_t> batch;
+    unsigned long long used = 0;
+    for (size_t s = set_idx; s < region_membership.size(); ++s)
+    {
+        auto&& member = region_membership[s];
+        if (s == 1 || member.empty()) continue;
+        size_t num_group = 1;
+        for (size_t i = 1; i < member.size(); ++i)
+        {
+            if (!same_group(m_existed_snps[member[i - 1]],
+                            m_existed_snps[member[i]]))
+            { ++num_group; }
+        }
+        // one extra score vector for the accumulator
+        const unsigned long long required = (num_group + 1) * score_size;
+        if (!batch.empty() && used + required > budget) break;
+        batch.push_back(s);
+        used += required;
+    }
+    if (batch.empty()) return;
+    // union of the variants of all sets in this batch, in threshold order
+    std::vector<size_t> variants;
+    for (auto&& s : batch)
+    {
+        std::vector<size_t> merged;
+        merged.reserve(variants.size() + region_membership[s].size());
+        std::set_union(variants.begin(), variants.end(),
+                       region_membership[s].begin(),
+                       region_membership[s].end(), std::back_inserter(merged));
+        variants.swap(merged);
+    }
+    std::vector<std::deque<PRSList>*> output(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i)
+    { output[i] = &m_set_scores[batch[i]]; }
+    // the per-sample contribution of a tile of variants are collected into
+    // a dense matrix, which is then multiplied with the membership matrix.
+    // Each column of the membership matrix is one set within one threshold,
+    // so a tile spans as many thresholds as it can hold, and the score of a
+    // set at each threshold is the prefix sum of its columns. The effect
+    // size, centring and imputation are already applied to the
+    // contributions, so the membership matrix is 0/1
+    const auto num_sample = static_cast<Eigen::Index>(m_sample_ct);
+    const auto num_set = static_cast<Eigen::Index>(batch.size());
+    // limit each tile to around 64Mb
+    const Eigen::Index tile_width = std::max<Eigen::Index>(
+        8, std::min<Eigen::Index>(256, (1 << 22) / (num_sample + 1)));
+    // a single threshold needs at most one column per set
+    const Eigen::Index max_column = num_set + tile_width;
+    Eigen::MatrixXd score_acc = Eigen::MatrixXd::Zero(num_sample, num_set);
+    Eigen::MatrixXd tile_score(num_sample, tile_width);
+    Eigen::MatrixXd tile_product(num_sample, max_column);
+    Eigen::MatrixXd tile_member =
+        Eigen::MatrixXd::Zero(tile_width, max_column);
+    // the allele counts are shared by all samples, so they are added
+    // directly. These lists only carry the counts, without any score
+    std::vector<PRSList> count_acc(batch.size());
+    // columns added to the score of a set, and the scores to store when the
+    // threshold of a set ends, in the order they happen within the tile
+    struct TileEvent
+    {
+        size_t set;
+        // column of the set, or -1 if the score of the set is stored
+        Eigen::Index column;
+        PRSList counts;
+    };
+    std::vector<TileEvent> events;
+    // column of each set in the current threshold of the tile
+    std::vector<Eigen::Index> set_column(batch.size(), -1);
+    Eigen::Index tile_size = 0, num_column = 0, tile_nnz = 0;
+    auto flush_tile = [&]() {
+        const bool use_gemm =
+            static_cast<double>(tile_nnz)
+            >= m_gemm_min_density * static_cast<double>(tile_size * num_column);
+        if (use_gemm && tile_size != 0)
+        {
+            tile_product.leftCols(num_column).noalias() =
+                tile_score.leftCols(tile_size)
+                * tile_member.topLeftCorner(tile_size, num_column);
+        }
+        for (auto&& event : events)
+        {
+            const auto col = static_cast<Eigen::Index>(event.set);
+            if (event.column >= 0 && use_gemm)
+            { score_acc.col(col) += tile_product.col(event.column); }
+            else if (event.column >= 0)
+            {
+                // too sparse for the dense product to pay off
+                for (Eigen::Index k = 0; k < tile_size; ++k)
+                {
+                    if (tile_member(k, event.column) == 0.0) continue;
+                    score_acc.col(col) += tile_score.col(k);
+                }
+            }
+            else
+            {
+                PRSList score(m_sample_ct);
+                for (Eigen::Index j = 0; j < num_sample; ++j)
+                { score.prs[static_cast<size_t>(j)] = score_acc(j, col); }
+                score.num_snp = event.counts.num_snp;
+                score.num_miss = std::move(event.counts.num_miss);
+                output[event.set]->push_back(std::move(score));
+                if (m_prs_calculation.non_cumulate)
+                { score_acc.col(col).setZero(); }
+            }
+        }
+        tile_member.topLeftCorner(tile_size, num_column).setZero();
+        events.clear();
+        std::fill(set_column.begin(), set_column.end(), -1);
+        tile_size = 0;
+        num_column = 0;
+        tile_nnz = 0;
+    };
+    std::vector<bool> in_group(batch.size(), false);
+    PRSList contribution(m_sample_ct);
+    CarrierList carriers;
+    GenotypeBlock block;
+    auto cur = variants.cbegin();
+    size_t i_snp = 0;
+    // the variants are decoded one tile at a time
+    while (next_block(cur, variants.cend(), static_cast<size_t>(tile_width),
+                      block, m_cursor))
+    {
+        for (size_t row = 0; row < block.size(); ++row, ++i_snp)
+        {
+            auto&& flags = m_existed_snps[block.index[row]].get_flag();
+            Eigen::Index new_column = 0;
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                if (IS_SET(flags.data(), batch[i]) && set_column[i] < 0)
+                { ++new_column; }
+            }
+            if (tile_size == tile_width
+                || num_column + new_column > max_column)
+            { flush_tile(); }
+            contribution.reset();
+            add_block_score(block, row, contribution, carriers);
+            tile_score.col(tile_size) =
+                Eigen::Map<Eigen::VectorXd>(contribution.prs.data(),
+                                            num_sample)
+                    .array()
+                + contribution.base;
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                if (!IS_SET(flags.data(), batch[i])) continue;
+                in_group[i] = true;
+                count_acc[i].num_snp += contribution.num_snp;
+                count_acc[i].num_miss.add(contribution.num_miss, m_sample_ct);
+                if (set_column[i] < 0)
+                {
+                    set_column[i] = num_column++;
+                    events.push_back({i, set_column[i], PRSList()});
+                }
+                tile_member(tile_size, set_column[i]) = 1.0;
+                ++tile_nnz;
+            }
+            ++tile_size;
+            const bool group_end =
+                i_snp + 1 == variants.size()
+                || !same_group(m_existed_snps[variants[i_snp]],
+                               m_existed_snps[variants[i_snp + 1]]);
+            if (!group_end) continue;
+            // store the score of every set with variants in the threshold
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                if (!in_group[i]) continue;
+                in_group[i] = false;
+                set_column[i] = -1;
+                events.push_back({i, -1, count_acc[i]});
+                if (m_prs_calculation.non_cumulate) count_acc[i].reset();
+            }
+        }
+    }
+    flush_tile();
+    m_active_set_scores = &m_set_scores[set_idx];
+}
+
 /**
  * DON'T TOUCH AREA
  *
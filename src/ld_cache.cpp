@@ -0,0 +1,151 @@
+// This file is part of PRSice-2, copyright (C) 2016-2019
+// Shing Wan Choi, Paul F. O’Reilly
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ld_cache.hpp"
+
+namespace
+{
+const char ld_cache_magic[8] = {'P', 'R', 'S', 'L', 'D', 'C', 'H', '2'};
+template <typename T>
+void write_value(std::ofstream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+template <typename T>
+bool read_value(std::ifstream& in, T& value)
+{
+    return static_cast<bool>(
+        in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+}
+
+std::vector<uint32_t> LDCache::index_snps(const std::vector<SNP>& snps) const
+{
+    std::unordered_map<std::string, uint32_t> cache_idx;
+    cache_idx.reserve(m_snp_id.size());
+    for (size_t i = 0; i < m_snp_id.size(); ++i)
+    { cache_idx[m_snp_id[i]] = static_cast<uint32_t>(i); }
+    std::vector<uint32_t> result(snps.size(), not_cached);
+    for (size_t i = 0; i < snps.size(); ++i)
+    {
+        auto&& snp = snps[i];
+        auto res = cache_idx.find(snp.rs());
+        if (res == cache_idx.end()) continue;
+        // only trust the cache if the variant is at the same location
+        if (m_chr[res->second] != snp.chr() || m_loc[res->second] != snp.loc())
+            continue;
+        result[i] = res->second;
+    }
+    return result;
+}
+
+bool LDCache::load(const std::string& file_name, const uint64_t key,
+                   const double min_r2)
+{
+    std::ifstream in(file_name.c_str(), std::ios::binary | std::ios::ate);
+    if (!in.is_open()) return false;
+    const std::streamoff file_size = in.tellg();
+    in.seekg(0, std::ios::beg);
+    // number of bytes not yet read, used to reject counts that cannot be
+    // satisfied by the file before allocating for them
+    auto remain = [&in, file_size]() {
+        return static_cast<uint64_t>(file_size - in.tellg());
+    };
+    char magic[8];
+    uint64_t file_key, num_snp;
+    double r2_floor;
+    if (!in.read(magic, sizeof(magic))
+        || !std::equal(magic, magic + sizeof(magic), ld_cache_magic)
+        || !read_value(in, file_key) || !read_value(in, r2_floor)
+        || !read_value(in, num_snp))
+    { return false; }
+    // cache generated from a different reference / sample / window, or
+    // pairs required for the current R2 threshold were not stored
+    if (file_key != key || r2_floor > min_r2) return false;
+    // each variant needs at least its coordinate and ID length
+    const uint64_t min_snp_bytes = 2 * sizeof(uint64_t) + sizeof(uint32_t);
+    if (num_snp > remain() / min_snp_bytes || num_snp >= not_cached)
+    { throw std::runtime_error("Error: Malformed LD cache: " + file_name); }
+    clear();
+    m_key = key;
+    m_r2_floor = r2_floor;
+    m_snp_id.resize(num_snp);
+    m_chr.resize(num_snp);
+    m_loc.resize(num_snp);
+    m_partners.resize(num_snp);
+    uint32_t id_length;
+    uint64_t chr, loc;
+    for (size_t i = 0; i < num_snp; ++i)
+    {
+        if (!read_value(in, chr) || !read_value(in, loc)
+            || !read_value(in, id_length) || id_length > remain())
+        { throw std::runtime_error("Error: Malformed LD cache: " + file_name); }
+        m_chr[i] = chr;
+        m_loc[i] = loc;
+        m_snp_id[i].resize(id_length);
+        if (!in.read(&m_snp_id[i][0], id_length))
+        { throw std::runtime_error("Error: Malformed LD cache: " + file_name); }
+    }
+    const uint64_t entry_bytes = sizeof(uint32_t) + sizeof(double);
+    uint32_t num_partner;
+    for (size_t i = 0; i < num_snp; ++i)
+    {
+        if (!read_value(in, num_partner) || num_partner >= num_snp
+            || num_partner > remain() / entry_bytes)
+        { throw std::runtime_error("Error: Malformed LD cache: " + file_name); }
+        m_partners[i].resize(num_partner);
+        for (auto&& entry : m_partners[i])
+        {
+            if (!read_value(in, entry.partner) || !read_value(in, entry.r2)
+                || entry.partner >= num_snp)
+            {
+                throw std::runtime_error("Error: Malformed LD cache: "
+                                         + file_name);
+            }
+        }
+    }
+    return true;
+}
+
+void LDCache::save(const std::string& file_name) const
+{
+    std::ofstream out(file_name.c_str(), std::ios::binary);
+    if (!out.is_open())
+    { throw std::runtime_error("Error: Cannot open file: " + file_name); }
+    out.write(ld_cache_magic, sizeof(ld_cache_magic));
+    write_value(out, m_key);
+    write_value(out, m_r2_floor);
+    write_value(out, static_cast<uint64_t>(m_snp_id.size()));
+    for (size_t i = 0; i < m_snp_id.size(); ++i)
+    {
+        write_value(out, static_cast<uint64_t>(m_chr[i]));
+        write_value(out, static_cast<uint64_t>(m_loc[i]));
+        write_value(out, static_cast<uint32_t>(m_snp_id[i].size()));
+        out.write(m_snp_id[i].data(),
+                  static_cast<std::streamsize>(m_snp_id[i].size()));
+    }
+    for (auto&& partners : m_partners)
+    {
+        write_value(out, static_cast<uint32_t>(partners.size()));
+        for (auto&& entry : partners)
+        {
+            write_value(out, entry.partner);
+            write_value(out, entry.r2);
+        }
+    }
+    if (!out.good())
+    { throw std::runtime_error("Error: Cannot write LD cache: " + file_name); }
+}
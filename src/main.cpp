@@ -27,6 +27,8 @@
 #include "reporter.hpp"
 #include <cstdlib>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
@@ -68,9 +70,51 @@ int main(int argc, char* argv[])
             target_file = factory.createGenotype(commander.get_target(),
                                                  commander.get_pheno(),
                                                  commander.delim(), reporter);
-            initialize_target(exclusion_regions, commander, target_file,
-                              reporter);
-            if (commander.use_ref() && commander.need_ref())
+            // with --chr-stream, the variants of each chromosome are scored
+            // and released before the next chromosome is loaded
+            const bool chr_stream = commander.chr_stream();
+            PartialScores streamed_scores;
+            if (chr_stream)
+            {
+                stream_chromosomes(exclusion_regions, commander, factory,
+                                   target_file, streamed_scores, reporter);
+            }
+            else
+            {
+                initialize_target(exclusion_regions, commander, target_file,
+                                  reporter);
+            }
+            // with multiple base files, the target genotype contains the
+            // variants of all base files so that the reference, QC and LD
+            // are only processed once. Only the variants of each base file
+            // are kept, as a run of the target genotype
+            auto&& base_files = commander.get_base().file_names;
+            const bool multi_base = base_files.size() > 1;
+            if (multi_base)
+            {
+                // the target genotype was loaded with the first base file
+                for (size_t i_base = 0; i_base < base_files.size(); ++i_base)
+                {
+                    const std::string label =
+                        misc::remove_extension<std::string>(
+                            misc::base_name<std::string>(base_files[i_base]));
+                    if (i_base == 0)
+                    {
+                        target_file->add_run(label, *target_file);
+                        continue;
+                    }
+                    std::unique_ptr<Genotype> base_target(
+                        factory.createGenotype(commander.get_target(),
+                                               commander.get_pheno(),
+                                               commander.delim(), reporter));
+                    initialize_target(exclusion_regions, commander,
+                                      base_target.get(), reporter,
+                                      base_files[i_base]);
+                    target_file->merge_snps(*base_target);
+                    target_file->add_run(label, *base_target);
+                }
+            }
+            if (!chr_stream && commander.use_ref() && commander.need_ref())
             {
                 reference_file = factory.createGenotype(
                     commander.get_reference(), commander.get_pheno(),
@@ -79,19 +123,28 @@ int main(int argc, char* argv[])
                                      reference_file, reporter);
             }
             exclusion_regions.clear();
-            target_file->calc_freqs_and_intermediate(commander.get_target_qc(),
-                                                     commander.out(), true);
+            if (!chr_stream)
+            {
+                target_file->calc_freqs_and_intermediate(
+                    commander.get_target_qc(), commander.out(), true);
+            }
             if (reference_file != nullptr)
             {
                 reference_file->set_thresholds(commander.get_ref_qc());
                 reference_file->calc_freqs_and_intermediate(
                     commander.get_ref_qc(), commander.out(), true, target_file);
             }
-            if (target_file->num_snps() == 0)
+            if (!chr_stream && target_file->num_snps() == 0)
             {
                 reporter.report("No SNPs left for PRSice processing");
                 return -1;
             }
+            if (!commander.prepare_ref().empty())
+            {
+                target_file->prepare_reference(
+                    commander.prepare_ref(),
+                    commander.use_ref() ? *reference_file : *target_file);
+            }
             const auto [region_names, num_regions] =
                 add_gene_set_info(commander, target_file, reporter);
             auto prs_instruction = commander.get_prs_instruction();
@@ -99,49 +152,103 @@ int main(int argc, char* argv[])
             const bool no_regress = prs_instruction.no_regress;
             PRSice::pheno_check(no_regress, pheno_info, reporter);
 
-            if (!commander.get_clump_info().no_clump)
+            auto&& clump_info = commander.get_clump_info();
+            // multiple clumping parameters, each clumped result is a run
+            const bool clump_sweep = !clump_info.no_clump
+                                     && (clump_info.sweep_r2.size() > 1
+                                         || clump_info.sweep_distance.size() > 1
+                                         || clump_info.sweep_pvalue.size() > 1);
+            const unsigned long long max_memory = commander.max_memory(
+                static_cast<unsigned long long>(misc::getMemorySize() * 0.8));
+            if (multi_base)
             {
-                target_file->build_clump_windows(
-                    commander.get_clump_info().distance);
-                target_file->sort_by_p();
-                // now perform clumping
-                target_file->clumping(commander.get_clump_info(),
-                                      commander.use_ref() ? *reference_file
-                                                          : *target_file,
-                                      commander.get_prs_instruction().thread);
+                // the LD reference is only loaded when clumping
+                Genotype* ld_reference = nullptr;
+                LDCache shared_ld_cache;
+                if (!clump_info.no_clump)
+                {
+                    ld_reference =
+                        commander.use_ref() ? reference_file : target_file;
+                    ld_reference->subset_ld_samples(clump_info.ld_sample_size,
+                                                    commander.get_perm().seed);
+                    target_file->build_ld_cache(
+                        clump_info, *ld_reference,
+                        commander.get_prs_instruction().thread,
+                        shared_ld_cache, max_memory);
+                }
+                for (size_t i_base = 0; i_base < target_file->num_runs();
+                     ++i_base)
+                {
+                    // each base is processed with a genotype that only holds
+                    // its variants
+                    std::unique_ptr<Genotype> base_target(
+                        factory.createGenotype(commander.get_target(),
+                                               commander.get_pheno(),
+                                               commander.delim(), reporter));
+                    configure_genotype(commander, base_target.get());
+                    target_file->swap_run(i_base, *base_target);
+                    base_target->sync_snps(*target_file);
+                    add_gene_set_info(commander, base_target.get(), reporter);
+                    if (ld_reference != nullptr)
+                    {
+                        base_target->build_clump_windows(clump_info.distance);
+                        base_target->sort_by_p();
+                        base_target->clumping(
+                            clump_info, *ld_reference,
+                            commander.get_prs_instruction().thread, max_memory,
+                            &shared_ld_cache);
+                    }
+                    target_file->swap_run(i_base, *base_target);
+                }
+                if (ld_reference != nullptr)
+                { ld_reference->restore_ld_samples(); }
             }
-            // immediately free the memory
-            if (reference_file != nullptr) { delete reference_file; }
-            if (commander.ultra_aggressive())
-            { target_file->load_genotype_to_memory(); }
-            target_file->prepare_prsice();
-            // from now on, we are not allow to sort the m_existed_snps
-            auto snp_file = commander.print_snp()
-                                ? misc::load_ostream(commander.out() + ".snp")
-                                : nullptr;
-            // vector containing the index for each SNP in each set
-            // structure is [vec of Set][vec of SNP]
-            auto region_membership = target_file->build_membership_matrix(
-                num_regions, region_names, commander.print_snp(),
-                *snp_file.get());
-            // we can now quickly check if any of the region are empty
-            try
+            else if (clump_sweep)
             {
-                print_empty_region(commander.out(), region_membership,
-                                   region_names);
+                auto&& ld_reference =
+                    commander.use_ref() ? *reference_file : *target_file;
+                ld_reference.subset_ld_samples(clump_info.ld_sample_size,
+                                               commander.get_perm().seed);
+                target_file->clump_sweep(clump_info, ld_reference,
+                                         commander.get_prs_instruction().thread,
+                                         max_memory);
+                ld_reference.restore_ld_samples();
             }
-            catch (const std::runtime_error& er)
+            else if (!clump_info.no_clump && !chr_stream)
             {
-                reporter.report(er.what());
-                return -1;
+                auto&& ld_reference =
+                    commander.use_ref() ? *reference_file : *target_file;
+                ld_reference.subset_ld_samples(clump_info.ld_sample_size,
+                                               commander.get_perm().seed);
+                const uint64_t clump_key =
+                    clump_info.clump_cache.empty()
+                        ? 0
+                        : target_file->clump_cache_key(clump_info,
+                                                       ld_reference);
+                if (clump_info.clump_cache.empty()
+                    || !target_file->load_clump_cache(clump_info.clump_cache,
+                                                      clump_key))
+                {
+                    target_file->build_clump_windows(clump_info.distance);
+                    target_file->sort_by_p();
+                    // now perform clumping
+                    target_file->clumping(
+                        clump_info, ld_reference,
+                        commander.get_prs_instruction().thread, max_memory);
+                    if (!clump_info.clump_cache.empty())
+                    {
+                        target_file->save_clump_cache(clump_info.clump_cache,
+                                                      clump_key);
+                    }
+                }
+                ld_reference.restore_ld_samples();
             }
-            // Initialize the progress bar
-            // one progress bar per phenotype
-            // one extra progress bar for competitive permutation
-            assert(target_file->get_set_thresholds().size() == num_regions);
-
+            // immediately free the memory
+            if (reference_file != nullptr) { delete reference_file; }
             const auto [max_fid, max_iid] = target_file->get_max_id_length();
             const size_t num_pheno = pheno_info.pheno_col_idx.size();
+            const std::vector<std::string> model_names =
+                get_model_names(commander.get_prs_instruction());
             // prsice and summary file will be per run
             // all score and best file will be per phenotype
             // this is mainly because of the size of the file and the way we
@@ -151,101 +258,247 @@ int main(int argc, char* argv[])
             // but for all and best, we are doing column-wise output, which need
             // expensive seek operations
             std::unique_ptr<std::ostream> summary_file = nullptr;
-            auto prefix = commander.out();
-            auto prsice_out = misc::load_ostream(prefix + ".prsice");
+            auto prsice_out = misc::load_ostream(commander.out() + ".prsice");
             const bool has_prevalence = !pheno_info.prevalence.empty();
             print_prsice_header(has_prevalence, no_regress, prsice_out);
             auto perm_info = commander.get_perm();
             if (!no_regress)
             {
-                summary_file = misc::load_ostream(prefix + ".summary");
+                summary_file =
+                    misc::load_ostream(commander.out() + ".summary");
                 print_summary_header(has_prevalence, perm_info.run_set_perm,
                                      perm_info.run_perm, summary_file);
             }
-            size_t i_prevalence = 0;
             std::vector<size_t> significant_count = {0, 0, 0};
-            for (size_t i_pheno = 0; i_pheno < num_pheno; ++i_pheno)
+            const size_t num_runs =
+                (clump_sweep || multi_base) ? target_file->num_runs() : 1;
+            for (size_t i_run = 0; i_run < num_runs; ++i_run)
             {
-                if (pheno_info.skip_pheno[i_pheno])
+                auto prefix = commander.out();
+                std::vector<std::string> run_region_names = region_names;
+                size_t i_prevalence = 0;
+                if (clump_sweep || multi_base)
                 {
-                    reporter.report("Skipping the "
-                                    + std::to_string(i_pheno + 1)
-                                    + " th phenotype");
-                    continue;
+                    // label the sets and output of each clumping combination
+                    // or base file
+                    const std::string label = target_file->select_run(i_run);
+                    reporter.report("Processing result of " + label);
+                    prefix.append("." + label);
+                    for (auto&& name : run_region_names)
+                    { name.append("_" + label); }
                 }
-                if (!no_regress)
+                // with --chr-stream, the variants were scored and released
+                // with their chromosome
+                if (!chr_stream)
                 {
-                    reporter.report("Processing the "
-                                    + std::to_string(i_pheno + 1)
-                                    + " th phenotype");
+                    if (commander.ultra_aggressive())
+                    { target_file->load_genotype_to_memory(); }
+                    target_file->prepare_prsice();
                 }
-                else
+                // from now on, we are not allow to sort the m_existed_snps
+                auto snp_file = commander.print_snp()
+                                    ? misc::load_ostream(prefix + ".snp")
+                                    : nullptr;
+                // vector containing the index for each SNP in each set
+                // structure is [vec of Set][vec of SNP]
+                std::vector<std::vector<size_t>> region_membership(
+                    num_regions);
+                if (chr_stream)
                 {
-                    reporter.report("Start calculating the scores\n");
+                    // the variants were released after they were scored,
+                    // only mark the base set as non-empty
+                    region_membership[0].push_back(0);
                 }
-                const std::string pheno_name =
-                    (num_pheno > 1) ? pheno_info.pheno_col[i_pheno] : "-";
-                const std::string file_suffix =
-                    (num_pheno > 1) ? "." + pheno_name : "";
-                PRSice prsice(commander.get_prs_instruction(),
-                              commander.get_p_threshold(), perm_info, prefix,
-                              pheno_info.binary[i_pheno], &reporter);
-                const double prevalence =
-                    (i_prevalence < pheno_info.prevalence.size())
-                        ? pheno_info.prevalence[i_prevalence]
-                        : 2;
-                if (pheno_info.binary[i_pheno]) ++i_prevalence;
-                prsice.init_progress_count(target_file->get_set_thresholds());
-                prsice.init_matrix(pheno_info, commander.delim(), i_pheno,
-                                   *target_file);
-                std::unique_ptr<std::ostream> best_file = nullptr,
-                                              all_score_file = nullptr;
-                if (!no_regress)
+                else
                 {
-
-                    best_file =
-                        misc::load_ostream(prefix + file_suffix + ".best");
-                    prsice.prep_best_output(*target_file, region_membership,
-                                            region_names, max_fid, max_iid,
-                                            best_file);
+                    region_membership = target_file->build_membership_matrix(
+                        num_regions, run_region_names, commander.print_snp(),
+                        *snp_file.get());
                 }
-                if (commander.all_scores())
+                // we can now quickly check if any of the region are empty
+                try
                 {
-                    all_score_file =
-                        misc::load_ostream(prefix + file_suffix + ".all_score");
-                    prsice.prep_all_score_output(
-                        *target_file, region_membership, region_names, max_fid,
-                        max_iid, all_score_file);
+                    print_empty_region(prefix, region_membership,
+                                       run_region_names);
                 }
-                // go through each region
-                fprintf(stderr, "\nStart Processing\n");
-                for (size_t i_region = 0; i_region < num_regions; ++i_region)
+                catch (const std::runtime_error& er)
                 {
-                    // always skip background region and empty regions
-                    if (i_region == 1 || region_membership[i_region].empty())
-                        continue;
-                    prsice.run_prsice(region_membership[i_region], region_names,
-                                      pheno_name, prevalence, i_pheno, i_region,
-                                      commander.all_scores(), has_prevalence,
-                                      prsice_out, best_file, all_score_file,
-                                      *target_file);
+                    reporter.report(er.what());
+                    return -1;
                 }
-                prsice.print_progress(true);
-                if (!no_regress)
+                // Initialize the progress bar
+                // one progress bar per phenotype
+                // one extra progress bar for competitive permutation
+                assert(target_file->get_set_thresholds().size()
+                       == num_regions);
+
+                size_t i_pheno = 0;
+                while (i_pheno < num_pheno)
                 {
-                    // best file is nullptr after this
-                    prsice.print_best(region_membership, std::move(best_file),
-                                      *target_file);
-                    if (perm_info.run_set_perm && region_names.size() > 2)
+                    // with --score-once, all phenotypes are processed together
+                    // so that the PRS of each threshold is only calculated
+                    // once. Otherwise, process one phenotype at a time
+                    std::vector<PhenoRun> runs;
+                    for (; i_pheno < num_pheno
+                           && (runs.empty() || commander.score_once());
+                         ++i_pheno)
+                    {
+                        if (pheno_info.skip_pheno[i_pheno])
+                        {
+                            reporter.report("Skipping the "
+                                            + std::to_string(i_pheno + 1)
+                                            + " th phenotype");
+                            continue;
+                        }
+                        if (!no_regress)
+                        {
+                            reporter.report("Processing the "
+                                            + std::to_string(i_pheno + 1)
+                                            + " th phenotype");
+                        }
+                        else
+                        {
+                            reporter.report("Start calculating the scores\n");
+                        }
+                        const double prevalence =
+                            (i_prevalence < pheno_info.prevalence.size())
+                                ? pheno_info.prevalence[i_prevalence]
+                                : 2;
+                        if (pheno_info.binary[i_pheno]) ++i_prevalence;
+                        // all genetic models of the phenotype share the
+                        // genotype read of each threshold
+                        for (size_t i_model = 0; i_model < model_names.size();
+                             ++i_model)
+                        {
+                            PhenoRun run;
+                            run.idx = i_pheno;
+                            run.model = i_model;
+                            run.prevalence = prevalence;
+                            run.name = (num_pheno > 1)
+                                           ? pheno_info.pheno_col[i_pheno]
+                                           : "-";
+                            // label the sets and output of each model
+                            std::string run_prefix = prefix;
+                            run.region_names = run_region_names;
+                            if (model_names.size() > 1)
+                            {
+                                const auto& label = model_names[i_model];
+                                run_prefix.append("." + label);
+                                for (auto&& name : run.region_names)
+                                { name.append("_" + label); }
+                            }
+                            const std::string file_prefix =
+                                run_prefix
+                                + ((num_pheno > 1) ? "." + run.name : "");
+                            run.prsice = std::make_unique<PRSice>(
+                                commander.get_prs_instruction(),
+                                commander.get_p_threshold(), perm_info,
+                                run_prefix, pheno_info.binary[i_pheno],
+                                &reporter);
+                            auto&& prsice = *run.prsice;
+                            prsice.init_progress_count(
+                                target_file->get_set_thresholds());
+                            prsice.init_matrix(pheno_info, commander.delim(),
+                                               i_pheno, *target_file);
+                            if (!no_regress)
+                            {
+                                run.best_file =
+                                    misc::load_ostream(file_prefix + ".best");
+                                prsice.prep_best_output(
+                                    *target_file, region_membership,
+                                    run.region_names, max_fid, max_iid,
+                                    run.best_file);
+                            }
+                            if (commander.all_scores())
+                            {
+                                run.all_score_file = misc::load_ostream(
+                                    file_prefix + ".all_score");
+                                prsice.prep_all_score_output(
+                                    *target_file, region_membership,
+                                    run.region_names, max_fid, max_iid,
+                                    run.all_score_file);
+                            }
+                            // only report the progress of the first run
+                            if (!runs.empty()) prsice.hide_progress();
+                            runs.push_back(std::move(run));
+                        }
+                    }
+                    if (runs.empty()) continue;
+                    // a single run writes to the .prsice file directly, runs
+                    // sharing the thresholds are buffered to keep their order
+                    const bool buffer_output = runs.size() > 1;
+                    if (!buffer_output)
+                    { runs.front().prsice_out = std::move(prsice_out); }
+                    else
+                    {
+                        for (auto&& run : runs)
+                        {
+                            run.prsice_out =
+                                std::make_unique<std::stringstream>();
+                        }
+                    }
+                    // go through each region
+                    fprintf(stderr, "\nStart Processing\n");
+                    for (size_t i_region = 0; i_region < num_regions;
+                         ++i_region)
+                    {
+                        // always skip background region and empty regions
+                        if (i_region == 1
+                            || region_membership[i_region].empty())
+                            continue;
+                        if (chr_stream)
+                        {
+                            PRSice::run_prsice(
+                                streamed_scores, commander.all_scores(),
+                                has_prevalence, runs, *target_file);
+                            continue;
+                        }
+                        // score the sets together so that variants shared
+                        // by multiple sets are only decoded once
+                        if (num_regions > 2)
+                        {
+                            target_file->prepare_set_scores(
+                                region_membership, i_region, max_memory);
+                        }
+                        PRSice::run_prsice(region_membership[i_region],
+                                           i_region, commander.all_scores(),
+                                           has_prevalence, runs, *target_file);
+                    }
+                    target_file->clear_set_scores();
+                    if (!buffer_output)
+                    { prsice_out = std::move(runs.front().prsice_out); }
+                    for (auto&& run : runs)
                     {
-                        assert(region_membership.size() >= 2);
-                        prsice.run_competitive(*target_file,
-                                               region_membership[1].begin(),
-                                               region_membership[1].end());
+                        auto&& prsice = *run.prsice;
+                        target_file->select_model(run.model);
+                        prsice.print_progress(true);
+                        if (buffer_output)
+                        {
+                            (*prsice_out) << static_cast<std::stringstream&>(
+                                                 *run.prsice_out)
+                                                 .str();
+                        }
+                        if (!no_regress)
+                        {
+                            // best file is nullptr after this
+                            prsice.print_best(region_membership,
+                                              std::move(run.best_file),
+                                              *target_file);
+                            if (perm_info.run_set_perm
+                                && run_region_names.size() > 2)
+                            {
+                                assert(region_membership.size() >= 2);
+                                prsice.run_competitive(
+                                    *target_file, region_membership[1].begin(),
+                                    region_membership[1].end());
+                            }
+                        }
+                        prsice.print_summary(run.name, run.prevalence,
+                                             has_prevalence, significant_count,
+                                             summary_file);
                     }
+                    target_file->select_model(0);
                 }
-                prsice.print_summary(pheno_name, prevalence, has_prevalence,
-                                     significant_count, summary_file);
             }
             if (!no_regress)
                 reporter.report(print_project_summary(significant_count));
@@ -0,0 +1,133 @@
+// This file is part of PRSice-2, copyright (C) 2016-2019
+// Shing Wan Choi, Paul F. O’Reilly
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "partial_scores.hpp"
+
+namespace
+{
+template <typename T>
+void write_value(std::fstream& out, const T& value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+template <typename T>
+void write_vector(std::fstream& out, const std::vector<T>& values)
+{
+    write_value(out, static_cast<uint64_t>(values.size()));
+    out.write(reinterpret_cast<const char*>(values.data()),
+              static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+template <typename T>
+void read_value(std::fstream& in, T& value)
+{
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+template <typename T>
+void read_vector(std::fstream& in, std::vector<T>& values)
+{
+    uint64_t size = 0;
+    read_value(in, size);
+    values.resize(size);
+    in.read(reinterpret_cast<char*>(values.data()),
+            static_cast<std::streamsize>(size * sizeof(T)));
+}
+}
+
+void PartialScores::open(const std::string& file_name)
+{
+    close();
+    m_file_name = file_name;
+    m_file.open(file_name.c_str(), std::ios::in | std::ios::out
+                                       | std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open())
+    { throw std::runtime_error("Error: Cannot open file: " + file_name); }
+}
+
+void PartialScores::close()
+{
+    m_thresholds.clear();
+    m_num_sample = 0;
+    if (!m_file.is_open()) return;
+    m_file.close();
+    std::remove(m_file_name.c_str());
+}
+
+void PartialScores::add(const double threshold, const PRSList& scores,
+                        const uint32_t num_snp)
+{
+    if (!m_file.is_open())
+    {
+        throw std::runtime_error(
+            "Error: Partial score file not opened. This should not happen. "
+            "Please report this error\n");
+    }
+    if (m_thresholds.empty()) m_num_sample = scores.size();
+    if (scores.size() != m_num_sample)
+    {
+        throw std::runtime_error(
+            "Error: Number of samples differ between chromosomes\n");
+    }
+    m_file.seekp(0, std::ios::end);
+    m_thresholds[threshold].push_back(m_file.tellp());
+    write_value(m_file, num_snp);
+    write_vector(m_file, scores.prs);
+    write_value(m_file, scores.base);
+    write_value(m_file, static_cast<uint64_t>(scores.model_prs.size()));
+    for (auto&& model : scores.model_prs) write_vector(m_file, model);
+    write_vector(m_file, scores.model_base);
+    write_value(m_file, static_cast<uint64_t>(scores.num_snp));
+    write_vector(m_file, scores.num_miss.sparse);
+    write_vector(m_file, scores.num_miss.dense);
+    if (!m_file.good())
+    {
+        throw std::runtime_error("Error: Cannot write partial scores to "
+                                 + m_file_name);
+    }
+}
+
+uint32_t PartialScores::add_to(const double threshold, PRSList& scores)
+{
+    auto&& location = m_thresholds.find(threshold);
+    if (location == m_thresholds.end()) return 0;
+    uint32_t total_snp = 0;
+    for (auto&& pos : location->second)
+    {
+        m_file.seekg(pos);
+        uint32_t num_snp = 0;
+        read_value(m_file, num_snp);
+        read_vector(m_file, m_buffer.prs);
+        read_value(m_file, m_buffer.base);
+        uint64_t num_model = 0;
+        read_value(m_file, num_model);
+        m_buffer.model_prs.resize(num_model);
+        for (auto&& model : m_buffer.model_prs) read_vector(m_file, model);
+        read_vector(m_file, m_buffer.model_base);
+        uint64_t num_allele = 0;
+        read_value(m_file, num_allele);
+        m_buffer.num_snp = num_allele;
+        read_vector(m_file, m_buffer.num_miss.sparse);
+        read_vector(m_file, m_buffer.num_miss.dense);
+        if (!m_file.good() || m_buffer.size() != scores.size()
+            || m_buffer.model_prs.size() != scores.model_prs.size())
+        {
+            throw std::runtime_error("Error: Cannot read partial scores from "
+                                     + m_file_name);
+        }
+        scores.add(m_buffer);
+        total_snp += num_snp;
+    }
+    return total_snp;
+}
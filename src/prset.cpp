@@ -16,107 +16,6 @@
 
 #include "prsice.hpp"
 
-void PRSice::produce_null_prs(
-    Thread_Queue<std::pair<std::vector<double>, size_t>>& q, Genotype& target,
-    std::vector<size_t> background, size_t num_consumer,
-    std::map<size_t, std::vector<size_t>>& set_index)
-{
-    // we need to know the size of the biggest set
-    const size_t max_size = set_index.rbegin()->first;
-    const size_t num_sample = m_matrix_index.size();
-    const size_t num_regress_sample =
-        static_cast<size_t>(m_independent_variables.rows());
-    size_t processed = 0;
-    size_t prev_size = 0;
-    // we seed the random number generator
-    std::mt19937 g(m_perm_info.seed);
-    bool first_run = true;
-    while (processed < m_perm_info.num_permutation)
-    {
-        // sample without replacement
-        fisher_yates(background, g, max_size);
-        first_run = true;
-        prev_size = 0;
-        for (auto&& set_size : set_index)
-        {
-            // for each gene sets size, we calculate the PRS
-            target.get_null_score(set_size.first, prev_size, background,
-                                  first_run);
-            first_run = false;
-            // we need to know how many SNPs we have already read, such that
-            // we can skip reading this number of SNPs for the next set
-            prev_size = set_size.first;
-            // we store the PRS in a new vector to avoid crazy error with
-            // move semetics and stuff which I have not fully understand
-            std::vector<double> prs(num_regress_sample, 0);
-            for (size_t sample_id = 0; sample_id < num_sample; ++sample_id)
-            {
-                // propagate the prs vector
-                prs[sample_id] =
-                    target.calculate_score(m_matrix_index[sample_id]);
-            }
-            // then we push the result prs to the queue, which can then
-            // picked up by the consumers
-            q.emplace(std::make_pair(prs, set_size.first), num_consumer);
-            ++m_total_competitive_perm_done;
-            print_competitive_progress();
-        }
-        ++processed;
-    }
-    // send termination signal to the consumers
-    q.completed();
-}
-
-
-void PRSice::consume_prs(
-    Thread_Queue<std::pair<std::vector<double>, size_t>>& q,
-    const Regress& decomposed, std::map<size_t, std::vector<size_t>>& set_index,
-    const std::vector<double>& obs_t_value, std::vector<size_t>& set_perm_res)
-{
-    const Eigen::Index num_regress_sample =
-        static_cast<Eigen::Index>(m_matrix_index.size());
-    Eigen::MatrixXd independent;
-    Eigen::VectorXd prs, beta, effects;
-    if (m_perm_info.logit_perm && m_binary_trait)
-        independent = m_independent_variables;
-    // to avoid false sharing and frequent lock, we wil first store all
-    // permutation results within a temporary vector
-    double coefficient, standard_error, r2;
-    double obs_p = 2.0; // for safety reason, make sure it is out bound
-    // results from queue will be stored in the prs_info
-    std::pair<std::vector<double>, size_t> prs_info;
-    std::vector<size_t> local_set_perm_res(set_perm_res.size(), 0);
-    // now listen for producer
-    while (!q.pop(prs_info))
-    {
-        // update the independent variable matrix with the new PRS
-
-        if (m_binary_trait && m_perm_info.logit_perm)
-        {
-            independent.col(1) = Eigen::Map<Eigen::VectorXd>(
-                std::get<0>(prs_info).data(), num_regress_sample);
-            Regression::glm(m_phenotype, independent, obs_p, r2, coefficient,
-                            standard_error, 1);
-        }
-        else
-        {
-            prs = Eigen::Map<Eigen::VectorXd>(std::get<0>(prs_info).data(),
-                                              num_regress_sample);
-            std::tie(coefficient, standard_error) =
-                get_coeff_se(decomposed, decomposed.YCov, prs, beta, effects);
-        }
-        double t_value = std::fabs(coefficient / standard_error);
-        auto&& index = set_index[std::get<1>(prs_info)];
-        for (auto&& ref : index)
-        {
-            if (obs_t_value[ref] < t_value) ++local_set_perm_res[ref];
-        }
-    }
-    std::lock_guard<std::mutex> lock(lock_guard);
-    for (size_t i = 0; i < set_perm_res.size(); ++i)
-    { set_perm_res[i] += local_set_perm_res[i]; }
-}
-
 void PRSice::observe_set_perm(Thread_Queue<size_t>& progress_observer,
                               size_t num_thread)
 {
@@ -132,19 +31,22 @@ void PRSice::observe_set_perm(Thread_Queue<size_t>& progress_observer,
 // Shuffle the idx vector
 // By selecting the first n element from idx, we've got the random selection
 // without replacement
-void PRSice::fisher_yates(std::vector<size_t>& idx, std::mt19937& g, size_t n)
+void PRSice::fisher_yates(std::vector<size_t>& idx, std::mt19937& g, size_t n,
+                          std::vector<size_t>& swapped)
 {
     size_t begin = 0;
     // we will shuffle n where n is the set with the largest size
     // this is the Fisher-Yates shuffle algorithm for random selection
-    // without replacement
+    // without replacement. The swaps are recorded so that they can be undone
     size_t num_idx = idx.size() - 1;
     size_t advance_index;
+    swapped.clear();
     while (n--)
     {
         std::uniform_int_distribution<size_t> dist(begin, num_idx);
         advance_index = dist(g);
         std::swap<size_t>(idx[begin], idx[advance_index]);
+        swapped.push_back(advance_index);
         ++begin;
     }
 }
@@ -156,6 +58,7 @@ void PRSice::subject_set_perm(T& progress_observer, Genotype& target,
                               std::vector<size_t>& set_perm_res,
                               const std::vector<double>& obs_t_value,
                               const std::random_device::result_type seed,
+                              const size_t first_perm,
                               const Regress& decomposed, const size_t num_perm)
 {
     assert(set_index.size() != 0);
@@ -168,22 +71,32 @@ void PRSice::subject_set_perm(T& progress_observer, Genotype& target,
     Eigen::MatrixXd independent;
     if (m_perm_info.logit_perm && m_binary_trait)
     { independent = m_independent_variables; }
-    // each thread should have their own cur_prs to ensure thread safety
-    std::vector<PRS> cur_prs(target.num_sample());
+    // each thread should have their own cur_prs and cursor to ensure thread
+    // safety
+    PRSList cur_prs = target.new_prs_list();
+    GenotypeCursor cursor = target.new_cursor();
     bool first_run = true;
-    std::mt19937 g(seed);
+    std::vector<size_t> swapped, selected;
     size_t processed = 0;
     std::vector<size_t> local_set_perm_res(set_perm_res.size(), 0);
     while (processed < num_perm)
     {
-        fisher_yates(background, g, max_size);
+        // each permutation has its own seed and starts from the same
+        // background order, so the result does not depend on how the
+        // permutations are split between the threads
+        std::mt19937 g(static_cast<std::mt19937::result_type>(
+            seed + first_perm + processed));
+        fisher_yates(background, g, max_size, swapped);
+        // get_null_score sorts the selected variants
+        selected.assign(background.begin(),
+                        background.begin() + static_cast<long>(max_size));
         //  we have now selected N SNPs from the background. We can then
         //  construct the PRS based on these index
         first_run = true;
         size_t prev_size = 0;
         for (auto&& set_size : set_index)
         {
-            target.get_null_score(cur_prs, set_size.first, prev_size,
+            target.get_null_score(cur_prs, cursor, set_size.first, prev_size,
                                   background, first_run);
             first_run = false;
             prev_size = set_size.first;
@@ -220,6 +133,9 @@ void PRSice::subject_set_perm(T& progress_observer, Genotype& target,
                     ++local_set_perm_res[set_index];
             }
         }
+        std::copy(selected.begin(), selected.end(), background.begin());
+        for (size_t i = swapped.size(); i-- > 0;)
+        { std::swap<size_t>(background[i], background[swapped[i]]); }
         ++processed;
     }
     progress_observer.completed();
@@ -359,59 +275,31 @@ void PRSice::run_competitive(
         set_index.size() * m_perm_info.num_permutation;
     if (num_thread > 1)
     {
-        if (!target.genotyped_stored())
+        // each thread reads the genotype with its own cursor, so we can let
+        // all the threads run subset of the permutation
+        Thread_Queue<size_t> progress_observer;
+        std::thread observer(&PRSice::observe_set_perm, this,
+                             std::ref(progress_observer), num_thread);
+        std::vector<std::thread> subjects;
+        size_t job_per_thread =
+            m_perm_info.num_permutation / static_cast<size_t>(num_thread);
+        int remain = static_cast<int>(
+            static_cast<size_t>(m_perm_info.num_permutation)
+            % static_cast<size_t>(num_thread));
+        for (int i_thread = 0; i_thread < num_thread; ++i_thread)
         {
-            ran_perm = m_perm_info.num_permutation;
-            Thread_Queue<std::pair<std::vector<double>, size_t>> set_perm_queue;
-            std::thread producer(&PRSice::produce_null_prs, this,
-                                 std::ref(set_perm_queue), std::ref(target),
-                                 std::vector<size_t>(bk_start_idx, bk_end_idx),
-                                 num_thread - 1, std::ref(set_index));
-            std::vector<std::thread> consumer_store;
-            for (int i_thread = 0; i_thread < num_thread - 1; ++i_thread)
-            {
-                consumer_store.push_back(std::thread(
-                    &PRSice::consume_prs, this, std::ref(set_perm_queue),
-                    std::cref(decomposed), std::ref(set_index),
-                    std::cref(obs_t_value), std::ref(set_perm_res)));
-            }
-
-            producer.join();
-            for (auto&& thread : consumer_store) thread.join();
-        }
-        else
-        {
-            // we don't need gatherer function, we can just let all the threads
-            // run subset of the permutation. This should be much faster
-            Thread_Queue<size_t> progress_observer;
-            std::thread observer(&PRSice::observe_set_perm, this,
-                                 std::ref(progress_observer), num_thread);
-            std::vector<std::thread> subjects;
-            std::mt19937 rand_gen {m_perm_info.seed};
-            std::uniform_int_distribution<unsigned int> dis(
-                std::numeric_limits<unsigned int>::min(),
-                std::numeric_limits<unsigned int>::max());
-            size_t job_per_thread =
-                m_perm_info.num_permutation / static_cast<size_t>(num_thread);
-            int remain = static_cast<int>(
-                static_cast<size_t>(m_perm_info.num_permutation)
-                % static_cast<size_t>(num_thread));
-            for (int i_thread = 0; i_thread < num_thread; ++i_thread)
-            {
-                auto seed = dis(rand_gen);
-                subjects.push_back(std::thread(
-                    &PRSice::subject_set_perm<Thread_Queue<size_t>>, this,
-                    std::ref(progress_observer), std::ref(target),
-                    std::vector<size_t>(bk_start_idx, bk_end_idx),
-                    std::ref(set_index), std::ref(set_perm_res),
-                    std::cref(obs_t_value), seed, std::cref(decomposed),
-                    job_per_thread + (remain > 0)));
-                ran_perm += job_per_thread + (remain > 0);
-                remain--;
-            }
-            observer.join();
-            for (auto&& thread : subjects) thread.join();
+            subjects.push_back(std::thread(
+                &PRSice::subject_set_perm<Thread_Queue<size_t>>, this,
+                std::ref(progress_observer), std::ref(target),
+                std::vector<size_t>(bk_start_idx, bk_end_idx),
+                std::ref(set_index), std::ref(set_perm_res),
+                std::cref(obs_t_value), m_perm_info.seed, ran_perm,
+                std::cref(decomposed), job_per_thread + (remain > 0)));
+            ran_perm += job_per_thread + (remain > 0);
+            remain--;
         }
+        observer.join();
+        for (auto&& thread : subjects) thread.join();
     }
     else
     {
@@ -419,7 +307,7 @@ void PRSice::run_competitive(
         subject_set_perm(dummy, target,
                          std::vector<size_t>(bk_start_idx, bk_end_idx),
                          set_index, set_perm_res, obs_t_value, m_perm_info.seed,
-                         decomposed, m_perm_info.num_permutation);
+                         0, decomposed, m_perm_info.num_permutation);
         ran_perm = m_perm_info.num_permutation;
     }
     // start_index is the index of m_prs_summary[i], not the actual index
@@ -178,6 +178,12 @@ void PRSice::init_matrix(const Phenotype& pheno_info, const std::string& delim,
         set_std_exclusion_flag(delim, ignore_fid, target);
     m_matrix_index = get_matrix_idx(delim, ignore_fid, target);
     if (no_regress) return;
+    // only the score column changes between thresholds
+    if (!m_binary_trait)
+    {
+        m_cov_projection = Regression::CovariateProjection(
+            m_phenotype, m_independent_variables, 1);
+    }
     double null_r2_adjust = 0.0;
     bool has_covariate = m_independent_variables.cols() > 2;
     if (has_covariate)
@@ -872,6 +878,7 @@ void PRSice::reset_result_containers(const Genotype& target,
     // is then used for calculation of empirical p value
     m_perm_result.resize(m_perm_info.num_permutation, 0);
     m_prs_results.resize(target.num_threshold(region_idx), prsice_result());
+    m_block.fitted.clear();
     std::fill(m_best_sample_score.begin(), m_best_sample_score.end(), 0);
 }
 
@@ -909,16 +916,10 @@ void PRSice::run_prsice(const std::vector<size_t>& set_snp_idx,
                         Genotype& target)
 {
     const bool print_all_scores = all_scores && pheno_idx == 0;
-    const bool no_regress = m_prs_info.no_regress;
-    const auto num_thread = m_prs_info.thread;
-    const size_t num_sample = target.num_sample();
     if (set_snp_idx.empty()) return;
-    Eigen::initParallel();
-    Eigen::setNbThreads(m_prs_info.thread);
-    reset_result_containers(target, region_idx);
+    start_region(target, region_idx);
     size_t prs_result_idx = 0;
     double cur_threshold = 0.0;
-    print_progress();
     bool first_run = true;
     std::vector<size_t>::const_iterator start = set_snp_idx.begin();
     double top = 1, bot = 0;
@@ -927,28 +928,328 @@ void PRSice::run_prsice(const std::vector<size_t>& set_snp_idx,
     while (target.get_score(start, set_snp_idx.cend(), cur_threshold,
                             m_num_snp_included, first_run))
     {
-        ++m_analysis_done;
-        print_progress();
-        if (print_all_scores && pheno_idx == 0)
-        { print_all_score(num_sample, all_score_file, target); }
-        if (!no_regress)
+        process_threshold(cur_threshold, prs_result_idx, pheno_name,
+                          region_names[region_idx], top, bot,
+                          print_all_scores, has_prevalence, prsice_out,
+                          all_score_file, target);
+        ++prs_result_idx;
+        first_run = false;
+    }
+    finish_region(region_names, region_idx, best_score_file, target);
+}
+
+void PRSice::run_prsice(const std::vector<size_t>& set_snp_idx,
+                        const size_t region_idx, const bool all_scores,
+                        const bool has_prevalence, std::vector<PhenoRun>& runs,
+                        Genotype& target)
+{
+    if (set_snp_idx.empty() || runs.empty()) return;
+    std::vector<double> top(runs.size(), 1), bot(runs.size(), 0);
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        runs[i].prsice->start_region(target, region_idx);
+        if (runs[i].prevalence <= 1.0)
         {
-            regress_score(target, cur_threshold, num_thread, prs_result_idx);
-            print_prsice_output(m_prs_results[prs_result_idx], pheno_name,
-                                region_names[region_idx], cur_threshold, top,
-                                bot, has_prevalence, prsice_out);
-            if (m_perm_info.run_perm) { permutation(num_thread); }
+            std::tie(top[i], bot[i]) =
+                runs[i].prsice->lee_adjustment_factor(runs[i].prevalence);
         }
-        else
+    }
+    size_t prs_result_idx = 0;
+    // the score only depends on the threshold, so we read the genotype once
+    // and regress the score of each model against each phenotype
+    auto regress_threshold = [&](const double cur_threshold,
+                                 const uint32_t num_snp_included) {
+        for (size_t i = 0; i < runs.size(); ++i)
         {
-            (*prsice_out) << pheno_name << "\t" << region_names[region_idx]
-                          << "\t" << cur_threshold << "\t" << m_num_snp_included
-                          << "\n";
+            auto&& run = runs[i];
+            target.select_model(run.model);
+            run.prsice->m_num_snp_included = num_snp_included;
+            run.prsice->process_threshold(
+                cur_threshold, prs_result_idx, run.name,
+                run.region_names[region_idx], top[i], bot[i],
+                all_scores && run.idx == 0, has_prevalence, run.prsice_out,
+                run.all_score_file, target);
         }
         ++prs_result_idx;
-        first_run = false;
+    };
+    // with --regress-block, the scores of a block of thresholds are kept
+    // and regressed together
+    const size_t block_size = runs.front().prsice->m_prs_info.regress_block;
+    std::vector<ScoreSnapshot> block;
+    auto add_to_block = [&](ScoreSnapshot&& snapshot) {
+        block.push_back(std::move(snapshot));
+        if (block.size() < block_size) return;
+        regress_block(block, prs_result_idx, runs, target, regress_threshold);
+    };
+    std::vector<size_t>::const_iterator start = set_snp_idx.begin();
+    if (runs.front().prsice->m_prs_info.thread <= 1)
+    {
+        double cur_threshold = 0.0;
+        uint32_t num_snp_included = 0;
+        bool first_run = true;
+        while (target.get_score(start, set_snp_idx.cend(), cur_threshold,
+                                num_snp_included, first_run))
+        {
+            if (block_size == 0)
+            { regress_threshold(cur_threshold, num_snp_included); }
+            else
+            {
+                add_to_block(ScoreSnapshot {target.score_snapshot(),
+                                            cur_threshold, num_snp_included});
+            }
+            first_run = false;
+        }
+        regress_block(block, prs_result_idx, runs, target, regress_threshold);
     }
+    else
+    {
+        // score the next threshold while the current one is regressed. Only
+        // one snapshot is queued, so the scoring thread stays at most one
+        // threshold ahead. Thresholds are still regressed in order, so the
+        // best threshold is the same as the sequential run. The threads are
+        // shared between the scoring and the regression
+        const int num_thread = runs.front().prsice->m_prs_info.thread;
+        const int score_thread = num_thread / 2;
+        auto set_regress_thread = [&runs](const int thread) {
+            for (auto&& run : runs) run.prsice->m_prs_info.thread = thread;
+            Eigen::setNbThreads(thread);
+        };
+        set_regress_thread(num_thread - score_thread);
+        target.set_score_thread(score_thread);
+        Thread_Queue<ScoreSnapshot> score_queue;
+        std::exception_ptr score_error = nullptr;
+        std::thread scorer([&]() {
+            try
+            {
+                double cur_threshold = 0.0;
+                uint32_t num_snp_included = 0;
+                bool first_run = true;
+                while (target.get_score(start, set_snp_idx.cend(),
+                                        cur_threshold, num_snp_included,
+                                        first_run, false))
+                {
+                    ScoreSnapshot snapshot;
+                    snapshot.scores = target.score_snapshot();
+                    snapshot.threshold = cur_threshold;
+                    snapshot.num_snp_included = num_snp_included;
+                    score_queue.push(std::move(snapshot), 1);
+                    first_run = false;
+                }
+            }
+            catch (...)
+            {
+                score_error = std::current_exception();
+            }
+            ScoreSnapshot last;
+            last.last = true;
+            score_queue.push(std::move(last), 1);
+        });
+        ScoreSnapshot current;
+        std::exception_ptr regress_error = nullptr;
+        try
+        {
+            score_queue.pop(current);
+            while (!current.last)
+            {
+                if (block_size == 0)
+                {
+                    target.set_score_view(&current.scores);
+                    regress_threshold(current.threshold,
+                                      current.num_snp_included);
+                }
+                else
+                {
+                    add_to_block(std::move(current));
+                }
+                score_queue.pop(current);
+            }
+            regress_block(block, prs_result_idx, runs, target,
+                          regress_threshold);
+        }
+        catch (...)
+        {
+            regress_error = std::current_exception();
+            // let the scoring thread run to completion
+            while (!current.last) score_queue.pop(current);
+        }
+        scorer.join();
+        target.set_score_view(nullptr);
+        target.set_score_thread(num_thread);
+        set_regress_thread(num_thread);
+        if (score_error) std::rethrow_exception(score_error);
+        if (regress_error) std::rethrow_exception(regress_error);
+    }
+    for (auto&& run : runs)
+    {
+        target.select_model(run.model);
+        run.prsice->finish_region(run.region_names, region_idx, run.best_file,
+                                  target);
+    }
+    target.select_model(0);
+}
 
+void PRSice::run_prsice(PartialScores& partial_scores,
+                        const bool all_scores, const bool has_prevalence,
+                        std::vector<PhenoRun>& runs, Genotype& target)
+{
+    if (partial_scores.empty() || runs.empty()) return;
+    const size_t region_idx = 0;
+    std::vector<double> top(runs.size(), 1), bot(runs.size(), 0);
+    for (size_t i = 0; i < runs.size(); ++i)
+    {
+        runs[i].prsice->start_region(target, region_idx);
+        if (runs[i].prevalence <= 1.0)
+        {
+            std::tie(top[i], bot[i]) =
+                runs[i].prsice->lee_adjustment_factor(runs[i].prevalence);
+        }
+    }
+    size_t prs_result_idx = 0;
+    auto regress_threshold = [&](const double cur_threshold,
+                                 const uint32_t num_snp_included) {
+        for (size_t i = 0; i < runs.size(); ++i)
+        {
+            auto&& run = runs[i];
+            target.select_model(run.model);
+            run.prsice->m_num_snp_included = num_snp_included;
+            run.prsice->process_threshold(
+                cur_threshold, prs_result_idx, run.name,
+                run.region_names[region_idx], top[i], bot[i],
+                all_scores && run.idx == 0, has_prevalence, run.prsice_out,
+                run.all_score_file, target);
+        }
+        ++prs_result_idx;
+    };
+    const bool non_cumulate = runs.front().prsice->m_prs_info.non_cumulate;
+    const size_t block_size = runs.front().prsice->m_prs_info.regress_block;
+    std::vector<ScoreSnapshot> block;
+    // thresholds are in ascending order, so the score of each threshold is
+    // the sum of the partial scores up to it
+    PRSList scores = target.new_prs_list();
+    uint32_t num_snp_included = 0;
+    for (auto&& partial : partial_scores.thresholds())
+    {
+        const double threshold = partial.first;
+        if (non_cumulate)
+        {
+            scores.reset();
+            num_snp_included = 0;
+        }
+        num_snp_included += partial_scores.add_to(threshold, scores);
+        if (block_size == 0)
+        {
+            target.set_score_view(&scores);
+            regress_threshold(threshold, num_snp_included);
+            continue;
+        }
+        block.push_back(ScoreSnapshot {scores, threshold, num_snp_included});
+        if (block.size() == block_size)
+        {
+            regress_block(block, prs_result_idx, runs, target,
+                          regress_threshold);
+        }
+    }
+    regress_block(block, prs_result_idx, runs, target, regress_threshold);
+    target.set_score_view(nullptr);
+    for (auto&& run : runs)
+    {
+        target.select_model(run.model);
+        run.prsice->finish_region(run.region_names, region_idx, run.best_file,
+                                  target);
+    }
+    target.select_model(0);
+}
+
+void PRSice::regress_block(
+    std::vector<ScoreSnapshot>& block, const size_t prs_result_idx,
+    std::vector<PhenoRun>& runs, Genotype& target,
+    const std::function<void(double, uint32_t)>& regress_threshold)
+{
+    if (block.empty()) return;
+    for (auto&& run : runs)
+    {
+        target.select_model(run.model);
+        run.prsice->fit_block(block, prs_result_idx, target);
+    }
+    for (auto&& snapshot : block)
+    {
+        target.set_score_view(&snapshot.scores);
+        regress_threshold(snapshot.threshold, snapshot.num_snp_included);
+    }
+    target.set_score_view(nullptr);
+    block.clear();
+}
+
+void PRSice::fit_block(const std::vector<ScoreSnapshot>& block,
+                       const size_t start, Genotype& target)
+{
+    m_block.fitted.clear();
+    if (m_binary_trait || m_prs_info.no_regress) return;
+    const auto num_regress_samples = m_matrix_index.size();
+    Eigen::MatrixXd scores(static_cast<Eigen::Index>(num_regress_samples),
+                           static_cast<Eigen::Index>(block.size()));
+    for (size_t i = 0; i < block.size(); ++i)
+    {
+        target.set_score_view(&block[i].scores);
+        for (size_t sample_id = 0; sample_id < num_regress_samples;
+             ++sample_id)
+        {
+            scores(static_cast<Eigen::Index>(sample_id),
+                   static_cast<Eigen::Index>(i)) =
+                target.calculate_score(m_matrix_index[sample_id]);
+        }
+    }
+    m_block.start = start;
+    m_block.fitted = m_cov_projection.fit_block(
+        scores, m_block.p_value, m_block.r2, m_block.r2_adjust, m_block.coeff,
+        m_block.se);
+}
+
+void PRSice::start_region(const Genotype& target, const size_t region_idx)
+{
+    Eigen::initParallel();
+    Eigen::setNbThreads(m_prs_info.thread);
+    reset_result_containers(target, region_idx);
+    print_progress();
+}
+
+void PRSice::process_threshold(const double cur_threshold,
+                               const size_t prs_result_idx,
+                               const std::string& pheno_name,
+                               const std::string& region_name,
+                               const double top, const double bot,
+                               const bool print_all_scores,
+                               const bool has_prevalence,
+                               std::unique_ptr<std::ostream>& prsice_out,
+                               std::unique_ptr<std::ostream>& all_score_file,
+                               Genotype& target)
+{
+    const auto num_thread = m_prs_info.thread;
+    ++m_analysis_done;
+    print_progress();
+    if (print_all_scores)
+    { print_all_score(target.num_sample(), all_score_file, target); }
+    if (!m_prs_info.no_regress)
+    {
+        regress_score(target, cur_threshold, num_thread, prs_result_idx);
+        print_prsice_output(m_prs_results[prs_result_idx], pheno_name,
+                            region_name, cur_threshold, top, bot,
+                            has_prevalence, prsice_out);
+        if (m_perm_info.run_perm) { permutation(num_thread); }
+    }
+    else
+    {
+        (*prsice_out) << pheno_name << "\t" << region_name << "\t"
+                      << cur_threshold << "\t" << m_num_snp_included << "\n";
+    }
+}
+
+void PRSice::finish_region(const std::vector<std::string>& region_names,
+                           const size_t region_idx,
+                           std::unique_ptr<std::ostream>& best_score_file,
+                           Genotype& target)
+{
+    const bool no_regress = m_prs_info.no_regress;
     if (m_quick_best && !no_regress)
     {
         // if we can, store all best score in a matrix and output once to speed
@@ -1042,8 +1343,7 @@ void PRSice::print_best(
     for (size_t i_sample = 0; i_sample < target.num_sample(); ++i_sample)
     {
         (*best_file) << target.sample_id(i_sample, " ") << " "
-                     << ((target.sample_valid_for_regress(i_sample)) ? "Yes"
-                                                                     : "No")
+                     << (m_valid_for_regress[i_sample] ? "Yes" : "No")
                      << std::setprecision(static_cast<int>(m_precision));
         for (Eigen::Index i = 0; i < m_fast_best_output.cols(); ++i)
         {
@@ -1094,7 +1394,21 @@ void PRSice::regress_score(Genotype& target, const double threshold,
             fprintf(stderr, "Error: %s\n", error.what());
         }
     }
-    else
+    else if (prs_result_idx >= m_block.start
+             && prs_result_idx - m_block.start < m_block.fitted.size()
+             && m_block.fitted[prs_result_idx - m_block.start])
+    {
+        // regressed together with the other thresholds of the block
+        const auto i =
+            static_cast<Eigen::Index>(prs_result_idx - m_block.start);
+        p_value = m_block.p_value(i);
+        r2 = m_block.r2(i);
+        r2_adjust = m_block.r2_adjust(i);
+        coefficient = m_block.coeff(i);
+        se = m_block.se(i);
+    }
+    else if (!m_cov_projection.fit(m_independent_variables.col(1), p_value, r2,
+                                   r2_adjust, coefficient, se))
     {
         // we can run the linear regression
         Regression::fastLm(m_phenotype, m_independent_variables, p_value, r2,
@@ -1303,6 +1617,11 @@ void PRSice::prep_best_output(
 {
     const size_t num_region = region_name.size();
     const size_t num_samples = target.num_sample();
+    // the regression flag will be changed by the other phenotypes when they
+    // share the same target
+    m_valid_for_regress.resize(num_samples);
+    for (size_t i = 0; i < num_samples; ++i)
+    { m_valid_for_regress[i] = target.sample_valid_for_regress(i); }
     const long long begin_byte = best_file->tellp();
     (*best_file) << "FID IID In_Regression";
     if (!(num_region > 2)) { (*best_file) << " PRS\n"; }
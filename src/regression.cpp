@@ -66,4 +66,82 @@ void fastLm(const Eigen::VectorXd& y, const Eigen::MatrixXd& X, double& p_value,
     p_value = misc::calc_tprob(tval, n);
 }
 
+CovariateProjection::CovariateProjection(const Eigen::VectorXd& y,
+                                         const Eigen::MatrixXd& X,
+                                         const Eigen::Index score_col)
+{
+    const Eigen::Index n = X.rows();
+    const Eigen::Index num_cov = X.cols() - 1;
+    if (n != y.rows()) { throw std::runtime_error("Error: Size mismatch"); }
+    Eigen::MatrixXd cov(n, num_cov);
+    cov << X.leftCols(score_col), X.rightCols(num_cov - score_col);
+    Eigen::ColPivHouseholderQR<Eigen::MatrixXd> PQR(cov);
+    // leave rank deficient covariates to fastLm, so that the same columns
+    // are dropped
+    if (PQR.rank() != num_cov) return;
+    m_basis = PQR.householderQ() * Eigen::MatrixXd::Identity(n, num_cov);
+    m_resid_y = y - m_basis * (m_basis.transpose() * y);
+    m_tss = (y.array() - y.mean()).square().sum();
+    m_df = n - num_cov - 1;
+    m_valid = m_df > 0;
+}
+
+bool CovariateProjection::fit(const Eigen::VectorXd& score, double& p_value,
+                              double& r2, double& r2_adjust, double& coeff,
+                              double& standard_error) const
+{
+    if (!m_valid || score.rows() != m_resid_y.rows()) return false;
+    const Eigen::VectorXd resid_x =
+        score - m_basis * (m_basis.transpose() * score);
+    return fit_residual(resid_x, score.norm(), p_value, r2, r2_adjust, coeff,
+                        standard_error);
+}
+
+std::vector<bool> CovariateProjection::fit_block(
+    const Eigen::MatrixXd& scores, Eigen::VectorXd& p_value,
+    Eigen::VectorXd& r2, Eigen::VectorXd& r2_adjust, Eigen::VectorXd& coeff,
+    Eigen::VectorXd& standard_error) const
+{
+    const Eigen::Index k = scores.cols();
+    std::vector<bool> fitted(static_cast<size_t>(k), false);
+    p_value.resize(k);
+    r2.resize(k);
+    r2_adjust.resize(k);
+    coeff.resize(k);
+    standard_error.resize(k);
+    if (!m_valid || scores.rows() != m_resid_y.rows()) return fitted;
+    const Eigen::MatrixXd resid_x =
+        scores - m_basis * (m_basis.transpose() * scores);
+    for (Eigen::Index i = 0; i < k; ++i)
+    {
+        fitted[static_cast<size_t>(i)] = fit_residual(
+            resid_x.col(i), scores.col(i).norm(), p_value(i), r2(i),
+            r2_adjust(i), coeff(i), standard_error(i));
+    }
+    return fitted;
+}
+
+bool CovariateProjection::fit_residual(
+    const Eigen::Ref<const Eigen::VectorXd>& resid_x, const double score_norm,
+    double& p_value, double& r2, double& r2_adjust, double& coeff,
+    double& standard_error) const
+{
+    const Eigen::Index n = resid_x.rows();
+    const double sxx = resid_x.squaredNorm();
+    // same tolerance as the rank detection of the QR decomposition
+    if (std::sqrt(sxx) <= std::numeric_limits<double>::epsilon()
+                              * static_cast<double>(n) * score_norm)
+    { return false; }
+    coeff = resid_x.dot(m_resid_y) / sxx;
+    const double rss = (m_resid_y - coeff * resid_x).squaredNorm();
+    const double df = static_cast<double>(m_df);
+    standard_error = std::sqrt(rss / df / sxx);
+    // the intercept is one of the covariates, so the fitted values and the
+    // residuals partition the total sum of square
+    r2 = 1.0 - rss / m_tss;
+    r2_adjust = 1.0 - (1.0 - r2) * (static_cast<double>(n - 1) / df);
+    p_value = misc::calc_tprob(coeff / standard_error, n);
+    return true;
+}
+
 }
@@ -116,6 +116,7 @@ TEST_CASE("bgen read_genotype")
 
     SECTION("Read into memory")
     {
+        target_bgen.set_sample_ct(n_target);
         target_bgen.load_genotype_to_memory();
         auto&& snp = target_bgen.existed_snps();
         if (!hard_coded) { REQUIRE(snp.front().current_genotype() == nullptr); }
@@ -131,3 +132,114 @@ TEST_CASE("bgen read_genotype")
         }
     }
 }
+
+TEST_CASE("Dosage set scoring")
+{
+    const size_t n_sample = 23;
+    const size_t n_snp = 30;
+    const size_t n_set = 4;
+    std::mt19937 mersenne_engine {13};
+    std::uniform_real_distribution<double> dist {0.0, 1.0};
+    std::uniform_int_distribution<size_t> miss_dist {0, 7};
+    std::vector<std::vector<double>> probs(n_snp);
+    std::vector<SNP> input;
+    for (size_t i = 0; i < n_snp; ++i)
+    {
+        for (size_t s = 0; s < n_sample; ++s)
+        {
+            // samples without any probability are missing
+            const double p = dist(mersenne_engine);
+            std::vector<double> prob = {p * p, 2.0 * p * (1.0 - p),
+                                        (1.0 - p) * (1.0 - p)};
+            if (miss_dist(mersenne_engine) == 0) prob.assign(3, 0.0);
+            for (auto&& g : prob)
+            { g = std::floor(0.5 + g * 32768.0) / 32768.0; }
+            probs[i].insert(probs[i].end(), prob.begin(), prob.end());
+        }
+        // 3 thresholds, with base, background and two overlapping sets
+        const unsigned long long category = i / 10;
+        SNP snp("rs" + std::to_string(i), 1, i + 1, "A", "C", 0, 1,
+                dist(mersenne_engine) - 0.5, 0.01, category,
+                0.1 * static_cast<double>(category + 1));
+        const SNP target_info = snp;
+        snp.add_snp_info(target_info, i % 3 == 0, false);
+        uintptr_t flag = 3;
+        if (i % 2 == 0) flag |= 1 << 2;
+        if (i >= 15) flag |= 1 << 3;
+        snp.get_flag() = std::vector<uintptr_t> {flag};
+        input.push_back(snp);
+    }
+    auto phased = genfile::ePerUnorderedGenotype;
+    auto layout = genfile::bgen::e_Layout1;
+    auto compress = genfile::bgen::e_NoCompression;
+    Reporter reporter("log", 60, true);
+    Phenotype pheno;
+    GenoFile geno_info;
+    geno_info.num_autosome = 22;
+    geno_info.file_name = "dosage_set,sample";
+    mock_binarygen bgen(geno_info, pheno, " ", &reporter);
+    bgen.test_init_chr();
+    auto bgen_str = bgen.gen_mock_snp(probs, input, n_sample, phased, layout,
+                                      compress);
+    std::ofstream out("dosage_set.bgen", std::ios::binary);
+    out << bgen_str;
+    out.close();
+    std::istringstream bgen_file(bgen_str);
+    bgen.load_context(bgen_file);
+    bgen.add_file("dosage_set");
+    bgen.update_sample(n_sample);
+    bgen.set_sample_ct(n_sample);
+    bgen.set_hard_code(false);
+    for (auto&& snp : input) bgen.manual_load_snp(snp);
+    bgen.set_weight(GENERATE(MODEL::ADDITIVE, MODEL::DOMINANT));
+    CalculatePRS prs_info;
+    prs_info.missing_score =
+        GENERATE(MISSING_SCORE::CENTER, MISSING_SCORE::MEAN_IMPUTE,
+                 MISSING_SCORE::SET_ZERO);
+    bgen.set_prs_instruction(prs_info);
+    REQUIRE(bgen.prepare_prsice());
+    std::ostringstream snp_out;
+    std::vector<std::string> names = {"Base", "Background", "A", "B"};
+    auto membership =
+        bgen.build_membership_matrix(n_set, names, false, snp_out);
+    auto score_set = [&bgen](const std::vector<size_t>& member) {
+        std::vector<PRSList> result;
+        auto start = member.cbegin();
+        double threshold;
+        uint32_t num_snp = 0;
+        bool first_run = true;
+        while (bgen.get_score(start, member.cend(), threshold, num_snp,
+                              first_run))
+        {
+            result.push_back(bgen.prs_info());
+            first_run = false;
+        }
+        return result;
+    };
+    std::vector<std::vector<PRSList>> expected(n_set);
+    for (size_t s = 0; s < n_set; ++s)
+    {
+        if (s == 1) continue;
+        expected[s] = score_set(membership[s]);
+    }
+    // the dosages decoded in blocks are scored as when reading the file
+    bgen.set_gemm_min_density(GENERATE(0.0, 2.0));
+    for (size_t s = 0; s < n_set; ++s)
+    {
+        if (s == 1) continue;
+        bgen.prepare_set_scores(membership, s, ~0ull);
+        REQUIRE(bgen.num_cached_scores(s) == expected[s].size());
+        auto observed = score_set(membership[s]);
+        REQUIRE(observed.size() == expected[s].size());
+        for (size_t i = 0; i < observed.size(); ++i)
+        {
+            for (size_t j = 0; j < n_sample; ++j)
+            {
+                REQUIRE(observed[i].prs[j]
+                        == Approx(expected[s][i].prs[j]).margin(1e-12));
+                REQUIRE(observed[i].snp_count(j)
+                        == expected[s][i].snp_count(j));
+            }
+        }
+    }
+}
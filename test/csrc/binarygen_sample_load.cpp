@@ -288,5 +288,53 @@ TEST_CASE("full sample load")
     // reference with selection but not sample file
 }
 
+TEST_CASE("bgen reference sample ID")
+{
+    // without --keep or --remove, the sample ID of the reference are still
+    // loaded when they are required by the reference package
+    Reporter reporter("log", 60, true);
+    GenoFile geno;
+    geno.is_ref = true;
+    geno.file_name = "ref_sample_load,bgen_ref_sample_load";
+    Phenotype pheno;
+    mock_binarygen bgen(geno, pheno, " ", &reporter);
+    bgen.set_reporter(&reporter);
+    bgen.gen_bgen_header("ref_sample_load.bgen", 0, 3, "reference sample ID",
+                         4294967295u);
+    bgen.reference();
+    bgen.keep_sample_id(true);
+    std::ofstream sample("bgen_ref_sample_load");
+    sample << "ID1 ID2 missing\n"
+              "0 0 0\n"
+              "F1 I1 0\n"
+              "F2 I2 0\n"
+              "F3 I3 0\n";
+    sample.close();
+    bgen.load_samples(false);
+    auto res = bgen.sample_id();
+    REQUIRE(res.size() == 3);
+    for (size_t i = 0; i < res.size(); ++i)
+    {
+        REQUIRE(res[i].FID == "F" + std::to_string(i + 1));
+        REQUIRE(res[i].IID == "I" + std::to_string(i + 1));
+    }
+    REQUIRE_NOTHROW(bgen.prepare_reference("bgen_ref_package", bgen));
+    std::ifstream fam("bgen_ref_package.fam");
+    std::string line;
+    std::vector<std::string> fam_id;
+    while (std::getline(fam, line))
+    {
+        auto token = misc::split(line);
+        REQUIRE(token.size() == 6);
+        fam_id.push_back(token[0] + " " + token[1]);
+    }
+    REQUIRE(fam_id
+            == std::vector<std::string> {"F1 I1", "F2 I2", "F3 I3"});
+    fam.close();
+    for (auto&& suffix : {".bed", ".bim", ".fam", ".prsref"})
+    { std::remove(("bgen_ref_package" + std::string(suffix)).c_str()); }
+    std::remove("bgen_ref_sample_load");
+    std::remove("ref_sample_load.bgen");
+}
 
 TEST_CASE("check sample consistence") {}
@@ -109,3 +109,183 @@ TEST_CASE("Geno and MAF filtering")
         }
     }
 }
+
+TEST_CASE("Reference package")
+{
+    const size_t n_sample = 13;
+    // use code 0, 1, 2, 3 to represent dosage of genotype and missing (3)
+    const std::vector<std::vector<size_t>> sample_genotype = {
+        {0, 1, 2, 3, 0, 0, 1, 1, 2, 2, 0, 1, 2},
+        {2, 2, 2, 1, 1, 0, 0, 0, 0, 3, 3, 0, 1},
+        {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1}};
+    const std::vector<bool> founder = {true, false, true,  true, true,
+                                       false, true, true,  true, true,
+                                       false, true, true};
+    const size_t n_founder = 10;
+    Reporter reporter("log", 60, true);
+    mock_binaryplink plink;
+    plink.set_reporter(&reporter);
+    plink.set_sample(n_sample);
+    plink.test_init_sample_vectors();
+    plink.set_founder_vector(founder);
+    plink.set_sample_vector(n_sample);
+    plink.test_post_sample_read_init();
+    for (size_t i = 0; i < n_sample; ++i)
+    {
+        plink.add_sample_id(Sample_ID("F" + std::to_string(i),
+                                      "I" + std::to_string(i), "1", true));
+    }
+    plink.gen_fake_bed(sample_genotype, "ref_package_input");
+    plink.existed_snps().clear();
+    const std::streampos sample_ct4 = (n_sample + 3) / 4;
+    // variants are not in coordinate order
+    plink.manual_load_snp(SNP("rs3", 2, 100, "A", "C", 0, 3 + 2 * sample_ct4));
+    plink.manual_load_snp(SNP("rs1", 1, 500, "G", "T", 0, 3));
+    plink.manual_load_snp(SNP("rs2", 1, 900, "A", "G", 0, 3 + sample_ct4));
+    plink.prepare_reference("ref_package", plink);
+    const std::vector<std::string> expected_rs = {"rs1", "rs2", "rs3"};
+    const std::vector<std::pair<size_t, size_t>> expected_coord = {
+        {1, 500}, {1, 900}, {2, 100}};
+    // only founders are written
+    std::ifstream fam("ref_package.fam");
+    std::string line;
+    std::vector<std::string> fam_id;
+    while (std::getline(fam, line))
+    {
+        auto token = misc::split(line);
+        REQUIRE(token.size() == 6);
+        REQUIRE(token[2] == "0");
+        REQUIRE(token[3] == "0");
+        fam_id.push_back(token[1]);
+    }
+    std::vector<std::string> expected_id;
+    uint64_t founder_id_hash = 0;
+    for (size_t i = 0; i < n_sample; ++i)
+    {
+        if (!founder[i]) continue;
+        expected_id.push_back("I" + std::to_string(i));
+        founder_id_hash = misc::hash_bytes(
+            "I" + std::to_string(i),
+            misc::hash_bytes("F" + std::to_string(i), founder_id_hash));
+    }
+    REQUIRE(fam_id == expected_id);
+    std::ifstream bim("ref_package.bim");
+    std::vector<std::string> bim_rs;
+    while (std::getline(bim, line))
+    { bim_rs.push_back(misc::split(line)[1]); }
+    REQUIRE(bim_rs == expected_rs);
+    // genotypes are packed to the founders
+    std::ifstream bed("ref_package.bed", std::ios::binary);
+    std::vector<unsigned char> bed_bytes(
+        (std::istreambuf_iterator<char>(bed)),
+        std::istreambuf_iterator<char>());
+    const size_t founder_ct4 = (n_founder + 3) / 4;
+    REQUIRE(bed_bytes.size() == 3 + expected_rs.size() * founder_ct4);
+    REQUIRE(bed_bytes[0] == 0x6c);
+    REQUIRE(bed_bytes[1] == 0x1b);
+    REQUIRE(bed_bytes[2] == 0x01);
+    // translate bed code to the dosage code
+    const std::vector<size_t> decode = {0, 3, 1, 2};
+    std::vector<std::array<uint32_t, 3>> expected_counts;
+    for (size_t i_snp = 0; i_snp < expected_rs.size(); ++i_snp)
+    {
+        auto&& expected = sample_genotype[i_snp];
+        std::array<uint32_t, 3> counts = {0, 0, 0};
+        size_t founder_idx = 0;
+        for (size_t i = 0; i < n_sample; ++i)
+        {
+            if (!founder[i]) continue;
+            const unsigned char byte =
+                bed_bytes[3 + i_snp * founder_ct4 + founder_idx / 4];
+            const size_t code = (byte >> (2 * (founder_idx % 4))) & 3;
+            REQUIRE(decode[code] == expected[i]);
+            if (expected[i] != 3) ++counts[expected[i]];
+            ++founder_idx;
+        }
+        expected_counts.push_back(counts);
+    }
+    std::ifstream count("ref_package.prsref");
+    std::getline(count, line);
+    REQUIRE(line
+            == "#PRSICE_REF\t" + std::to_string(n_founder) + "\t"
+                   + std::to_string(founder_id_hash));
+    for (size_t i_snp = 0; i_snp < expected_rs.size(); ++i_snp)
+    {
+        std::getline(count, line);
+        auto token = misc::split(line);
+        REQUIRE(token.size() == 6);
+        REQUIRE(token[0] == expected_rs[i_snp]);
+        REQUIRE(token[1] == std::to_string(expected_coord[i_snp].first));
+        REQUIRE(token[2] == std::to_string(expected_coord[i_snp].second));
+        for (size_t i = 0; i < 3; ++i)
+        {
+            REQUIRE(misc::convert<uint32_t>(token[i + 3])
+                    == expected_counts[i_snp][i]);
+        }
+    }
+    count.close();
+    // now use the package as the reference
+    GenoFile geno;
+    geno.file_name = "ref_package";
+    Phenotype pheno;
+    mock_binaryplink ref(geno, pheno, " ", &reporter);
+    ref.reference();
+    mock_binaryplink target;
+    target.set_reporter(&reporter);
+    // reference file information are invalid, so QC must not read the
+    // genotypes
+    for (size_t i_snp = 0; i_snp < expected_rs.size(); ++i_snp)
+    {
+        target.manual_load_snp(SNP(expected_rs[i_snp],
+                                   expected_coord[i_snp].first,
+                                   expected_coord[i_snp].second, "A", "C", 0,
+                                   1000000 + i_snp));
+    }
+    QCFiltering filter_info;
+    filter_info.maf = 0.1;
+    SECTION("QC with package counts")
+    {
+        ref.load_samples(false);
+        REQUIRE_NOTHROW(
+            ref.calc_freqs_and_intermediate(filter_info, "", false, &target));
+        // rs3 only has one heterozygous founder
+        auto res = target.existed_snps();
+        REQUIRE(res.size() == 2);
+        for (size_t i_snp = 0; i_snp < res.size(); ++i_snp)
+        {
+            uint32_t hom_a1 = 0, het = 0, hom_a2 = 0, missing = 0;
+            REQUIRE(res[i_snp].get_counts(hom_a1, het, hom_a2, missing, true));
+            REQUIRE(res[i_snp].rs() == expected_rs[i_snp]);
+            REQUIRE(hom_a1 == expected_counts[i_snp][0]);
+            REQUIRE(het == expected_counts[i_snp][1]);
+            REQUIRE(hom_a2 == expected_counts[i_snp][2]);
+            REQUIRE(missing == n_founder - hom_a1 - het - hom_a2);
+        }
+    }
+    SECTION("Package not used when samples differ")
+    {
+        // same number of founders, but one of them is replaced
+        std::ifstream package_fam("ref_package.fam");
+        std::string fam_content((std::istreambuf_iterator<char>(package_fam)),
+                                std::istreambuf_iterator<char>());
+        package_fam.close();
+        fam_content.replace(fam_content.find("I0"), 2, "X0");
+        std::ofstream modified_fam("ref_package.fam");
+        modified_fam << fam_content;
+        modified_fam.close();
+        ref.load_samples(false);
+        REQUIRE_THROWS(
+            ref.calc_freqs_and_intermediate(filter_info, "", false, &target));
+    }
+    SECTION("Package not used when variants differ")
+    {
+        ref.load_samples(false);
+        target.existed_snps()[1] =
+            SNP(expected_rs[1], 1, 901, "A", "C", 0, 1000001);
+        REQUIRE_THROWS(
+            ref.calc_freqs_and_intermediate(filter_info, "", false, &target));
+    }
+    for (auto&& suffix : {".bed", ".bim", ".fam", ".prsref"})
+    { std::remove(("ref_package" + std::string(suffix)).c_str()); }
+    std::remove("ref_package_input.bed");
+}
@@ -1,6 +1,74 @@
 #include "catch.hpp"
 #include "mock_binaryplink.hpp"
+#include "mock_prsice.hpp"
 #include "plink_common.hpp"
+
+// random genotypes of each variant. The first sample is called unless
+// otherwise requested, so that no variant is completely missing
+std::vector<std::vector<size_t>> random_genotype(const size_t n_sample,
+                                                 const size_t n_snp,
+                                                 std::mt19937& engine,
+                                                 const bool first_called = true)
+{
+    std::uniform_int_distribution<size_t> geno_dist {0, 3};
+    std::vector<std::vector<size_t>> genotype(n_snp,
+                                              std::vector<size_t>(n_sample));
+    for (auto&& snp : genotype)
+    {
+        for (auto&& g : snp) { g = geno_dist(engine); }
+        if (first_called) snp[0] = 0;
+    }
+    return genotype;
+}
+
+// variant with a random effect size, scored at the first threshold
+auto random_effect(std::mt19937& engine)
+{
+    return [&engine](const size_t i, const std::streampos byte) {
+        std::uniform_real_distribution<double> stat_dist {-1.0, 1.0};
+        return SNP("rs" + std::to_string(i), 1, i + 1, "A", "C", 0, byte,
+                   stat_dist(engine), 0.01, 0, 0.01);
+    };
+}
+
+// write the genotypes to a fake bed file and load each variant made by
+// make_snp(i, byte), where byte is the location of the i th variant. All
+// samples are included unless selected is provided. Returns the index of
+// the loaded variants
+template <typename SNPMaker>
+std::vector<size_t>
+make_scored_plink(mock_binaryplink& plink, Reporter& reporter,
+                  const std::vector<std::vector<size_t>>& genotype,
+                  const std::string& name, SNPMaker&& make_snp,
+                  const std::vector<bool>& selected = {})
+{
+    const size_t n_sample = genotype.front().size();
+    plink.set_reporter(&reporter);
+    plink.set_sample(n_sample);
+    plink.test_init_sample_vectors();
+    if (selected.empty())
+    {
+        plink.set_founder_vector(n_sample);
+        plink.set_sample_vector(n_sample);
+    }
+    else
+    {
+        plink.set_sample_vector(selected);
+        plink.set_founder_vector(selected);
+    }
+    plink.test_post_sample_read_init();
+    plink.gen_fake_bed(genotype, name);
+    plink.existed_snps().clear();
+    const std::streampos sample_ct4 = (n_sample + 3) / 4;
+    std::vector<size_t> index(genotype.size());
+    for (size_t i = 0; i < genotype.size(); ++i)
+    {
+        plink.manual_load_snp(
+            make_snp(i, 3 + static_cast<long>(i) * sample_ct4));
+        index[i] = i;
+    }
+    return index;
+}
 TEST_CASE("plink read_genotype")
 {
     // first generate two object, the target and the reference
@@ -138,6 +206,132 @@ TEST_CASE("plink read_genotype")
         REQUIRE_THAT(observed, Catch::Equals<uintptr_t>(expected_memory));
     }
 }
+TEST_CASE("Multi-threaded scoring")
+{
+    const size_t n_sample = 13;
+    const size_t n_snp = 1000;
+    std::mt19937 mersenne_engine {42};
+    auto sample_genotype =
+        random_genotype(n_sample, n_snp, mersenne_engine);
+    Reporter reporter("log", 60, true);
+    mock_binaryplink plink;
+    auto index =
+        make_scored_plink(plink, reporter, sample_genotype, "parallel_score",
+                          random_effect(mersenne_engine));
+    plink.set_weight(MODEL::ADDITIVE);
+    CalculatePRS prs_info;
+    prs_info.missing_score =
+        GENERATE(MISSING_SCORE::CENTER, MISSING_SCORE::SET_ZERO,
+                 MISSING_SCORE::MEAN_IMPUTE, MISSING_SCORE::IMPUTE_CONTROL);
+    plink.set_prs_instruction(prs_info);
+    plink.test_read_score(index, true);
+    const PRSList expected = plink.prs_info();
+    plink.test_read_score(index, false);
+    const PRSList expected_twice = plink.prs_info();
+    prs_info.thread = GENERATE(2, 3, 8);
+    plink.set_prs_instruction(prs_info);
+    // accumulated scores must be reset on the first run. The chunks are
+    // summed in the same order regardless of the number of threads, so the
+    // scores are identical to those of a single thread
+    plink.test_read_score(index, true);
+    auto&& observed = plink.prs_info();
+    for (size_t i = 0; i < n_sample; ++i)
+    {
+        REQUIRE(observed.prs[i] == expected.prs[i]);
+        REQUIRE(observed.snp_count(i) == expected.snp_count(i));
+    }
+    // and are added to in subsequent runs
+    plink.test_read_score(index, false);
+    for (size_t i = 0; i < n_sample; ++i)
+    {
+        REQUIRE(observed.prs[i] == expected_twice.prs[i]);
+        REQUIRE(observed.snp_count(i) == expected_twice.snp_count(i));
+    }
+}
+
+TEST_CASE("Single pass set scoring")
+{
+    const size_t n_sample = 13;
+    const size_t n_snp = 60;
+    const size_t n_set = 5;
+    std::mt19937 mersenne_engine {42};
+    std::uniform_real_distribution<double> stat_dist {-1.0, 1.0};
+    auto sample_genotype =
+        random_genotype(n_sample, n_snp, mersenne_engine);
+    Reporter reporter("log", 60, true);
+    mock_binaryplink plink;
+    make_scored_plink(
+        plink, reporter, sample_genotype, "set_score",
+        [&](const size_t i, const std::streampos byte) {
+            // 6 thresholds, with base, background and three overlapping sets
+            const unsigned long long category = i / 10;
+            SNP snp("rs" + std::to_string(i), 1, i + 1, "A", "C", 0, byte,
+                    stat_dist(mersenne_engine), 0.01, category,
+                    0.1 * static_cast<double>(category + 1));
+            uintptr_t flag = 3;
+            if (i % 2 == 0) flag |= 1 << 2;
+            if (i % 3 == 0) flag |= 1 << 3;
+            if (i >= 25) flag |= 1 << 4;
+            snp.get_flag() = std::vector<uintptr_t> {flag};
+            return snp;
+        });
+    plink.set_weight(MODEL::ADDITIVE);
+    CalculatePRS prs_info;
+    prs_info.non_cumulate = GENERATE(false, true);
+    // missing genotypes set to zero reduce the allele count of the sample
+    prs_info.missing_score =
+        GENERATE(MISSING_SCORE::MEAN_IMPUTE, MISSING_SCORE::SET_ZERO);
+    plink.set_prs_instruction(prs_info);
+    REQUIRE(plink.prepare_prsice());
+    std::ostringstream snp_out;
+    std::vector<std::string> names = {"Base", "Background", "A", "B", "C"};
+    auto membership =
+        plink.build_membership_matrix(n_set, names, false, snp_out);
+    auto score_set = [&plink](const std::vector<size_t>& member) {
+        std::vector<PRSList> result;
+        auto start = member.cbegin();
+        double threshold;
+        uint32_t num_snp = 0;
+        bool first_run = true;
+        while (plink.get_score(start, member.cend(), threshold, num_snp,
+                               first_run))
+        {
+            result.push_back(plink.prs_info());
+            first_run = false;
+        }
+        return result;
+    };
+    std::vector<std::vector<PRSList>> expected(n_set);
+    for (size_t s = 0; s < n_set; ++s)
+    {
+        if (s == 1) continue;
+        expected[s] = score_set(membership[s]);
+    }
+    // either all sets in one pass, or one set per pass
+    const unsigned long long memory = GENERATE(0ull, ~0ull);
+    // accumulate with the matrix product or by adding each variant
+    plink.set_gemm_min_density(GENERATE(0.0, 2.0));
+    for (size_t s = 0; s < n_set; ++s)
+    {
+        if (s == 1) continue;
+        plink.prepare_set_scores(membership, s, memory);
+        REQUIRE(plink.num_cached_scores(s) == expected[s].size());
+        auto observed = score_set(membership[s]);
+        REQUIRE(observed.size() == expected[s].size());
+        for (size_t i = 0; i < observed.size(); ++i)
+        {
+            for (size_t j = 0; j < n_sample; ++j)
+            {
+                REQUIRE(observed[i].prs[j]
+                        == Approx(expected[s][i].prs[j]).margin(1e-12));
+                REQUIRE(observed[i].snp_count(j)
+                        == expected[s][i].snp_count(j));
+            }
+        }
+    }
+    plink.clear_set_scores();
+}
+
 /*
 void generate_expected_prs(const std::vector<size_t>& genotype,
                            const std::vector<bool>& selected,
@@ -145,7 +339,7 @@ void generate_expected_prs(const std::vector<size_t>& genotype,
                            const MISSING_SCORE& missing_score,
                            const SCORING& scoring, const bool flipped,
                            const bool use_ref_maf, Genotype& geno,
-                           std::vector<PRS>& expected_prs,
+                           PRSList& expected_prs,
                            misc::RunningStat& rs)
 {
 }
@@ -215,3 +409,594 @@ TEST_CASE("Test PRS Read score")
     // generate case control sample and do the exclude_std thingy
 }
 */
+TEST_CASE("Sparse carrier scoring")
+{
+    const size_t n_sample = 71;
+    const size_t n_snp = 200;
+    std::mt19937 mersenne_engine {7};
+    std::uniform_int_distribution<size_t> geno_dist {0, 3};
+    std::uniform_int_distribution<size_t> carrier_dist {0, 19};
+    std::vector<std::vector<size_t>> sample_genotype(
+        n_snp, std::vector<size_t>(n_sample));
+    for (size_t i = 0; i < n_snp; ++i)
+    {
+        // alternate the major genotype so that every baseline is covered
+        const size_t major = (i % 3 == 2) ? 2 : i % 3;
+        for (auto&& g : sample_genotype[i])
+        {
+            g = major;
+            if (carrier_dist(mersenne_engine) == 0)
+            { g = geno_dist(mersenne_engine); }
+        }
+    }
+    Reporter reporter("log", 60, true);
+    mock_binaryplink plink;
+    auto index = make_scored_plink(plink, reporter, sample_genotype,
+                                   "sparse_score",
+                                   random_effect(mersenne_engine));
+    plink.set_weight(GENERATE(MODEL::ADDITIVE, MODEL::DOMINANT));
+    CalculatePRS prs_info;
+    prs_info.missing_score =
+        GENERATE(MISSING_SCORE::CENTER, MISSING_SCORE::SET_ZERO,
+                 MISSING_SCORE::MEAN_IMPUTE);
+    plink.set_prs_instruction(prs_info);
+    plink.test_read_score(index, true);
+    const PRSList expected = plink.prs_info();
+    prs_info.sparse_maf = 0.5;
+    plink.set_prs_instruction(prs_info);
+    const bool in_memory = GENERATE(false, true);
+    if (in_memory)
+    {
+        plink.load_genotype_to_memory();
+        size_t num_sparse = 0;
+        for (auto&& snp : plink.existed_snps())
+        {
+            if (!snp.sparse_genotype()) continue;
+            REQUIRE(snp.current_genotype() == nullptr);
+            ++num_sparse;
+        }
+        REQUIRE(num_sparse > n_snp / 2);
+    }
+    plink.test_read_score(index, true);
+    auto&& observed = plink.prs_info();
+    for (size_t i = 0; i < n_sample; ++i)
+    {
+        REQUIRE(observed.score(i) == Approx(expected.score(i)));
+        REQUIRE(observed.snp_count(i) == expected.snp_count(i));
+    }
+    plink.test_read_score(index, false);
+    for (size_t i = 0; i < n_sample; ++i)
+    {
+        REQUIRE(observed.score(i) == Approx(2 * expected.score(i)));
+        REQUIRE(observed.snp_count(i) == 2 * expected.snp_count(i));
+    }
+}
+TEST_CASE("Score multiple genetic models together")
+{
+    const size_t n_sample = 37;
+    const size_t n_snp = 300;
+    std::mt19937 mersenne_engine {11};
+    auto sample_genotype = random_genotype(n_sample, n_snp, mersenne_engine);
+    Reporter reporter("log", 60, true);
+    mock_binaryplink plink;
+    auto effect = random_effect(mersenne_engine);
+    auto index = make_scored_plink(
+        plink, reporter, sample_genotype, "multi_model_score",
+        [&effect](const size_t i, const std::streampos byte) {
+            SNP snp = effect(i, byte);
+            // flipped variants swap the weight of the homozygous genotypes
+            const SNP target_info = snp;
+            snp.add_snp_info(target_info, i % 4 == 0, false);
+            return snp;
+        });
+    const std::vector<MODEL> models = {MODEL::ADDITIVE, MODEL::DOMINANT,
+                                       MODEL::RECESSIVE, MODEL::HETEROZYGOUS};
+    CalculatePRS prs_info;
+    prs_info.missing_score =
+        GENERATE(MISSING_SCORE::CENTER, MISSING_SCORE::SET_ZERO,
+                 MISSING_SCORE::MEAN_IMPUTE);
+    prs_info.sparse_maf = GENERATE(0.0, 0.5);
+    prs_info.thread = GENERATE(1, 3);
+    // score each model on its own
+    std::vector<PRSList> expected;
+    for (auto&& model : models)
+    {
+        plink.set_prs_instruction(prs_info);
+        plink.set_weight(model);
+        plink.test_read_score(index, true);
+        plink.test_read_score(index, false);
+        expected.push_back(plink.prs_info());
+    }
+    prs_info.genetic_model = models.front();
+    prs_info.other_models.assign(models.begin() + 1, models.end());
+    plink.set_prs_instruction(prs_info);
+    plink.set_weight(models.front());
+    REQUIRE(plink.num_models() == models.size());
+    plink.test_read_score(index, true);
+    plink.test_read_score(index, false);
+    auto&& observed = plink.prs_info();
+    for (size_t m = 0; m < models.size(); ++m)
+    {
+        for (size_t i = 0; i < n_sample; ++i)
+        {
+            REQUIRE(observed.score(i, m)
+                    == Approx(expected[m].score(i)).margin(1e-12));
+            REQUIRE(observed.snp_count(i) == expected[m].snp_count(i));
+        }
+    }
+}
+TEST_CASE("Score snapshot view")
+{
+    const size_t n_sample = 29;
+    const size_t n_snp = 40;
+    std::mt19937 mersenne_engine {5};
+    auto sample_genotype = random_genotype(n_sample, n_snp, mersenne_engine);
+    Reporter reporter("log", 60, true);
+    mock_binaryplink plink;
+    auto index = make_scored_plink(plink, reporter, sample_genotype,
+                                   "snapshot_score",
+                                   random_effect(mersenne_engine));
+    const std::vector<size_t> first_half(index.begin(),
+                                         index.begin() + n_snp / 2),
+        second_half(index.begin() + n_snp / 2, index.end());
+    CalculatePRS prs_info;
+    prs_info.scoring_method = SCORING::SUM;
+    plink.set_prs_instruction(prs_info);
+    plink.set_weight(MODEL::ADDITIVE);
+    plink.test_read_score(first_half, true);
+    std::vector<double> expected(n_sample);
+    for (size_t i = 0; i < n_sample; ++i)
+    { expected[i] = plink.calculate_score(i); }
+    const PRSList snapshot = plink.score_snapshot();
+    // scoring the next threshold must not change the snapshot in use
+    plink.test_read_score(second_half, false);
+    plink.set_score_view(&snapshot);
+    for (size_t i = 0; i < n_sample; ++i)
+    { REQUIRE(plink.calculate_score(i) == Approx(expected[i])); }
+    plink.set_score_view(nullptr);
+    for (size_t i = 0; i < n_sample; ++i)
+    {
+        REQUIRE(plink.calculate_score(i)
+                == Approx(plink.prs_info().score(i)));
+    }
+}
+TEST_CASE("Parallel genotype preload")
+{
+    const size_t n_sample = 23;
+    const size_t n_snp = 1100;
+    std::mt19937 mersenne_engine {17};
+    auto sample_genotype =
+        random_genotype(n_sample, n_snp, mersenne_engine);
+    Reporter reporter("log", 60, true);
+    mock_binaryplink plink;
+    auto index =
+        make_scored_plink(plink, reporter, sample_genotype, "parallel_preload",
+                          random_effect(mersenne_engine));
+    plink.set_weight(MODEL::ADDITIVE);
+    CalculatePRS prs_info;
+    plink.set_prs_instruction(prs_info);
+    plink.test_read_score(index, true);
+    const PRSList expected = plink.prs_info();
+    prs_info.thread = GENERATE(1, 4);
+    prs_info.sparse_maf = GENERATE(0.0, 0.3);
+    plink.set_prs_instruction(prs_info);
+    plink.load_genotype_to_memory();
+    for (auto&& snp : plink.existed_snps())
+    {
+        REQUIRE((snp.sparse_genotype() || snp.current_genotype() != nullptr));
+    }
+    plink.test_read_score(index, true);
+    auto&& observed = plink.prs_info();
+    for (size_t i = 0; i < n_sample; ++i)
+    {
+        REQUIRE(observed.score(i) == Approx(expected.score(i)));
+        REQUIRE(observed.snp_count(i) == expected.snp_count(i));
+    }
+}
+TEST_CASE("Concurrent scoring with genotype cursors")
+{
+    const size_t n_sample = 19;
+    const size_t n_snp = 300;
+    std::mt19937 mersenne_engine {23};
+    auto sample_genotype =
+        random_genotype(n_sample, n_snp, mersenne_engine, false);
+    Reporter reporter("log", 60, true);
+    mock_binaryplink plink;
+    auto index =
+        make_scored_plink(plink, reporter, sample_genotype, "cursor_score",
+                          random_effect(mersenne_engine));
+    plink.set_weight(MODEL::ADDITIVE);
+    CalculatePRS prs_info;
+    plink.set_prs_instruction(prs_info);
+    plink.test_read_score(index, true);
+    const PRSList expected = plink.prs_info();
+    // each thread reads the same variants with its own cursor
+    const size_t num_thread = 4;
+    std::vector<PRSList> observed(num_thread);
+    std::vector<std::thread> subjects;
+    for (size_t i = 0; i < num_thread; ++i)
+    {
+        subjects.emplace_back([&plink, &observed, &index, i]() {
+            observed[i] = plink.test_cursor_score(index);
+        });
+    }
+    for (auto&& thread : subjects) thread.join();
+    for (auto&& prs : observed)
+    {
+        for (size_t i = 0; i < n_sample; ++i)
+        {
+            REQUIRE(prs.score(i) == Approx(expected.score(i)));
+            REQUIRE(prs.snp_count(i) == expected.snp_count(i));
+        }
+    }
+}
+TEST_CASE("Genotype block iterator")
+{
+    const size_t n_sample = 45;
+    const size_t n_snp = 40;
+    std::mt19937 mersenne_engine {31};
+    std::uniform_int_distribution<size_t> geno_dist {0, 3};
+    std::vector<std::vector<size_t>> sample_genotype(
+        n_snp, std::vector<size_t>(n_sample));
+    for (size_t i = 0; i < n_snp; ++i)
+    {
+        for (size_t s = 0; s < n_sample; ++s)
+        {
+            // make every fifth variant rare, so it is stored as its carriers
+            if (i % 5 == 0) { sample_genotype[i][s] = (s == 2) + 3 * (s == 6); }
+            else
+            {
+                sample_genotype[i][s] = geno_dist(mersenne_engine);
+            }
+        }
+    }
+    std::vector<bool> selected(n_sample);
+    for (size_t i = 0; i < n_sample; ++i) { selected[i] = (i % 4 != 1); }
+    Reporter reporter("log", 60, true);
+    mock_binaryplink plink;
+    auto all = make_scored_plink(
+        plink, reporter, sample_genotype, "block_iterator",
+        [](const size_t i, const std::streampos byte) {
+            return SNP("rs" + std::to_string(i), 1, i + 1, "A", "C", 0, byte,
+                       0.1, 0.01, 0, 0.01);
+        },
+        selected);
+    std::vector<size_t> index;
+    // leave gaps so that some blocks need more than one read
+    std::copy_if(all.begin(), all.end(), std::back_inserter(index),
+                 [](const size_t i) { return i % 7 != 3; });
+    plink.set_weight(MODEL::ADDITIVE);
+    CalculatePRS prs_info;
+    prs_info.sparse_maf = 0.3;
+    plink.set_prs_instruction(prs_info);
+    if (GENERATE(false, true))
+    {
+        plink.load_genotype_to_memory();
+        REQUIRE(plink.existed_snps().front().sparse_genotype());
+    }
+    // 0, 1, 2 and 3 of the simulated genotype are stored as 00, 10, 11 and
+    // 01
+    const uintptr_t expected_code[4] = {0, 2, 3, 1};
+    GenotypeBlock block;
+    GenotypeCursor cursor = plink.new_cursor();
+    auto cur = index.cbegin();
+    size_t num_read = 0;
+    while (plink.next_block(cur, index.cend(), 6, block, cursor))
+    {
+        REQUIRE(block.size() <= 6);
+        REQUIRE_FALSE(block.is_dosage);
+        for (size_t i = 0; i < block.size(); ++i)
+        {
+            REQUIRE(block.index[i] == index[num_read + i]);
+            auto&& geno = sample_genotype[block.index[i]];
+            auto&& row = block.packed_row(i);
+            AlleleCounts expected;
+            size_t k = 0;
+            for (size_t s = 0; s < n_sample; ++s)
+            {
+                if (!selected[s]) continue;
+                const uintptr_t code =
+                    (row[k / BITCT2] >> (2 * (k % BITCT2))) & 3;
+                REQUIRE(code == expected_code[geno[s]]);
+                switch (code)
+                {
+                case 0: ++expected.homcom; break;
+                case 1: ++expected.missing; break;
+                case 2: ++expected.het; break;
+                case 3: ++expected.homrar; break;
+                }
+                ++k;
+            }
+            auto&& ct = block.counts[i];
+            REQUIRE(ct.has_count);
+            REQUIRE(ct.homcom == expected.homcom);
+            REQUIRE(ct.het == expected.het);
+            REQUIRE(ct.homrar == expected.homrar);
+            REQUIRE(ct.missing == expected.missing);
+        }
+        num_read += block.size();
+    }
+    REQUIRE(num_read == index.size());
+}
+TEST_CASE("Partial scores of streamed chromosomes")
+{
+    const size_t n_sample = 17;
+    const size_t n_snp = 48;
+    std::mt19937 mersenne_engine {57};
+    std::uniform_real_distribution<double> stat_dist {-1.0, 1.0};
+    auto sample_genotype =
+        random_genotype(n_sample, n_snp, mersenne_engine, false);
+    Reporter reporter("log", 60, true);
+    mock_binaryplink plink;
+    make_scored_plink(
+        plink, reporter, sample_genotype, "stream_score",
+        [&](const size_t i, const std::streampos byte) {
+            // 4 thresholds spread across 2 chromosomes, with one threshold
+            // only found on the first chromosome
+            const unsigned long long category = (i < 36) ? i % 3 : 3;
+            return SNP("rs" + std::to_string(i), 1 + (i % 2), i + 1, "A", "C",
+                       0, byte, stat_dist(mersenne_engine), 0.01, category,
+                       0.1 * static_cast<double>(category + 1));
+        });
+    plink.set_weight(MODEL::ADDITIVE);
+    CalculatePRS prs_info;
+    prs_info.missing_score =
+        GENERATE(MISSING_SCORE::MEAN_IMPUTE, MISSING_SCORE::SET_ZERO);
+    plink.set_prs_instruction(prs_info);
+    REQUIRE(plink.prepare_prsice());
+    std::vector<size_t> all, chr[2];
+    for (size_t i = 0; i < n_snp; ++i)
+    {
+        all.push_back(i);
+        chr[plink.existed_snps()[i].chr() - 1].push_back(i);
+    }
+    std::vector<PRSList> expected;
+    std::vector<uint32_t> expected_num_snp;
+    auto start = all.cbegin();
+    double threshold;
+    uint32_t num_snp = 0;
+    bool first_run = true;
+    while (plink.get_score(start, all.cend(), threshold, num_snp, first_run))
+    {
+        expected.push_back(plink.prs_info());
+        expected_num_snp.push_back(num_snp);
+        first_run = false;
+    }
+    PartialScores partial;
+    partial.open("partial_scores.tmp");
+    plink.add_partial_scores(chr[1], partial);
+    plink.add_partial_scores(chr[0], partial);
+    REQUIRE(partial.size() == expected.size());
+    // the cumulative sum of the partial scores is the score of each threshold
+    PRSList observed = plink.new_prs_list();
+    uint32_t observed_num_snp = 0;
+    size_t idx = 0;
+    for (auto&& score : partial.thresholds())
+    {
+        observed_num_snp += partial.add_to(score.first, observed);
+        REQUIRE(observed_num_snp == expected_num_snp[idx]);
+        for (size_t i = 0; i < n_sample; ++i)
+        {
+            REQUIRE(observed.score(i) == Approx(expected[idx].score(i)));
+            REQUIRE(observed.snp_count(i) == expected[idx].snp_count(i));
+        }
+        ++idx;
+    }
+    plink.set_stream_thresholds(partial);
+    REQUIRE(plink.get_set_thresholds().size() == 2);
+    REQUIRE(plink.num_threshold(0) == expected.size());
+}
+
+// regress the scores of each set against the phenotypes of pheno_idx in a
+// single pass and return the .prsice, .best and .summary output of each
+// phenotype. Competitive permutation is run if requested by perm
+std::vector<std::vector<std::string>>
+regress_phenotypes(mock_binaryplink& target, Reporter& reporter,
+                   const CalculatePRS& prs_info, const Phenotype& pheno_info,
+                   const std::vector<std::vector<size_t>>& membership,
+                   const std::vector<std::string>& names,
+                   const std::vector<size_t>& pheno_idx,
+                   const Permutations& perm = Permutations())
+{
+    const auto [max_fid, max_iid] = target.get_max_id_length();
+    std::vector<PhenoRun> runs;
+    for (auto&& i_pheno : pheno_idx)
+    {
+        PhenoRun run;
+        run.idx = i_pheno;
+        run.prevalence = 2;
+        run.name = pheno_info.pheno_col[i_pheno];
+        run.region_names = names;
+        run.prsice = std::make_unique<mock_prsice>(
+            prs_info, PThresholding(), perm, "single_pass",
+            pheno_info.binary[i_pheno], &reporter);
+        run.prsice->init_progress_count(target.get_set_thresholds());
+        run.prsice->hide_progress();
+        run.prsice->init_matrix(pheno_info, " ", i_pheno, target);
+        run.prsice_out = std::make_unique<std::stringstream>();
+        run.best_file = misc::load_ostream("single_pass." + run.name + ".best");
+        run.prsice->prep_best_output(target, membership, names, max_fid,
+                                     max_iid, run.best_file);
+        runs.push_back(std::move(run));
+    }
+    for (size_t i_region = 0; i_region < membership.size(); ++i_region)
+    {
+        if (i_region == 1) continue;
+        PRSice::run_prsice(membership[i_region], i_region, false, false, runs,
+                           target);
+    }
+    std::vector<std::vector<std::string>> output;
+    std::vector<size_t> significant_count = {0, 0, 0};
+    for (auto&& run : runs)
+    {
+        run.prsice->print_best(membership, std::move(run.best_file), target);
+        if (perm.run_set_perm)
+        {
+            run.prsice->run_competitive(target, membership[1].cbegin(),
+                                        membership[1].cend());
+        }
+        std::unique_ptr<std::ostream> summary =
+            std::make_unique<std::stringstream>();
+        run.prsice->print_summary(run.name, run.prevalence, false,
+                                  significant_count, summary);
+        std::ifstream best_file("single_pass." + run.name + ".best");
+        std::stringstream best;
+        best << best_file.rdbuf();
+        output.push_back(
+            {static_cast<std::stringstream&>(*run.prsice_out).str(),
+             best.str(), static_cast<std::stringstream&>(*summary).str()});
+    }
+    return output;
+}
+
+TEST_CASE("Phenotypes regressed in a single pass")
+{
+    const size_t n_sample = 80;
+    const size_t n_snp = 40;
+    std::mt19937 mersenne_engine {23};
+    std::normal_distribution<double> noise {0.0, 1.0};
+    std::uniform_real_distribution<double> stat_dist {-1.0, 1.0};
+    auto sample_genotype = random_genotype(n_sample, n_snp, mersenne_engine);
+    Reporter reporter("log", 60, true);
+    mock_binaryplink plink;
+    make_scored_plink(plink, reporter, sample_genotype, "single_pass",
+                      [&](const size_t i, const std::streampos byte) {
+                          // 8 thresholds
+                          const unsigned long long category = i / 5;
+                          SNP snp("rs" + std::to_string(i), 1, i + 1, "A", "C",
+                                  0, byte, stat_dist(mersenne_engine), 0.01,
+                                  category,
+                                  0.1 * static_cast<double>(category + 1));
+                          snp.get_flag() = std::vector<uintptr_t> {3};
+                          return snp;
+                      });
+    for (size_t i = 0; i < n_sample; ++i)
+    {
+        const std::string id = "S" + std::to_string(i);
+        plink.add_sample_id(Sample_ID(id, id, "NA", true));
+    }
+    // two quantitative and one binary phenotype, each missing in different
+    // samples so that the samples in the regression differ between them
+    std::ofstream pheno_file("single_pass.pheno");
+    pheno_file << "FID IID Q1 Q2 B1\n";
+    for (size_t i = 0; i < n_sample; ++i)
+    {
+        double dosage = 0;
+        for (size_t snp = 0; snp < n_snp / 2; ++snp)
+        {
+            const auto geno = sample_genotype[snp][i];
+            if (geno != 1) dosage += static_cast<double>(geno == 0 ? 2 : geno);
+        }
+        const double liability = 0.2 * dosage + noise(mersenne_engine);
+        const std::string id = "S" + std::to_string(i);
+        pheno_file << id << " " << id << " "
+                   << ((i % 7 == 0) ? "NA" : std::to_string(liability)) << " "
+                   << ((i % 5 == 0) ? "NA" : std::to_string(-liability)) << " "
+                   << ((i % 9 == 0) ? "NA" : (liability > 4 ? "1" : "0"))
+                   << "\n";
+    }
+    pheno_file.close();
+    Phenotype pheno_info;
+    pheno_info.pheno_file = "single_pass.pheno";
+    pheno_info.pheno_col = {"Q1", "Q2", "B1"};
+    pheno_info.pheno_col_idx = {2, 3, 4};
+    pheno_info.binary = {false, false, true};
+    plink.set_weight(MODEL::ADDITIVE);
+    CalculatePRS prs_info;
+    prs_info.thread = GENERATE(1, 3);
+    prs_info.regress_block = GENERATE(0, 3);
+    plink.set_prs_instruction(prs_info);
+    REQUIRE(plink.prepare_prsice());
+    std::ostringstream snp_out;
+    std::vector<std::string> names = {"Base", "Background"};
+    auto membership = plink.build_membership_matrix(2, names, false, snp_out);
+    std::vector<std::vector<std::string>> expected;
+    for (size_t i = 0; i < pheno_info.pheno_col.size(); ++i)
+    {
+        expected.push_back(regress_phenotypes(plink, reporter, prs_info,
+                                              pheno_info, membership, names,
+                                              {i})
+                               .front());
+    }
+    // the scores of each threshold are only calculated once and regressed
+    // against all phenotypes, which must not change the output
+    auto observed = regress_phenotypes(plink, reporter, prs_info, pheno_info,
+                                       membership, names, {0, 1, 2});
+    REQUIRE(observed == expected);
+    for (auto&& output : observed)
+    {
+        for (auto&& file : output) { REQUIRE_FALSE(file.empty()); }
+    }
+}
+
+TEST_CASE("Competitive permutation with multiple threads")
+{
+    const size_t n_sample = 60;
+    const size_t n_snp = 80;
+    std::mt19937 mersenne_engine {31};
+    std::normal_distribution<double> noise {0.0, 1.0};
+    std::uniform_real_distribution<double> stat_dist {-1.0, 1.0};
+    auto sample_genotype = random_genotype(n_sample, n_snp, mersenne_engine);
+    Reporter reporter("log", 60, true);
+    mock_binaryplink plink;
+    make_scored_plink(plink, reporter, sample_genotype, "competitive",
+                      [&](const size_t i, const std::streampos byte) {
+                          // 2 thresholds, with two sets in the background
+                          const unsigned long long category = i / 40;
+                          SNP snp("rs" + std::to_string(i), 1, i + 1, "A", "C",
+                                  0, byte, stat_dist(mersenne_engine), 0.01,
+                                  category,
+                                  0.1 * static_cast<double>(category + 1));
+                          uintptr_t flag = 3;
+                          if (i % 4 == 0) flag |= 1 << 2;
+                          if (i % 5 < 2) flag |= 1 << 3;
+                          snp.get_flag() = std::vector<uintptr_t> {flag};
+                          return snp;
+                      });
+    std::ofstream pheno_file("competitive.pheno");
+    pheno_file << "FID IID Q1\n";
+    for (size_t i = 0; i < n_sample; ++i)
+    {
+        const std::string id = "S" + std::to_string(i);
+        plink.add_sample_id(Sample_ID(id, id, "NA", true));
+        pheno_file << id << " " << id << " " << noise(mersenne_engine) << "\n";
+    }
+    pheno_file.close();
+    Phenotype pheno_info;
+    pheno_info.pheno_file = "competitive.pheno";
+    pheno_info.pheno_col = {"Q1"};
+    pheno_info.pheno_col_idx = {2};
+    pheno_info.binary = {false};
+    plink.set_weight(MODEL::ADDITIVE);
+    CalculatePRS prs_info;
+    plink.set_prs_instruction(prs_info);
+    REQUIRE(plink.prepare_prsice());
+    std::ostringstream snp_out;
+    std::vector<std::string> names = {"Base", "Background", "A", "B"};
+    auto membership = plink.build_membership_matrix(4, names, false, snp_out);
+    Permutations perm;
+    perm.run_set_perm = true;
+    perm.num_permutation = 101;
+    perm.seed = 1234;
+    auto expected = regress_phenotypes(plink, reporter, prs_info, pheno_info,
+                                       membership, names, {0}, perm);
+    // each permutation has its own seed, so the competitive p-values do not
+    // depend on the number of threads
+    prs_info.thread = GENERATE(2, 3, 8);
+    plink.set_prs_instruction(prs_info);
+    auto observed = regress_phenotypes(plink, reporter, prs_info, pheno_info,
+                                       membership, names, {0}, perm);
+    REQUIRE(observed == expected);
+    // the summary ends with the competitive p-value of each set
+    std::istringstream summary(observed.front().back());
+    std::string line;
+    size_t num_competitive = 0;
+    while (std::getline(summary, line))
+    {
+        auto token = misc::split(line, "\t");
+        if (token[1] == "Base") continue;
+        REQUIRE(token.back() != "NA");
+        ++num_competitive;
+    }
+    REQUIRE(num_competitive == 2);
+}
@@ -674,6 +674,19 @@ TEST_CASE("Clumping parameter loading")
         {
             REQUIRE_FALSE(commander.parse_command_wrapper("--clump-kb -100kb"));
         }
+        SECTION("clumping sweep")
+        {
+            REQUIRE(commander.parse_command_wrapper(
+                "--clump-kb 250,1mb --clump-r2 0.1,0.5 --clump-p 1"));
+            auto&& clump_info = commander.get_clump_info();
+            REQUIRE(clump_info.distance == 250000);
+            REQUIRE(clump_info.r2 == Approx(0.1));
+            REQUIRE_THAT(clump_info.sweep_distance,
+                         Catch::Equals<size_t>({250000, 1000000}));
+            REQUIRE_THAT(clump_info.sweep_r2,
+                         Catch::Approx<double>({0.1, 0.5}));
+            REQUIRE_THAT(clump_info.sweep_pvalue, Catch::Approx<double>({1}));
+        }
     }
 }
 
@@ -839,6 +852,8 @@ TEST_CASE("misc parameter loading")
         {
             REQUIRE(commander.parse_command_wrapper("--memory 1k"));
             REQUIRE(commander.memory() == 1024);
+            // provided memory is used when below the detected memory
+            REQUIRE(commander.max_memory(2048) == 1024);
         }
         SECTION("suffix gb")
         {
@@ -1121,6 +1136,29 @@ TEST_CASE("model parameter loading")
         REQUIRE(commander.get_prs_instruction().genetic_model
                 == MODEL::HETEROZYGOUS);
     }
+    SECTION("all")
+    {
+        REQUIRE(commander.parse_command_wrapper("--model all"));
+        REQUIRE(commander.get_prs_instruction().genetic_model
+                == MODEL::ADDITIVE);
+        REQUIRE(commander.get_prs_instruction().other_models
+                == std::vector<MODEL> {MODEL::DOMINANT, MODEL::RECESSIVE,
+                                       MODEL::HETEROZYGOUS});
+    }
+    SECTION("list")
+    {
+        REQUIRE(commander.parse_command_wrapper("--model rec,Add"));
+        REQUIRE(commander.get_prs_instruction().genetic_model
+                == MODEL::RECESSIVE);
+        REQUIRE(commander.get_prs_instruction().other_models
+                == std::vector<MODEL> {MODEL::ADDITIVE});
+    }
+    SECTION("invalid list")
+    {
+        auto model = GENERATE("add,add", "dom,xyz", ",");
+        REQUIRE_FALSE(
+            commander.parse_command_wrapper("--model " + std::string(model)));
+    }
 }
 
 TEST_CASE("Covariate parameter loading")
@@ -169,6 +169,35 @@ TEST_CASE("Thresholding validation")
     }
 }
 
+TEST_CASE("Score once validation")
+{
+    mockCommander commander;
+    REQUIRE(commander.parse_command_wrapper("--score-once"));
+    SECTION("standard score")
+    {
+        REQUIRE(commander.parse_command_wrapper("--binary-target T,F"));
+        REQUIRE(commander.prsice_check_wrapper());
+        REQUIRE(commander.score_once());
+    }
+    SECTION("con-std")
+    {
+        REQUIRE(commander.parse_command_wrapper("--score con-std"));
+        SECTION("quantitative traits")
+        {
+            REQUIRE(commander.parse_command_wrapper("--binary-target F,F"));
+            REQUIRE(commander.prsice_check_wrapper());
+            REQUIRE(commander.score_once());
+        }
+        SECTION("binary trait")
+        {
+            // score depends on the controls of each phenotype
+            REQUIRE(commander.parse_command_wrapper("--binary-target F,T"));
+            REQUIRE(commander.prsice_check_wrapper());
+            REQUIRE_FALSE(commander.score_once());
+        }
+    }
+}
+
 TEST_CASE("Clump")
 {
     mockCommander commander;
@@ -400,3 +400,28 @@ TEST_CASE("Add flag")
         }
     }
 }
+
+TEST_CASE("Genotype pool budget")
+{
+    const size_t words = GENERATE(1, 9, 64, 100);
+    const size_t rows = 4;
+    // enough for exactly two blocks
+    MemoryBudget budget(2 * rows * GenotypePool::row_size(words) + 1024);
+    GenotypePool pool(rows, words, &budget);
+    // the budget is charged with the same row size used to derive it
+    REQUIRE(pool.block_size() >= rows * GenotypePool::row_size(words));
+    REQUIRE(budget.used() == pool.block_size());
+    std::vector<IndividualGenotype*> allocated;
+    for (size_t i = 0; i < 2 * rows; ++i)
+    {
+        allocated.push_back(pool.alloc());
+        REQUIRE(allocated.back() != nullptr);
+    }
+    REQUIRE(budget.used() == 2 * pool.block_size());
+    // a third block would exceed the budget
+    REQUIRE(pool.alloc() == nullptr);
+    pool.free(allocated.back());
+    REQUIRE(pool.alloc() != nullptr);
+    // a pool must have at least one row
+    REQUIRE_THROWS(GenotypePool(0, words));
+}
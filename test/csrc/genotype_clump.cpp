@@ -499,9 +499,7 @@ TEST_CASE("R2 calculation")
             REQUIRE_THAT(res,
                          Catch::Equals<range>({range {0, 25}, range {25, 50}}));
         }
-        SECTION("Threaded clumping")
-        {
-            size_t threads = GENERATE(1, 2);
+        auto expected_clump = [&](const double r2_threshold) {
             std::vector<std::string> expected_remain;
             auto snp = geno.existed_snps();
             auto idx = geno.sorted_p_index();
@@ -531,11 +529,17 @@ TEST_CASE("R2 calculation")
                         auto second_idx = j < i ? cur_idx - first_idx - 1
                                                 : j - cur_start - first_idx - 1;
                         auto r2 = expected_r2[first_idx][second_idx];
-                        if (r2 >= clump_info.r2) { removed.insert(j); }
+                        if (r2 >= r2_threshold) { removed.insert(j); }
                     }
                 }
                 expected_remain.push_back(snp[i].rs());
             }
+            return expected_remain;
+        };
+        SECTION("Threaded clumping")
+        {
+            size_t threads = GENERATE(1, 2);
+            auto expected_remain = expected_clump(clump_info.r2);
             Genotype* geno_ptr = &geno;
             geno.clumping(clump_info, *geno_ptr, threads);
             auto res_snp = geno.existed_snps();
@@ -545,6 +549,241 @@ TEST_CASE("R2 calculation")
             REQUIRE_THAT(result,
                          Catch::UnorderedEquals<std::string>(expected_remain));
         }
+        SECTION("Clumping with limited memory")
+        {
+            size_t threads = GENERATE(1, 2);
+            auto expected_remain = expected_clump(clump_info.r2);
+            Genotype* geno_ptr = &geno;
+            // no memory left for the genotype pool, forcing eviction and
+            // re-reading of the genotypes
+            geno.clumping(clump_info, *geno_ptr, threads,
+                          misc::getCurrentRSS() + 1);
+            auto res_snp = geno.existed_snps();
+            std::vector<std::string> result;
+            for (auto&& snp : res_snp) { result.push_back(snp.rs()); }
+            REQUIRE_THAT(result,
+                         Catch::UnorderedEquals<std::string>(expected_remain));
+        }
+        SECTION("Clumping with streaming reader")
+        {
+            size_t threads = GENERATE(1, 2);
+            // without enough memory for the pairs, clumping falls back to
+            // reading the genotypes on demand
+            unsigned long long max_memory = GENERATE(0ULL, 1ULL);
+            clump_info.stream = true;
+            auto expected_remain = expected_clump(clump_info.r2);
+            Genotype* geno_ptr = &geno;
+            geno.clumping(clump_info, *geno_ptr, threads, max_memory);
+            std::vector<std::string> result;
+            for (auto&& snp : geno.existed_snps())
+            { result.push_back(snp.rs()); }
+            REQUIRE_THAT(result,
+                         Catch::UnorderedEquals<std::string>(expected_remain));
+        }
+        SECTION("Clumping with shared LD")
+        {
+            size_t threads = GENERATE(1, 2);
+            auto expected_remain = expected_clump(clump_info.r2);
+            Genotype* geno_ptr = &geno;
+            LDCache shared;
+            geno.build_ld_cache(clump_info, *geno_ptr, threads, shared);
+            REQUIRE(shared.num_snps() == geno.existed_snps().size());
+            geno.build_clump_windows(clump_info.distance);
+            geno.sort_by_p();
+            geno.clumping(clump_info, *geno_ptr, threads, 0, &shared);
+            std::vector<std::string> result;
+            for (auto&& snp : geno.existed_snps())
+            { result.push_back(snp.rs()); }
+            REQUIRE_THAT(result,
+                         Catch::UnorderedEquals<std::string>(expected_remain));
+            // shared cache is retained for the next base
+            REQUIRE(shared.num_snps() > 0);
+        }
+        SECTION("Clumping parameter sweep")
+        {
+            size_t threads = GENERATE(1, 2);
+            clump_info.sweep_r2 = {0.1, 0.5};
+            clump_info.sweep_distance = {10000000, 20000000};
+            clump_info.sweep_pvalue = {1};
+            std::unordered_map<std::string, std::vector<std::string>>
+                expected_remain;
+            for (auto&& r2 : clump_info.sweep_r2)
+            {
+                // all SNPs are within both windows
+                for (auto&& kb : {"10000", "20000"})
+                {
+                    expected_remain["r2-" + misc::to_string(r2) + "_kb-" + kb
+                                    + "_p-1"] = expected_clump(r2);
+                }
+            }
+            Genotype* geno_ptr = &geno;
+            geno.clump_sweep(clump_info, *geno_ptr, threads);
+            REQUIRE(geno.num_runs() == expected_remain.size());
+            for (size_t i = 0; i < geno.num_runs(); ++i)
+            {
+                const auto label = geno.select_run(i);
+                REQUIRE(expected_remain.find(label) != expected_remain.end());
+                std::vector<std::string> result;
+                for (auto&& snp : geno.existed_snps())
+                { result.push_back(snp.rs()); }
+                REQUIRE_THAT(result, Catch::UnorderedEquals<std::string>(
+                                         expected_remain[label]));
+            }
+        }
+        SECTION("Sweep matches separate clumping runs")
+        {
+            size_t threads = GENERATE(1, 2);
+            const std::vector<SNP> unclumped = geno.existed_snps();
+            Genotype* geno_ptr = &geno;
+            // thresholds at the R2 of actual pairs, where any difference in
+            // the R2 used by the sweep would change the result
+            LDCache cache;
+            geno.build_ld_cache(clump_info, *geno_ptr, threads, cache);
+            const auto cache_idx = cache.index_snps(unclumped);
+            clump_info.sweep_r2 = {clump_info.r2,
+                                   cache.r2(cache_idx[0], cache_idx[3]),
+                                   cache.r2(cache_idx[1], cache_idx[2])};
+            clump_info.sweep_distance = {3, 10000000};
+            clump_info.sweep_pvalue = {0.5, 1};
+            geno.existed_snps() = unclumped;
+            geno.clump_sweep(clump_info, *geno_ptr, threads);
+            std::vector<std::vector<std::string>> sweep_result;
+            for (size_t i = 0; i < geno.num_runs(); ++i)
+            {
+                geno.select_run(i);
+                std::vector<std::string> result;
+                for (auto&& snp : geno.existed_snps())
+                { result.push_back(snp.rs()); }
+                std::sort(result.begin(), result.end());
+                sweep_result.push_back(result);
+            }
+            // runs are ordered by distance, then R2, then p-value
+            size_t i_run = 0;
+            for (auto&& distance : clump_info.sweep_distance)
+            {
+                for (auto&& r2 : clump_info.sweep_r2)
+                {
+                    for (auto&& pvalue : clump_info.sweep_pvalue)
+                    {
+                        Clumping setting = clump_info;
+                        setting.r2 = r2;
+                        setting.distance = distance;
+                        setting.pvalue = pvalue;
+                        geno.existed_snps() = unclumped;
+                        geno.build_clump_windows(distance);
+                        geno.sort_by_p();
+                        geno.clumping(setting, *geno_ptr, threads);
+                        std::vector<std::string> result;
+                        for (auto&& snp : geno.existed_snps())
+                        { result.push_back(snp.rs()); }
+                        std::sort(result.begin(), result.end());
+                        REQUIRE_THAT(sweep_result.at(i_run++),
+                                     Catch::Equals<std::string>(result));
+                    }
+                }
+            }
+        }
+        SECTION("Clumping with LD cache")
+        {
+            size_t threads = GENERATE(1, 2);
+            clump_info.ld_cache_r2 = 0.05;
+            clump_info.ld_cache = "ld_check.ldcache";
+            clump_info.distance = 10000000;
+            std::remove(clump_info.ld_cache.c_str());
+            auto expected_remain = expected_clump(clump_info.r2);
+            auto snp = geno.existed_snps();
+            Genotype* geno_ptr = &geno;
+            // cache is generated on first use
+            geno.clumping(clump_info, *geno_ptr, threads);
+            auto res_snp = geno.existed_snps();
+            std::vector<std::string> result;
+            for (auto&& s : res_snp) { result.push_back(s.rs()); }
+            REQUIRE_THAT(result,
+                         Catch::UnorderedEquals<std::string>(expected_remain));
+            // the stored R2 should match the genotype
+            LDCache cache;
+            const auto key = geno.get_ld_cache_key(clump_info.distance);
+            REQUIRE(cache.load(clump_info.ld_cache, key, clump_info.r2));
+            auto cache_idx = cache.index_snps(snp);
+            REQUIRE(cache.num_snps() == file_output.size());
+            for (size_t i = 0; i < dummy_input.size(); ++i)
+            {
+                for (size_t j = i + 1; j < dummy_input.size(); ++j)
+                {
+                    auto expected = expected_r2[i][j - i - 1];
+                    // the expected R2 are rounded, pairs around the floor
+                    // can be either stored or not
+                    if (std::fabs(expected - cache.r2_floor()) < 1e-5)
+                        continue;
+                    if (expected < cache.r2_floor()) expected = 0;
+                    // snp is sorted by coordinate, so i and j are the index
+                    // on chromosome 1, and i + 25 / j + 25 on chromosome 2
+                    REQUIRE(cache.r2(cache_idx[i], cache_idx[j])
+                            == Approx(expected).margin(1e-5));
+                    REQUIRE(cache.r2(cache_idx[j + dummy_input.size()],
+                                     cache_idx[i + dummy_input.size()])
+                            == Approx(expected).margin(1e-5));
+                }
+            }
+            // cache cannot serve a R2 threshold lower than its floor
+            REQUIRE_FALSE(
+                cache.load(clump_info.ld_cache, key, cache.r2_floor() / 2));
+            // nor a different window
+            REQUIRE_FALSE(cache.load(clump_info.ld_cache,
+                                     geno.get_ld_cache_key(1000), 0.1));
+            std::remove(clump_info.ld_cache.c_str());
+        }
+        SECTION("Pair at the R2 threshold")
+        {
+            size_t threads = GENERATE(1, 2);
+            // make rs0 the first index SNP, so that whether rs3 is clumped
+            // only depends on their R2 (~0.92), which no other pair of rs3
+            // is close to
+            snps[0] = SNP("rs0", 1, 0, "A", "C", 1.96, 1e-10, 0, 0);
+            snps[0].update_file(0, 3, true);
+            const std::vector<SNP> unclumped = geno.existed_snps();
+            LDCache cache;
+            Genotype* geno_ptr = &geno;
+            geno.build_ld_cache(clump_info, *geno_ptr, threads, cache);
+            const auto cache_idx = cache.index_snps(unclumped);
+            const double boundary = cache.r2(cache_idx[0], cache_idx[3]);
+            REQUIRE(boundary == Approx(0.922339).margin(1e-5));
+            auto clump_with = [&](const double r2, const bool stream,
+                                  const std::string& ld_cache) {
+                geno.existed_snps() = unclumped;
+                geno.build_clump_windows(clump_info.distance);
+                geno.sort_by_p();
+                Clumping setting = clump_info;
+                setting.r2 = r2;
+                setting.stream = stream;
+                setting.ld_cache = ld_cache;
+                geno.clumping(setting, *geno_ptr, threads);
+                std::vector<std::string> result;
+                for (auto&& snp : geno.existed_snps())
+                { result.push_back(snp.rs()); }
+                std::sort(result.begin(), result.end());
+                return result;
+            };
+            const std::string cache_name = "ld_boundary.ldcache";
+            for (auto&& r2 : {boundary, std::nextafter(boundary, 1.0)})
+            {
+                std::remove(cache_name.c_str());
+                const auto direct = clump_with(r2, false, "");
+                const bool rs3_clumped =
+                    std::find(direct.begin(), direct.end(), "rs3")
+                    == direct.end();
+                // pair with R2 equal to the threshold is clumped
+                REQUIRE(rs3_clumped == (r2 == boundary));
+                REQUIRE_THAT(clump_with(r2, true, ""),
+                             Catch::Equals<std::string>(direct));
+                // generate the cache file, then clump using it
+                REQUIRE_THAT(clump_with(r2, false, cache_name),
+                             Catch::Equals<std::string>(direct));
+                REQUIRE_THAT(clump_with(r2, false, cache_name),
+                             Catch::Equals<std::string>(direct));
+            }
+            std::remove(cache_name.c_str());
+        }
     }
     SECTION("Test R2 calculation")
     {
@@ -644,3 +883,209 @@ TEST_CASE("R2 calculation")
         }
     }
 }
+
+TEST_CASE("Malformed LD cache")
+{
+    const std::vector<SNP> snps = {SNP("rs1", 1, 10, "A", "C", 0, 0.01, 0, 0),
+                                   SNP("rs2", 1, 20, "A", "C", 0, 0.2, 0, 0)};
+    const uint64_t key = 42;
+    const std::string name = "malformed.ldcache";
+    LDCache cache;
+    cache.reset(key, 0.1, snps);
+    cache.add(0, 1, 0.5);
+    cache.save(name);
+    std::string content;
+    {
+        std::ifstream in(name.c_str(), std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+    }
+    LDCache loaded;
+    REQUIRE(loaded.load(name, key, 0.1));
+    REQUIRE(loaded.r2(0, 1) == 0.5);
+    // counts larger than the file are rejected before allocation
+    auto corrupt = [&](const size_t offset, const auto value) {
+        std::string modified = content;
+        std::memcpy(&modified[offset], &value, sizeof(value));
+        std::ofstream out(name.c_str(), std::ios::binary);
+        out << modified;
+    };
+    // magic, key and floor precede the number of variants
+    const size_t num_snp_offset = 8 + sizeof(uint64_t) + sizeof(double);
+    SECTION("number of variants")
+    {
+        corrupt(num_snp_offset, uint64_t(1) << 60);
+        REQUIRE_THROWS(loaded.load(name, key, 0.1));
+    }
+    SECTION("ID length")
+    {
+        corrupt(num_snp_offset + 3 * sizeof(uint64_t), ~uint32_t(0));
+        REQUIRE_THROWS(loaded.load(name, key, 0.1));
+    }
+    SECTION("number of partners")
+    {
+        // partner count of the first variant follows the variant records
+        const size_t offset = num_snp_offset + sizeof(uint64_t)
+                              + 2 * (2 * sizeof(uint64_t) + sizeof(uint32_t))
+                              + 6;
+        corrupt(offset, ~uint32_t(0));
+        REQUIRE_THROWS(loaded.load(name, key, 0.1));
+    }
+    std::remove(name.c_str());
+}
+
+TEST_CASE("Clump cache")
+{
+    mockGenotype geno;
+    Reporter reporter("log", 60, true);
+    geno.set_reporter(&reporter);
+    std::vector<SNP> input = {SNP("rs1", 1, 10, "A", "C", 0, 0.01, 0, 0),
+                              SNP("rs2", 1, 20, "A", "C", 0, 0.2, 0, 0),
+                              SNP("rs3", 1, 30, "A", "C", 0, 0.03, 0, 0),
+                              SNP("rs4", 2, 10, "A", "C", 0, 0.4, 0, 0)};
+    for (auto&& snp : input)
+    {
+        snp.get_flag() = std::vector<uintptr_t> {7};
+        geno.load_snp(snp);
+    }
+    Clumping clump_info;
+    const auto key = geno.clump_cache_key(clump_info, geno);
+    // key should depend on the clumping parameters
+    clump_info.r2 = 0.2;
+    REQUIRE(key != geno.clump_cache_key(clump_info, geno));
+    clump_info.r2 = 0.1;
+    REQUIRE(key == geno.clump_cache_key(clump_info, geno));
+    // generate the clumped result
+    mockGenotype clumped;
+    clumped.set_reporter(&reporter);
+    clumped.load_snp(input[2]);
+    clumped.load_snp(input[0]);
+    clumped.modify_existed_snps()[0].get_flag() = std::vector<uintptr_t> {5};
+    clumped.modify_existed_snps()[1].get_flag() = std::vector<uintptr_t> {2};
+    const std::string cache_name = "clump_check.cache";
+    clumped.save_clump_cache(cache_name, key);
+    SECTION("mismatched key")
+    {
+        REQUIRE_FALSE(geno.load_clump_cache(cache_name, key + 1));
+        REQUIRE(geno.existed_snps().size() == input.size());
+    }
+    SECTION("matched key")
+    {
+        REQUIRE(geno.load_clump_cache(cache_name, key));
+        auto res = geno.existed_snps();
+        REQUIRE(res.size() == 2);
+        REQUIRE(res[0].rs() == "rs1");
+        REQUIRE(res[0].clumped());
+        REQUIRE(res[0].get_flag() == std::vector<uintptr_t> {2});
+        REQUIRE(res[1].rs() == "rs3");
+        REQUIRE(res[1].get_flag() == std::vector<uintptr_t> {5});
+    }
+    SECTION("variant not found")
+    {
+        mockGenotype other;
+        other.set_reporter(&reporter);
+        other.load_snp(input[0]);
+        REQUIRE_FALSE(other.load_clump_cache(cache_name, key));
+        REQUIRE(other.existed_snps().size() == 1);
+    }
+    std::remove(cache_name.c_str());
+}
+
+TEST_CASE("Merge variants of multiple base")
+{
+    Reporter reporter("log", 60, true);
+    mockGenotype first, second, merged;
+    first.set_reporter(&reporter);
+    second.set_reporter(&reporter);
+    merged.set_reporter(&reporter);
+    first.load_snp(SNP("rs1", 1, 10, "A", "C", 0, 0.01, 0, 0));
+    first.load_snp(SNP("rs2", 1, 20, "A", "C", 0, 0.2, 0, 0));
+    second.load_snp(SNP("rs2", 1, 20, "A", "C", 0, 0.5, 0, 0));
+    second.load_snp(SNP("rs3", 1, 30, "A", "C", 0, 0.03, 0, 0));
+    merged.merge_snps(first);
+    merged.merge_snps(second);
+    std::vector<std::string> rs;
+    for (auto&& snp : merged.existed_snps()) { rs.push_back(snp.rs()); }
+    REQUIRE_THAT(rs, Catch::Equals<std::string>({"rs1", "rs2", "rs3"}));
+    // the first base take precedence
+    REQUIRE(merged.existed_snps()[1].p_value() == Approx(0.2));
+    // rs1 removed by QC, rs2 given counts
+    auto&& merged_snps = merged.modify_existed_snps();
+    merged_snps.erase(merged_snps.begin());
+    merged.modify_existed_snps()[0].set_counts(10, 20, 30, 1, false);
+    second.sync_snps(merged);
+    REQUIRE(second.existed_snps().size() == 2);
+    first.sync_snps(merged);
+    REQUIRE(first.existed_snps().size() == 1);
+    auto&& snp = first.existed_snps().front();
+    REQUIRE(snp.rs() == "rs2");
+    // base specific information is kept
+    REQUIRE(snp.p_value() == Approx(0.2));
+    uint32_t homcom, het, homrar, missing;
+    REQUIRE(snp.get_counts(homcom, het, homrar, missing, false));
+    REQUIRE(homcom == 10);
+    REQUIRE(het == 20);
+    REQUIRE(homrar == 30);
+    REQUIRE(missing == 1);
+}
+
+TEST_CASE("Runs of multiple base")
+{
+    Reporter reporter("log", 60, true);
+    mockGenotype merged, second, work;
+    merged.set_reporter(&reporter);
+    second.set_reporter(&reporter);
+    merged.load_snp(SNP("rs1", 1, 10, "A", "C", 0, 0.01, 0, 0));
+    merged.load_snp(SNP("rs2", 1, 20, "A", "C", 0, 0.2, 0, 0));
+    second.load_snp(SNP("rs3", 1, 30, "A", "C", 0, 0.03, 0, 0));
+    // variants of the genotype itself are copied
+    merged.add_run("first", merged);
+    REQUIRE(merged.existed_snps().size() == 2);
+    merged.merge_snps(second);
+    merged.add_run("second", second);
+    REQUIRE(second.existed_snps().empty());
+    REQUIRE(merged.num_runs() == 2);
+    REQUIRE(merged.existed_snps().size() == 3);
+    // a run can be processed by another genotype and put back
+    merged.swap_run(0, work);
+    REQUIRE(work.existed_snps().size() == 2);
+    work.modify_existed_snps().pop_back();
+    merged.swap_run(0, work);
+    REQUIRE(work.existed_snps().empty());
+    REQUIRE(merged.select_run(0) == "first");
+    REQUIRE(merged.existed_snps().size() == 1);
+    REQUIRE(merged.existed_snps().front().rs() == "rs1");
+    REQUIRE(merged.select_run(1) == "second");
+    REQUIRE(merged.existed_snps().front().rs() == "rs3");
+}
+
+TEST_CASE("LD sample subset")
+{
+    const size_t n_sample = 250;
+    mock_binaryplink geno;
+    Reporter reporter("log", 60, true);
+    geno.set_reporter(&reporter);
+    geno.set_sample(n_sample);
+    geno.init_sample_vectors();
+    std::vector<bool> founder(n_sample, false);
+    std::fill(founder.begin() + n_sample - 100, founder.end(), true);
+    geno.set_founder_vector(founder);
+    geno.test_post_sample_read_init();
+    const auto full = geno.sample_for_ld();
+    const size_t subset_size = GENERATE(1, 30, 99);
+    geno.subset_ld_samples(subset_size, 42);
+    auto subset = geno.sample_for_ld();
+    REQUIRE(popcount_longs(subset.data(), subset.size()) == subset_size);
+    // only founders can be selected
+    for (size_t i = 0; i < subset.size(); ++i)
+    { REQUIRE((subset[i] & ~full[i]) == 0); }
+    geno.restore_ld_samples();
+    REQUIRE(geno.sample_for_ld() == full);
+    // selection is reproducible with the same seed
+    geno.subset_ld_samples(subset_size, 42);
+    REQUIRE(geno.sample_for_ld() == subset);
+    geno.restore_ld_samples();
+    // no subsetting when more samples are requested than available
+    geno.subset_ld_samples(100, 42);
+    REQUIRE(geno.sample_for_ld() == full);
+}
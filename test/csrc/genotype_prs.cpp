@@ -206,7 +206,7 @@ TEST_CASE("Read_PRS")
     }
     std::vector<double> observed_prs(num_selected);
     std::vector<size_t> observed_num(num_selected);
-    std::vector<PRS> observed(num_selected, PRS());
+    PRSList observed(num_selected);
     const bool not_first = true;
 
     geno.test_read_prs(genotype_data.data(), observed, ploidy, stat, adj_score,
@@ -214,8 +214,8 @@ TEST_CASE("Read_PRS")
                        homrar_weight, !not_first);
     for (size_t i = 0; i < num_selected; ++i)
     {
-        observed_prs[i] = observed[i].prs;
-        observed_num[i] = observed[i].num_snp;
+        observed_prs[i] = observed.prs[i];
+        observed_num[i] = observed.snp_count(i);
     }
 
     REQUIRE_THAT(observed_prs, Catch::Equals<double>(expected_prs));
@@ -227,8 +227,8 @@ TEST_CASE("Read_PRS")
                            het_weight, homrar_weight, !not_first);
         for (size_t i = 0; i < num_selected; ++i)
         {
-            observed_prs[i] = observed[i].prs;
-            observed_num[i] = observed[i].num_snp;
+            observed_prs[i] = observed.prs[i];
+            observed_num[i] = observed.snp_count(i);
         }
         REQUIRE_THAT(observed_prs, Catch::Equals<double>(expected_prs));
         REQUIRE_THAT(observed_num, Catch::Equals<size_t>(expected_num));
@@ -241,8 +241,8 @@ TEST_CASE("Read_PRS")
                            het_weight, homrar_weight, not_first);
         for (size_t i = 0; i < num_selected; ++i)
         {
-            observed_prs[i] = observed[i].prs;
-            observed_num[i] = observed[i].num_snp;
+            observed_prs[i] = observed.prs[i];
+            observed_num[i] = observed.snp_count(i);
             expected_prs[i] = 2 * expected_prs[i];
             expected_num[i] = 2 * expected_num[i];
         }
@@ -250,3 +250,103 @@ TEST_CASE("Read_PRS")
         REQUIRE_THAT(observed_num, Catch::Equals<size_t>(expected_num));
     }
 }
+
+TEST_CASE("Hard coded scoring policy")
+{
+    Reporter reporter("log", 60, true);
+    mockGenotype geno;
+    geno.set_reporter(&reporter);
+    geno.set_weight(MODEL::ADDITIVE);
+    const size_t num_sample = 7;
+    geno.set_sample_vector(num_sample);
+    // PLINK encoding of homcom, het, missing, homrar, homcom, het, homrar
+    const std::vector<uintptr_t> codes = {3, 2, 1, 0, 3, 2, 0};
+    std::vector<uintptr_t> genotype_data(2, 0);
+    for (size_t i = 0; i < num_sample; ++i)
+    { genotype_data[0] |= codes[i] << (2 * i); }
+    SNP snp("rs1", 1, 123, "A", "G", 0.5, 0.05, 0, 0.05);
+    PRSList observed(num_sample);
+    // 3 homcom, 2 het and 1 homrar
+    const uint32_t homcom_ct = 3, het_ct = 2, homrar_ct = 1;
+    auto check = [&](const std::vector<double>& table,
+                     const std::vector<size_t>& count) {
+        for (size_t i = 0; i < num_sample; ++i)
+        {
+            // bitwise not of the PLINK encoding
+            const size_t geno_idx = 3 - codes[i];
+            REQUIRE(observed.prs[i] == Approx(table[geno_idx]));
+            REQUIRE(observed.snp_count(i) == count[geno_idx]);
+        }
+    };
+    SECTION("centre")
+    {
+        // 1 - (2 + 2) / 12
+        const double maf = 2.0 / 3.0;
+        geno.test_add_hard_coded_prs<MISSING_SCORE::CENTER>(
+            genotype_data.data(), observed, snp, homcom_ct, het_ct, homrar_ct,
+            false);
+        const double adj = 2 * 0.5 * maf;
+        check({-adj, 0.5 - adj, 0, 1 - adj}, {2, 2, 2, 2});
+    }
+    SECTION("centre flipped")
+    {
+        const SNP src = snp;
+        snp.add_snp_info(src, true, false);
+        // 1 - (6 + 2) / 12
+        const double maf = 1.0 / 3.0;
+        geno.test_add_hard_coded_prs<MISSING_SCORE::CENTER>(
+            genotype_data.data(), observed, snp, homcom_ct, het_ct, homrar_ct,
+            false);
+        const double adj = 2 * 0.5 * maf;
+        check({1 - adj, 0.5 - adj, 0, -adj}, {2, 2, 2, 2});
+    }
+    SECTION("mean impute")
+    {
+        geno.test_add_hard_coded_prs<MISSING_SCORE::MEAN_IMPUTE>(
+            genotype_data.data(), observed, snp, homcom_ct, het_ct, homrar_ct,
+            false);
+        check({0, 0.5, 2 * 0.5 * 2.0 / 3.0, 1}, {2, 2, 2, 2});
+    }
+    SECTION("set zero")
+    {
+        geno.test_add_hard_coded_prs<MISSING_SCORE::SET_ZERO>(
+            genotype_data.data(), observed, snp, homcom_ct, het_ct, homrar_ct,
+            false);
+        check({0, 0.5, 0, 1}, {2, 2, 0, 2});
+        // accumulate on subsequent variants
+        geno.test_add_hard_coded_prs<MISSING_SCORE::SET_ZERO>(
+            genotype_data.data(), observed, snp, homcom_ct, het_ct, homrar_ct,
+            true);
+        check({0, 1, 0, 2}, {4, 4, 0, 4});
+    }
+}
+
+TEST_CASE("Missing allele count")
+{
+    const size_t num_sample = 64;
+    std::mt19937 mersenne_engine {5};
+    std::uniform_int_distribution<size_t> sample_dist {0, num_sample - 1};
+    // few missing samples are listed, many are counted for every sample
+    const size_t num_missing = GENERATE(3ul, 40ul);
+    PRSList first(num_sample), second(num_sample), total(num_sample);
+    std::vector<size_t> expected(num_sample, 0);
+    first.num_snp = second.num_snp = 10;
+    for (size_t i = 0; i < num_missing; ++i)
+    {
+        const size_t a = sample_dist(mersenne_engine);
+        const size_t b = sample_dist(mersenne_engine);
+        first.add_missing(a, 2);
+        second.add_missing(b, 1);
+        expected[a] += 2;
+        expected[b] += 1;
+    }
+    REQUIRE(first.num_miss.dense.empty() == (num_missing == 3));
+    total.add(first);
+    total.add(second);
+    REQUIRE(total.num_snp == 20);
+    for (size_t i = 0; i < num_sample; ++i)
+    { REQUIRE(total.snp_count(i) == 20 - expected[i]); }
+    total.reset();
+    REQUIRE(total.num_miss.empty());
+    REQUIRE(total.snp_count(0) == 0);
+}
@@ -57,3 +57,93 @@ TEST_CASE("Initialize progress bar")
     REQUIRE(ad == 0);
     REQUIRE(cd == 0);
 }
+
+TEST_CASE("Covariate projected regression")
+{
+    const Eigen::Index n = 200;
+    const Eigen::Index num_cov = GENERATE(0, 1, 4);
+    std::mt19937 mersenne_engine {11};
+    std::normal_distribution<double> dist(0.0, 1.0);
+    auto random = [&]() { return dist(mersenne_engine); };
+    // intercept, score and covariates, same layout as PRSice
+    Eigen::MatrixXd X = Eigen::MatrixXd::Ones(n, 2 + num_cov);
+    for (Eigen::Index i = 0; i < n; ++i)
+    {
+        for (Eigen::Index c = 2; c < X.cols(); ++c) { X(i, c) = random(); }
+    }
+    Eigen::VectorXd y(n);
+    for (Eigen::Index i = 0; i < n; ++i)
+    { y(i) = 0.5 + 0.3 * X(i, X.cols() - 1) + random(); }
+    Regression::CovariateProjection projection(y, X, 1);
+    for (size_t score = 0; score < 5; ++score)
+    {
+        for (Eigen::Index i = 0; i < n; ++i)
+        {
+            X(i, 1) = random() + 0.2 * y(i) * static_cast<double>(score);
+        }
+        double p, r2, r2_adjust, coeff, se;
+        double exp_p, exp_r2, exp_r2_adjust, exp_coeff, exp_se;
+        REQUIRE(projection.fit(X.col(1), p, r2, r2_adjust, coeff, se));
+        Regression::fastLm(y, X, exp_p, exp_r2, exp_r2_adjust, exp_coeff,
+                           exp_se, 1, true);
+        REQUIRE(coeff == Approx(exp_coeff));
+        REQUIRE(se == Approx(exp_se));
+        REQUIRE(r2 == Approx(exp_r2));
+        REQUIRE(r2_adjust == Approx(exp_r2_adjust));
+        REQUIRE(p == Approx(exp_p));
+    }
+    SECTION("score collinear with covariates")
+    {
+        X.col(1).setConstant(3.0);
+        double p, r2, r2_adjust, coeff, se;
+        REQUIRE_FALSE(projection.fit(X.col(1), p, r2, r2_adjust, coeff, se));
+    }
+    SECTION("rank deficient covariates")
+    {
+        // add a covariate without any variation
+        Eigen::MatrixXd with_empty(n, X.cols() + 1);
+        with_empty << X, Eigen::VectorXd::Zero(n);
+        Regression::CovariateProjection deficient(y, with_empty, 1);
+        double p, r2, r2_adjust, coeff, se;
+        REQUIRE_FALSE(deficient.fit(X.col(1), p, r2, r2_adjust, coeff, se));
+    }
+}
+
+TEST_CASE("Block of scores regressed together")
+{
+    const Eigen::Index n = 150, num_scores = 6;
+    std::mt19937 mersenne_engine {17};
+    std::normal_distribution<double> dist(0.0, 1.0);
+    auto random = [&]() { return dist(mersenne_engine); };
+    Eigen::MatrixXd X = Eigen::MatrixXd::Ones(n, 4);
+    Eigen::VectorXd y(n);
+    Eigen::MatrixXd scores(n, num_scores);
+    for (Eigen::Index i = 0; i < n; ++i)
+    {
+        X(i, 2) = random();
+        X(i, 3) = random();
+        y(i) = 1.0 - 0.4 * X(i, 2) + random();
+        for (Eigen::Index s = 0; s < num_scores; ++s)
+        { scores(i, s) = random() + 0.1 * static_cast<double>(s) * y(i); }
+    }
+    // a score without any variation cannot be fitted
+    scores.col(num_scores - 1).setConstant(2.0);
+    Regression::CovariateProjection projection(y, X, 1);
+    REQUIRE(projection.valid());
+    Eigen::VectorXd p, r2, r2_adjust, coeff, se;
+    auto fitted = projection.fit_block(scores, p, r2, r2_adjust, coeff, se);
+    REQUIRE(fitted.size() == static_cast<size_t>(num_scores));
+    REQUIRE_FALSE(fitted.back());
+    for (Eigen::Index s = 0; s < num_scores - 1; ++s)
+    {
+        REQUIRE(fitted[static_cast<size_t>(s)]);
+        double exp_p, exp_r2, exp_r2_adjust, exp_coeff, exp_se;
+        REQUIRE(projection.fit(scores.col(s), exp_p, exp_r2, exp_r2_adjust,
+                               exp_coeff, exp_se));
+        REQUIRE(coeff(s) == Approx(exp_coeff));
+        REQUIRE(se(s) == Approx(exp_se));
+        REQUIRE(r2(s) == Approx(exp_r2));
+        REQUIRE(r2_adjust(s) == Approx(exp_r2_adjust));
+        REQUIRE(p(s) == Approx(exp_p));
+    }
+}
@@ -42,6 +42,12 @@ public:
         post_sample_read_init();
     }
 
+    // update_sample leaves the number of samples used for scoring at zero
+    void set_sample_ct(uintptr_t sample_ct)
+    {
+        m_sample_ct = sample_ct;
+        post_sample_read_init();
+    }
     void set_founder_vector(const std::vector<bool>& founder)
     {
         m_founder_ct = 0;
@@ -57,14 +63,14 @@ public:
     void test_read_genotype(const SNP& snp, const uintptr_t sample_size,
                             uintptr_t* genotype, bool is_ref)
     {
-        read_genotype(snp, sample_size, m_genotype_file, m_tmp_genotype.data(),
-                      genotype, m_sample_for_ld.data(), is_ref);
+        read_genotype(snp, sample_size, m_cursor, genotype,
+                      m_sample_for_ld.data(), is_ref);
     }
     void set_hard_code(bool hard_coded) { m_hard_coded = hard_coded; }
     void test_read_genotype(uintptr_t* genotype, SNP& snp)
     {
-        read_genotype(snp, m_founder_ct, m_genotype_file, m_tmp_genotype.data(),
-                      genotype, m_sample_for_ld.data(), true);
+        read_genotype(snp, m_founder_ct, m_cursor, genotype,
+                      m_sample_for_ld.data(), true);
     }
     void add_select_sample(const std::string& in)
     {
@@ -129,14 +135,16 @@ public:
                          const std::streampos& bytepos)
     {
         auto cur_idx = 0ul;
-        PLINK_generator setter(m_calculate_prs.data(), m_tmp_genotype.data(),
-                               m_hard_threshold, m_dose_threshold);
+        PLINK_generator setter(m_calculate_prs.data(),
+                               m_cursor.tmp_genotype.data(), m_hard_threshold,
+                               m_dose_threshold);
         // we use tellg to get the location of the variant info, so don't need
         // to do offset jump
         bgen_file->seekg(bytepos);
         // bgen_file->seekg(offset + 4);
         genfile::bgen::read_and_parse_genotype_data_block<PLINK_generator>(
-            *bgen_file, m_context_map[cur_idx], setter, &m_buffer1, &m_buffer2);
+            *bgen_file, m_context_map[cur_idx], setter, &m_cursor.buffer1,
+            &m_cursor.buffer2);
         AlleleCounts ct;
         setter.get_count(ct.homcom, ct.het, ct.homrar, ct.missing);
         double impute = setter.info_score(INFO::IMPUTE2);
@@ -281,6 +289,16 @@ public:
         m_existed_snps.emplace_back(cur);
     }
     std::vector<SNP> existed_snps() const { return m_existed_snps; }
+    const PRSList& prs_info() const { return m_prs_info; }
+    void set_gemm_min_density(const double density)
+    {
+        m_gemm_min_density = density;
+    }
+    size_t num_cached_scores(const size_t set_idx) const
+    {
+        auto res = m_set_scores.find(set_idx);
+        return (res == m_set_scores.end()) ? 0 : res->second.size();
+    }
     std::vector<std::string> genotype_file_names() const
     {
         return m_genotype_file_names;
@@ -17,6 +17,7 @@ public:
     std::vector<uintptr_t> sample_for_ld() const { return m_sample_for_ld; }
     std::vector<uintptr_t> calculate_prs() const { return m_calculate_prs; }
     std::vector<Sample_ID> sample_id() const { return m_sample_id; }
+    void add_sample_id(const Sample_ID& id) { m_sample_id.push_back(id); }
     void test_check_bed(const std::string& bed_name, size_t num_marker,
                         uintptr_t& bed_offset)
     {
@@ -36,7 +37,32 @@ public:
         return get_chrom_boundary();
     }
     std::vector<size_t> sorted_p_index() { return m_sort_by_p_index; }
+    uint64_t get_ld_cache_key(const size_t distance) const
+    {
+        return ld_cache_key(distance);
+    }
     std::vector<SNP>& existed_snps() { return m_existed_snps; }
+    const PRSList& prs_info() const { return m_prs_info; }
+    void set_gemm_min_density(const double density)
+    {
+        m_gemm_min_density = density;
+    }
+    size_t num_cached_scores(const size_t set_idx) const
+    {
+        auto res = m_set_scores.find(set_idx);
+        return (res == m_set_scores.end()) ? 0 : res->second.size();
+    }
+    void test_read_score(const std::vector<size_t>& index, bool reset_zero)
+    {
+        Genotype::read_score(index.cbegin(), index.cend(), reset_zero);
+    }
+    PRSList test_cursor_score(const std::vector<size_t>& index)
+    {
+        GenotypeCursor cursor = new_cursor();
+        PRSList prs_list = new_prs_list();
+        read_score(prs_list, index.cbegin(), index.cend(), true, cursor);
+        return prs_list;
+    }
     void set_sample(uintptr_t n_sample) { m_unfiltered_sample_ct = n_sample; }
     void set_reporter(Reporter* reporter) { m_reporter = reporter; }
     void test_post_sample_read_init() { post_sample_read_init(); }
@@ -58,13 +84,13 @@ public:
     }
     void test_read_genotype(const SNP& snp, uintptr_t* genotype, bool is_ref)
     {
-        read_genotype(snp, m_founder_ct, m_genotype_file, m_tmp_genotype.data(),
-                      genotype, m_sample_for_ld.data(), is_ref);
+        read_genotype(snp, m_founder_ct, m_cursor, genotype,
+                      m_sample_for_ld.data(), is_ref);
     }
     void test_read_genotype(uintptr_t* genotype, SNP& snp)
     {
-        read_genotype(snp, m_founder_ct, m_genotype_file, m_tmp_genotype.data(),
-                      genotype, m_sample_for_ld.data());
+        read_genotype(snp, m_founder_ct, m_cursor, genotype,
+                      m_sample_for_ld.data());
     }
     void gen_fake_bed_from_int(const std::vector<std::vector<uintptr_t>>& geno,
                                const std::string& name,
@@ -276,12 +302,14 @@ public:
             switch (geno[i])
             {
             case 0: break;
-            case 1: SET_BIT(geno_idx + 1, m_tmp_genotype.data()); break;
+            case 1:
+                SET_BIT(geno_idx + 1, m_cursor.tmp_genotype.data());
+                break;
             case 2:
-                SET_BIT(geno_idx, m_tmp_genotype.data());
-                SET_BIT(geno_idx + 1, m_tmp_genotype.data());
+                SET_BIT(geno_idx, m_cursor.tmp_genotype.data());
+                SET_BIT(geno_idx + 1, m_cursor.tmp_genotype.data());
                 break;
-            case 3: SET_BIT(geno_idx, m_tmp_genotype.data()); break;
+            case 3: SET_BIT(geno_idx, m_cursor.tmp_genotype.data()); break;
             }
             geno_idx += 2;
         }
@@ -289,7 +317,7 @@ public:
             BITCT_TO_WORDCT(m_unfiltered_sample_ct);
         const uintptr_t unfiltered_sample_ctv2 = 2 * unfiltered_sample_ctl;
         return single_marker_freqs_and_hwe(
-            unfiltered_sample_ctv2, m_tmp_genotype.data(),
+            unfiltered_sample_ctv2, m_cursor.tmp_genotype.data(),
             m_sample_include2.data(), m_founder_include2.data(), m_sample_ct,
             ll_ctp, lh_ctp, hh_ctp, m_founder_ct, ll_ctfp, lh_ctfp, hh_ctfp);
     }
@@ -323,7 +323,7 @@ public:
     }
     void set_very_small_thresholds() { m_very_small_thresholds = true; }
     std::vector<uintptr_t>& std_exclusion_flag() { return m_exclude_from_std; }
-    void test_read_prs(uintptr_t* genotype, std::vector<PRS>& prs_list,
+    void test_read_prs(uintptr_t* genotype, PRSList& prs_list,
                        const size_t ploidy, const double stat,
                        const double adj_score, const double miss_score,
                        const size_t miss_count, const double homcom_weight,
@@ -334,6 +334,16 @@ public:
                  miss_count, homcom_weight, het_weight, homrar_weight,
                  not_first);
     }
+    template <MISSING_SCORE missing>
+    void test_add_hard_coded_prs(uintptr_t* genotype, PRSList& prs_list,
+                                 const SNP& snp, const uint32_t homcom_ct,
+                                 const uint32_t het_ct,
+                                 const uint32_t homrar_ct, const bool not_first)
+    {
+        CarrierList carriers;
+        add_hard_coded_prs<missing>(genotype, prs_list, snp, homcom_ct, het_ct,
+                                    homrar_ct, not_first, carriers);
+    }
     std::vector<int>& chr_id_col() { return m_chr_id_column; }
     std::vector<char>& chr_id_symbol() { return m_chr_id_symbol; }
     bool has_chr_formula() { return m_has_chr_id_formula; }